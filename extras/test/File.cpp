@@ -14,6 +14,17 @@ File SDClass::open(const char *filename, uint8_t mode) const
   return File(filename, mode);
 }
 
+bool SDClass::exists(const char *filename) const
+{
+  struct stat st;
+  return stat(filename, &st) == 0;
+}
+
+bool SDClass::remove(const char *filename) const
+{
+  return ::remove(filename) == 0;
+}
+
 File::File(void)
 {
   _f = NULL;
@@ -21,9 +32,12 @@ File::File(void)
 
 File::File(const char *filename, uint8_t mode)
 {
-  //cout << "Opening " << filename << " with mode "
-  //   << (mode & O_WRONLY ? "r+" : "r") << endl;
-  _f = fopen(filename, mode & O_WRONLY ? "r+" : "r");
+  // As with the SD library, FILE_WRITE creates the file if necessary
+  // and all writes go to the end
+  if (mode & O_CREAT)
+    _f = fopen(filename, "a+");
+  else
+    _f = fopen(filename, mode & (O_WRONLY | O_RDWR) ? "r+" : "r");
 }
 
 File::File(const File &a)
@@ -101,6 +115,24 @@ int File::read(void *buf, int n)
   return fread(buf, 1, n ,_f);
 }
 
+size_t File::write(uint8_t b)
+{
+  return write(&b, 1);
+}
+
+size_t File::write(const uint8_t *buf, size_t n)
+{
+  if (!isOpen())
+    return 0;
+  return fwrite(buf, 1, n, _f);
+}
+
+void File::flush(void)
+{
+  if (isOpen())
+    fflush(_f);
+}
+
 int File::peek(void)
 {
   if (!available())
@@ -17,6 +17,10 @@ public:
   int read(void);
   int read(void *buf, int n);
 
+  size_t write(uint8_t b);
+  size_t write(const uint8_t *buf, size_t n);
+  void flush(void);
+
   int peek(void);
   bool seek(int pos);
 
@@ -37,6 +41,8 @@ public:
   SDClass(void) { };
   
   File open(const char *filename, uint8_t mode) const;
+  bool exists(const char *filename) const;
+  bool remove(const char *filename) const;
   
 private:
   
@@ -0,0 +1,547 @@
+// Differential test of the ways IniFile can read a file. Every lookup
+// made in memory, through the block cache, through the index (by name
+// and with IniKey through its hash table), through a sparse index, by
+// binary search when the sections are sorted and with IniAsyncLookup
+// must give the same result as reading the file line by line, and so
+// must readLine() and browseSections(). Files are made at random,
+// mixing newline styles, comments, long lines and names which differ
+// only in case, and each is checked again with every value syntax
+// enabled. Each file is also patched into the next with IniPatch, and
+// lookups with a section must then give the same results as the next.
+// An IniSchema of every name, checked in one pass, must find the same
+// keys and values as looking each up.
+//
+// Built normally it checks the given number of random files (default
+// 1000) from a fixed seed, so a failure can be repeated. Built with
+// -DINIFILE_FUZZER it is a libFuzzer target which checks each input.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "IniFile.h"
+#include "IniAsync.h"
+#include "IniBlockCache.h"
+#include "IniIndex.h"
+#include "IniKey.h"
+#include "IniPatch.h"
+#include "IniSchema.h"
+#include "IniSparseIndex.h"
+
+using namespace std;
+
+const char fuzzFilename[] = "fuzztest.ini";
+const char patchFilename[] = "fuzzpatch.ini";
+const char patchedFilename[] = "fuzzpatched.ini";
+
+// Names used when making files, and looked up in every file
+const char *names[] = {
+  "a", "A", "b", "key", "KEY", "k2", "x y", "network", "Network", "",
+};
+const int numNames = sizeof(names) / sizeof(names[0]);
+
+struct Result {
+  bool found;
+  int error;
+  uint32_t lineNumber;
+  uint32_t position;
+  string value;
+};
+
+static uint32_t mismatches = 0;
+static uint32_t checks = 0;
+static uint32_t sortedFiles = 0; // Checked with sorted sections
+static string currentData;
+
+void report(const char *what, const char *section, const char *key,
+	    const Result &expected, const Result &got)
+{
+  if (++mismatches > 10)
+    return;
+  cout << what << " differs for key \"" << (key ? key : "(null)")
+       << "\" in section \"" << (section ? section : "(null)") << "\""
+       << endl
+       << "  expected " << expected.found << " error " << expected.error
+       << " line " << expected.lineNumber << " \"" << expected.value << "\""
+       << endl
+       << "  got      " << got.found << " error " << got.error
+       << " line " << got.lineNumber << " \"" << got.value << "\"" << endl
+       << "  file:" << endl;
+  for (size_t i = 0; i < currentData.size(); ++i) {
+    char c = currentData[i];
+    if (c == '\r')
+      cout << "\\r";
+    else if (c == '\n')
+      cout << "\\n" << endl;
+    else
+      cout << c;
+  }
+  cout << endl;
+}
+
+Result lookup(const IniFile &ini, const char *section, const char *key,
+	      size_t len)
+{
+  vector<char> buffer(len + 1);
+  Result r;
+  r.lineNumber = r.position = 0;
+  r.found = ini.getValue(section, key, buffer.data(), len,
+			 r.lineNumber, r.position);
+  r.error = ini.getError();
+  if (r.found)
+    r.value = buffer.data();
+  return r;
+}
+
+Result keyLookup(const IniFile &ini, const char *section, const char *key,
+		 size_t len)
+{
+  vector<char> buffer(len + 1);
+  Result r;
+  r.lineNumber = r.position = 0;
+  r.found = ini.getValue(IniKey(section), IniKey(key), buffer.data(), len);
+  r.error = ini.getError();
+  if (r.found)
+    r.value = buffer.data();
+  return r;
+}
+
+Result asyncLookup(const IniFile &ini, const char *section, const char *key,
+		   size_t len)
+{
+  IniDirectIO io;
+  IniAsyncLookup lookup(ini, io);
+  vector<char> buffer(len + 1);
+  if (lookup.begin(section, key, buffer.data(), len, NULL, NULL))
+    while (!lookup.poll())
+      ;
+  Result r;
+  r.error = lookup.getError();
+  r.found = (r.error == IniFile::errorNoError);
+  r.lineNumber = lookup.getLineNumber();
+  r.position = lookup.getPosition();
+  if (r.found)
+    r.value = lookup.getValue();
+  return r;
+}
+
+// Line numbers and positions are compared only where both come from
+// reading the file; the index reports the matching line, or none on
+// error
+void compare(const char *what, const char *section, const char *key,
+	     const Result &expected, const Result &got, bool location)
+{
+  ++checks;
+  if (expected.found != got.found || expected.error != got.error ||
+      expected.value != got.value ||
+      (location && (expected.lineNumber != got.lineNumber ||
+		    expected.position != got.position)))
+    report(what, section, key, expected, got);
+}
+
+void compareLines(const char *what, const IniFile &ref, const IniFile &ini,
+		  size_t len)
+{
+  vector<char> a(len), b(len);
+  uint32_t posA = 0, posB = 0;
+  for (int n = 0; n < 1000; ++n) {
+    IniFile::error_t errA = ref.readLine(a.data(), len, posA);
+    IniFile::error_t errB = ini.readLine(b.data(), len, posB);
+    ++checks;
+    if (errA != errB || posA != posB ||
+	(errA == IniFile::errorNoError && strcmp(a.data(), b.data()) != 0)) {
+      Result ra = {errA == 0, errA, 0, posA, errA ? "" : a.data()};
+      Result rb = {errB == 0, errB, 0, posB, errB ? "" : b.data()};
+      report(what, NULL, NULL, ra, rb);
+      return;
+    }
+    if (errA != IniFile::errorNoError)
+      return;
+  }
+}
+
+void compareSections(const char *what, const IniFile &ref, const IniFile &ini,
+		     size_t len)
+{
+  vector<char> a(len), b(len);
+  IniFileState stateA, stateB;
+  for (int n = 0; n < 1000; ++n) {
+    bool foundA = ref.browseSections(a.data(), len, stateA);
+    bool foundB = ini.browseSections(b.data(), len, stateB);
+    ++checks;
+    if (foundA != foundB ||
+	stateA.getLineNumber() != stateB.getLineNumber() ||
+	(foundA && strcmp(a.data(), b.data()) != 0)) {
+      Result ra = {foundA, 0, stateA.getLineNumber(), stateA.getPosition(),
+		   foundA ? a.data() : ""};
+      Result rb = {foundB, 0, stateB.getLineNumber(), stateB.getPosition(),
+		   foundB ? b.data() : ""};
+      report(what, NULL, NULL, ra, rb);
+      return;
+    }
+    if (!foundA)
+      return;
+  }
+}
+
+// Check every name at once with an IniSchema
+void checkSchema(const IniFile &ref, size_t len)
+{
+  const int numKeys = (numNames + 1) * numNames;
+  IniSchemaKey keys[numKeys];
+  IniSchemaValue values[numKeys];
+  for (int s = -1; s < numNames; ++s)
+    for (int k = 0; k < numNames; ++k) {
+      IniSchemaKey &sk = keys[(s + 1) * numNames + k];
+      memset(&sk, 0, sizeof(sk));
+      sk.section = (s < 0 ? NULL : names[s]);
+      sk.key = names[k];
+      sk.type = IniSchema::typeString;
+    }
+  IniSchema schema(keys, values, numKeys);
+  vector<char> buffer(len);
+  bool valid = ref.validate(buffer.data(), len, schema);
+  // A line too long for the buffer stops the pass, but not every lookup
+  if (!valid)
+    return;
+
+  for (int n = 0; n < numKeys; ++n) {
+    const IniSchemaKey &sk = keys[n];
+    Result expected = lookup(ref, sk.section, sk.key, len);
+    if (expected.error != IniFile::errorNoError &&
+	expected.error != IniFile::errorKeyNotFound &&
+	expected.error != IniFile::errorSectionNotFound)
+      continue;
+    // Only where the key was found is checked, not the error
+    const IniSchemaValue &v = schema.getValue(n);
+    Result got = {v.status != IniSchema::statusMissing, expected.error,
+		  v.line, expected.position, ""};
+    if (got.found) {
+      if (schema.getString(ref, n, buffer.data(), len))
+	got.value = buffer.data();
+      else
+	got.value = "(not read)";
+    }
+    compare("schema", sk.section, sk.key, expected, got, expected.found);
+  }
+}
+
+// Check one file with one buffer length and syntax
+void checkData(const char *data, size_t dataLen, size_t len, uint8_t syntax)
+{
+  IniFile ref(fuzzFilename);
+  ref.open();
+  ref.setSyntax(syntax);
+  IniFile mem(dataLen ? data : "", dataLen, IniFile::memoryRAM);
+  mem.setSyntax(syntax);
+
+  static char cacheBuffer[256];
+  IniCacheBlock blocks[4];
+  IniBlockCache cache(cacheBuffer, sizeof(cacheBuffer), blocks, 4);
+  cache.setReadAhead(1);
+  IniFile cached(fuzzFilename);
+  cached.setCache(&cache);
+  cached.open();
+  cached.setSyntax(syntax);
+
+  // The index only reads the lines it needs, so a line too long for
+  // the buffer elsewhere in the file is not an error. Compare it only
+  // when every line fits.
+  bool linesFit = true;
+  size_t lineLen = 0;
+  for (size_t i = 0; i < dataLen; ++i) {
+    if (data[i] == '\n' || data[i] == '\r')
+      lineLen = 0;
+    else if (++lineLen >= len - 1)
+      linesFit = false;
+  }
+  const int maxEntries = 200;
+  IniIndexEntry entries[maxEntries];
+  IniIndex index(entries, maxEntries);
+  IniFile indexed(dataLen ? data : "", dataLen, IniFile::memoryRAM);
+  indexed.setSyntax(syntax);
+  vector<char> buffer(len);
+  bool useIndex = linesFit &&
+    index.build(indexed, buffer.data(), len) == IniFile::errorNoError;
+  indexed.setIndex(&index);
+  IniIndexEntry hashedEntries[maxEntries];
+  IniIndex hashedIndex(hashedEntries, maxEntries);
+  IniFile hashed(dataLen ? data : "", dataLen, IniFile::memoryRAM);
+  hashed.setSyntax(syntax);
+  IniIndex::entry_t slots[maxEntries + 1];
+  bool useHashed = useIndex &&
+    hashedIndex.build(hashed, buffer.data(), len) == IniFile::errorNoError &&
+    hashedIndex.buildHashTable(hashed, buffer.data(), len, slots,
+			       maxEntries + 1) == IniFile::errorNoError;
+  hashed.setIndex(&hashedIndex);
+  // Few checkpoints, so that most cover several sections
+  IniCheckpoint checkpoints[3];
+  IniSparseIndex sparseIndex(checkpoints, 3);
+  IniFile sparse(dataLen ? data : "", dataLen, IniFile::memoryRAM);
+  sparse.setSyntax(syntax);
+  bool useSparse = linesFit &&
+    sparseIndex.build(sparse, buffer.data(), len) == IniFile::errorNoError;
+  sparse.setSparseIndex(&sparseIndex);
+  IniFile sorted(dataLen ? data : "", dataLen, IniFile::memoryRAM);
+  sorted.setSyntax(syntax);
+  vector<char> pair(len * 2);
+  bool useSorted = linesFit &&
+    sorted.checkSortedSections(pair.data(), pair.size());
+  sorted.setSortedSections(true);
+  if (useSorted)
+    ++sortedFiles;
+
+  for (int s = -1; s < numNames; ++s)
+    for (int k = 0; k < numNames; ++k) {
+      const char *section = (s < 0 ? NULL : names[s]);
+      const char *key = names[k];
+      Result expected = lookup(ref, section, key, len);
+      compare("memory", section, key, expected,
+	      lookup(mem, section, key, len), true);
+      compare("cache", section, key, expected,
+	      lookup(cached, section, key, len), true);
+      compare("async", section, key, expected,
+	      asyncLookup(mem, section, key, len), true);
+      if (useIndex)
+	compare("index", section, key, expected,
+		lookup(indexed, section, key, len), false);
+      if (useHashed && section)
+	compare("hash table", section, key, expected,
+		keyLookup(hashed, section, key, len), false);
+      // Only the lines after a checkpoint are read, so a failed search
+      // ends somewhere else
+      if (useSparse)
+	compare("sparse index", section, key, expected,
+		lookup(sparse, section, key, len), expected.found);
+      // Line numbers are not known after a binary search
+      if (useSorted) {
+	Result r = lookup(sorted, section, key, len);
+	if (section && !(syntax & IniFile::syntaxContinuation))
+	  r.lineNumber = expected.lineNumber;
+	compare("sorted sections", section, key, expected, r, expected.found);
+      }
+    }
+
+  checkSchema(ref, len);
+  compareLines("memory readLine()", ref, mem, len);
+  compareLines("cache readLine()", ref, cached, len);
+  compareSections("memory browseSections()", ref, mem, len);
+  compareSections("cache browseSections()", ref, cached, len);
+  ref.close();
+  cached.close();
+}
+
+void checkFile(const char *data, size_t dataLen)
+{
+  currentData.assign(data, dataLen);
+  FILE *f = fopen(fuzzFilename, "wb");
+  if (f == NULL)
+    return;
+  fwrite(data, 1, dataLen, f);
+  fclose(f);
+  const uint8_t allSyntax = IniFile::syntaxQuotes |
+    IniFile::syntaxInlineComments | IniFile::syntaxContinuation;
+  checkData(data, dataLen, 80, 0);
+  checkData(data, dataLen, 12, 0);
+  checkData(data, dataLen, 80, allSyntax);
+  checkData(data, dataLen, 12, allSyntax);
+  checkData(data, dataLen, 80, IniFile::syntaxContinuation);
+}
+
+// Write the patch from one file to another, or apply it
+IniFile::error_t writePatch(const char *filename, const IniFile &from,
+			    const IniFile &to, const IniFile *patch,
+			    uint32_t &written)
+{
+  SD.remove(filename);
+  File file = SD.open(filename, FILE_WRITE);
+  char buffer[512];
+  IniWriter writer(file, buffer, sizeof(buffer));
+  char lines[3 * 256];
+  IniFile::error_t err;
+  if (patch)
+    err = IniPatch(*patch).apply(from, writer, lines, sizeof(lines));
+  else
+    err = IniPatch::diff(from, to, writer, lines, sizeof(lines));
+  writer.flush();
+  written = writer.getPosition();
+  file.close();
+  return err;
+}
+
+// Patch one file into another with each value syntax that patches allow
+void checkPatch(const string &from, const string &to)
+{
+  currentData = from + "\n---- patched into ----\n" + to;
+  const uint8_t syntaxes[] = {
+    0, IniFile::syntaxQuotes | IniFile::syntaxInlineComments,
+  };
+  for (size_t n = 0; n < sizeof(syntaxes); ++n) {
+    IniFile a(from.size() ? from.data() : "", from.size(),
+	      IniFile::memoryRAM);
+    IniFile b(to.size() ? to.data() : "", to.size(), IniFile::memoryRAM);
+    a.setSyntax(syntaxes[n]);
+    b.setSyntax(syntaxes[n]);
+    uint32_t written;
+    Result none = {false, 0, 0, 0, ""};
+    Result r = none;
+    r.error = writePatch(patchFilename, a, a, NULL, written);
+    r.found = (written != 0);
+    ++checks;
+    if (r.error != IniFile::errorNoError || r.found)
+      report("patch to the same file", NULL, NULL, none, r);
+
+    r.error = writePatch(patchFilename, a, b, NULL, written);
+    IniFile patch(patchFilename);
+    patch.open();
+    patch.setSyntax(syntaxes[n]);
+    if (r.error == IniFile::errorNoError)
+      r.error = writePatch(patchedFilename, a, b, &patch, written);
+    ++checks;
+    if (r.error != IniFile::errorNoError) {
+      report("patch", NULL, NULL, none, r);
+      patch.close();
+      continue;
+    }
+    IniFile patched(patchedFilename);
+    patched.open();
+    patched.setSyntax(syntaxes[n]);
+    for (int s = 0; s < numNames; ++s)
+      for (int k = 0; k < numNames; ++k)
+	compare("patched", names[s], names[k],
+		lookup(b, names[s], names[k], 256),
+		lookup(patched, names[s], names[k], 256), false);
+    // IniFile does not close itself
+    patch.close();
+    patched.close();
+  }
+}
+
+#if defined(INIFILE_FUZZER)
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  if (size > 4096)
+    return 0;
+  checkFile((const char*)data, size);
+  // Patch the first half of the input into the second
+  checkPatch(string((const char*)data, size / 2),
+	     string((const char*)data + size / 2, size - size / 2));
+  if (mismatches)
+    abort();
+  return 0;
+}
+
+#else
+
+static uint32_t rngState;
+
+uint32_t rng(uint32_t n)
+{
+  // xorshift32
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return rngState % n;
+}
+
+const char *space(void)
+{
+  static const char *spaces[] = {"", "", " ", "  ", "\t"};
+  return spaces[rng(5)];
+}
+
+// Quotes, escapes, inline comments and continuations
+const char *valueSyntax(void)
+{
+  static const char *parts[] = {
+    "\\", " \\", "\\\\", " \"a ; b\"", "\"open", "\"x\\", "\\\"",
+    " ; comment", "#x", " # \\", "\"\\n\\t\"",
+  };
+  return parts[rng(sizeof(parts) / sizeof(parts[0]))];
+}
+
+string makeFile(void)
+{
+  static const char *newlines[] = {"\n", "\r\n", "\r", "\n\r"};
+  string s;
+  int lines = rng(30);
+  // Mostly one newline style per file, sometimes a mixture
+  int style = rng(4);
+  bool mixed = (rng(4) == 0);
+  for (int i = 0; i < lines; ++i) {
+    const char *name = names[rng(numNames)];
+    switch (rng(10)) {
+    case 0:
+      break; // Blank
+    case 1:
+      s += space();
+      s += (rng(2) ? ";" : "#");
+      s += " comment = ";
+      s += name;
+      break;
+    case 2:
+    case 3:
+      s += space();
+      s += "[";
+      s += space();
+      s += name;
+      s += space();
+      if (rng(8))
+	s += "]";
+      s += space();
+      break;
+    case 4:
+      // Long line
+      s += name;
+      s += " = ";
+      s += string(rng(60), 'v');
+      break;
+    default:
+      s += space();
+      s += name;
+      s += space();
+      if (rng(10))
+	s += "=";
+      s += space();
+      s += "value";
+      s += char('0' + rng(10));
+      if (rng(4) == 0)
+	s += " with spaces";
+      if (rng(3) == 0)
+	s += valueSyntax();
+      s += space();
+      break;
+    }
+    if (i < lines - 1 || rng(2))
+      s += newlines[mixed ? rng(4) : style];
+  }
+  return s;
+}
+
+int main(int argc, char *argv[])
+{
+  uint32_t files = (argc > 1 ? strtoul(argv[1], NULL, 0) : 1000);
+  rngState = (argc > 2 ? strtoul(argv[2], NULL, 0) : 1);
+  if (rngState == 0)
+    rngState = 1;
+  string last;
+  for (uint32_t i = 0; i < files && mismatches <= 10; ++i) {
+    string s = makeFile();
+    checkFile(s.data(), s.size());
+    checkPatch(last, s);
+    last = s;
+  }
+  remove(fuzzFilename);
+  remove(patchFilename);
+  remove(patchedFilename);
+  cout << files << " files (" << sortedFiles
+       << " times with sorted sections), " << checks << " checks, "
+       << mismatches << " mismatches" << endl;
+  return mismatches ? 1 : 0;
+}
+
+#endif
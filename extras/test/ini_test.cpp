@@ -1,9 +1,144 @@
+#include <cerrno>
+#include <cstdlib>
 #include <iostream>
+#include <new>
+#include <thread>
+#include <vector>
 
 #include "IniFile.h"
+#include "IniAsync.h"
+#include "IniBlockCache.h"
+#include "IniDocument.h"
+#include "IniImage.h"
+#include "IniIndex.h"
+#include "IniInflate.h"
+#include "IniInterpolation.h"
+#include "IniKey.h"
+#include "IniNetwork.h"
+#include "IniPatch.h"
+#include "IniSchema.h"
+#include "IniSparseIndex.h"
+#include "IniStatic.h"
+#include "IniTokenizer.h"
+#include "IniTrace.h"
+#include "IniValidation.h"
+#include "IniValueCache.h"
+#include "IniWriter.h"
 
 using namespace std;
 
+// Count allocations, to show that lookups make none. Every C++
+// allocation goes through the replaceable operator new and delete;
+// the default array and nothrow forms call these.
+static bool countAllocations = false;
+static long allocations = 0;
+static long deallocations = 0;
+
+#if defined(__GLIBC__)
+// C allocations can be counted too, in glibc, which has entry points
+// that are not replaced
+extern "C" void* __libc_malloc(size_t n);
+extern "C" void* __libc_calloc(size_t n, size_t size);
+extern "C" void* __libc_realloc(void* p, size_t n);
+extern "C" void* __libc_memalign(size_t alignment, size_t n);
+
+extern "C" void* malloc(size_t n)
+{
+  if (countAllocations)
+    ++allocations;
+  return __libc_malloc(n);
+}
+
+extern "C" void* calloc(size_t n, size_t size)
+{
+  if (countAllocations)
+    ++allocations;
+  return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* p, size_t n)
+{
+  if (countAllocations)
+    ++allocations;
+  return __libc_realloc(p, n);
+}
+
+extern "C" int posix_memalign(void** p, size_t alignment, size_t n)
+{
+  if (countAllocations)
+    ++allocations;
+  *p = __libc_memalign(alignment, n);
+  return *p == NULL ? ENOMEM : 0;
+}
+
+extern "C" void* aligned_alloc(size_t alignment, size_t n)
+{
+  if (countAllocations)
+    ++allocations;
+  return __libc_memalign(alignment, n);
+}
+#endif
+
+// Allocate without counting again
+static void* allocate(size_t n, size_t alignment = 0)
+{
+#if defined(__GLIBC__)
+  return (alignment ? __libc_memalign(alignment, n) : __libc_malloc(n ? n : 1));
+#else
+  void* p = NULL;
+  if (alignment == 0)
+    return malloc(n ? n : 1);
+  if (alignment < sizeof(void*))
+    alignment = sizeof(void*);
+  return (posix_memalign(&p, alignment, n ? n : 1) == 0 ? p : NULL);
+#endif
+}
+
+void* operator new(size_t n)
+{
+  if (countAllocations)
+    ++allocations;
+  void* p = allocate(n);
+  if (p == NULL)
+    throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept
+{
+  if (countAllocations && p)
+    ++deallocations;
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  operator delete(p);
+}
+
+#if defined(__cpp_aligned_new)
+void* operator new(size_t n, std::align_val_t alignment)
+{
+  if (countAllocations)
+    ++allocations;
+  void* p = allocate(n, size_t(alignment));
+  if (p == NULL)
+    throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+  if (countAllocations && p)
+    ++deallocations;
+  free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t alignment) noexcept
+{
+  operator delete(p, alignment);
+}
+#endif
 
 const char noError[] = "no error";
 const char fileNotFound[] = "file not found";
@@ -12,7 +147,14 @@ const char bufferTooSmall[] = "buffer too small";
 const char seekError[] = "seek error";
 const char sectionNotFound[] = "section not found";
 const char keyNotFound[] = "key not found";
+const char endOfFile[] = "end of file";
 const char unknownError[] = "unknown error";
+const char decompressionError[] = "decompression error";
+const char writeError[] = "write error";
+const char imageError[] = "image error";
+const char interpolationError[] = "interpolation error";
+const char patchError[] = "patch error";
+const char schemaError[] = "schema error";
 const char unknownErrorValue[] = "unknown error value";
 
 const char* getErrorMessage(int e)
@@ -41,6 +183,27 @@ const char* getErrorMessage(int e)
   case IniFile::errorKeyNotFound:
     cp = keyNotFound;
     break;
+  case IniFile::errorEndOfFile:
+    cp = endOfFile;
+    break;
+  case IniFile::errorDecompressionError:
+    cp = decompressionError;
+    break;
+  case IniFile::errorWriteError:
+    cp = writeError;
+    break;
+  case IniFile::errorImageError:
+    cp = imageError;
+    break;
+  case IniFile::errorInterpolationError:
+    cp = interpolationError;
+    break;
+  case IniFile::errorPatchError:
+    cp = patchError;
+    break;
+  case IniFile::errorSchemaError:
+    cp = schemaError;
+    break;
   default:
     cp = unknownErrorValue;
     break;
@@ -142,6 +305,1077 @@ void browseTest(IniFile &ini)
 
 }
 
+// Read a whole file into a buffer so that it can be tested as an
+// IniFile held in memory. Returns the number of bytes read.
+size_t loadFile(const char *filename, char *buffer, size_t len)
+{
+  FILE *f = fopen(filename, "r");
+  if (f == NULL)
+    return 0;
+  size_t n = fread(buffer, 1, len, f);
+  fclose(f);
+  return n;
+}
+
+void locationTest(IniFile &ini, const char *key, const char *section)
+{
+  char buffer[80];
+  uint32_t lineNumber, position;
+  bool b = ini.getValue(section, key, buffer, sizeof(buffer),
+			lineNumber, position);
+  cout << "    Key \"" << key << "\" in section \""
+       << (section ? section : "(none)") << "\": "
+       << (b ? "found" : getErrorMessage(ini.getError()))
+       << " at line " << lineNumber << ", position " << position << endl;
+}
+
+void locationTest(IniFile &ini)
+{
+  cout << "  Locations in " << ini.getFilename() << " using "
+       << (ini.getIndex() ? "index" : "search") << endl;
+  locationTest(ini, "mac", NULL);
+  locationTest(ini, "hosts allow", "network2");
+  locationTest(ini, "pi", "misc");
+  locationTest(ini, "mac", "fake");
+  locationTest(ini, "fake", "network");
+}
+
+void validateTest(IniFile &ini, size_t len)
+{
+  cout << "Validating " << ini.getFilename() << " with buffer of " << len
+       << " bytes" << endl;
+  const int maxProblems = 4;
+  IniFileProblem problems[maxProblems];
+  uint32_t keyHashes[10];
+  IniValidation validation(problems, maxProblems, keyHashes, 10);
+  char buffer[200];
+  bool b = ini.validate(buffer, len, validation);
+  int e = ini.getError();
+  cout << "  Valid? " << (b ? "true" : "false") << " ("
+       << getErrorMessage(e) << ")" << endl
+       << "  Lines: " << validation.getNumLines()
+       << ", sections: " << validation.getNumSections()
+       << ", keys: " << validation.getNumKeys()
+       << ", max keys per section: " << validation.getMaxKeysPerSection()
+       << endl
+       << "  Max line length: " << validation.getMaxLineLength()
+       << ", max value length: " << validation.getMaxValueLength()
+       << ", min buffer length: " << validation.getMinBufferLen() << endl
+       << "  Problems: " << validation.getNumProblems() << endl;
+  const char *names[] = {"line too long", "bad section", "no equals",
+			 "duplicate key"};
+  for (int i = 0; i < validation.getNumStoredProblems(); ++i) {
+    const IniFileProblem &p = validation.getProblem(i);
+    cout << "    Line " << p.lineNumber << " (position " << p.position
+	 << "): " << names[p.type] << endl;
+  }
+  // A buffer of the minimum length must pass
+  b = ini.validate(buffer, validation.getMinBufferLen());
+  cout << "  Valid with min buffer length? " << (b ? "true" : "false")
+       << endl;
+}
+
+// Duplicate keys have the same hash, whatever their case, so are found
+// by comparing the names, here with a buffer too small for two lines
+void duplicateTest(bool caseSensitive)
+{
+  const char data[] =
+    "[s]\nKey = 1\nkey = 2\n Key\t= 3\nother = 4\n[t]\nkey = 5\nkey=6";
+  IniFile ini(data, strlen(data), IniFile::memoryRAM, caseSensitive);
+  IniFileProblem problems[4];
+  uint32_t keyHashes[4];
+  IniValidation validation(problems, 4, keyHashes, 4);
+  char buffer[12];
+  bool b = ini.validate(buffer, sizeof(buffer), validation);
+  cout << "  Case sensitive? " << (caseSensitive ? "true" : "false")
+       << ", valid? " << (b ? "true" : "false") << ", duplicate keys on lines";
+  for (int i = 0; i < validation.getNumStoredProblems(); ++i)
+    cout << " " << validation.getProblem(i).lineNumber;
+  cout << endl;
+}
+
+// Write typed values then read them back
+void writeTest(const char *filename)
+{
+  SD.remove(filename);
+  File file = SD.open(filename, FILE_WRITE);
+  // A small buffer so that it is flushed several times
+  char buffer[16];
+  IniWriter writer(file, buffer, sizeof(buffer));
+  const uint8_t ip[4] = {192, 168, 1, 200};
+  const uint8_t mac[6] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB};
+  writer.writeComment("Written by IniWriter");
+  writer.writeSection("values");
+  writer.writeValue("string", "Hello, world");
+  writer.writeValue("bool", true);
+  writer.writeValue("int", -1234);
+  writer.writeValue("long", -2147483647L - 1);
+  writer.writeValue("ulong", 4294967295UL);
+  writer.writeValue("double", -3.14159, 4);
+  writer.writeValue("big", 12345678901234.0, 3);
+  // Without decimals values are written so as to read back the same
+  writer.writeValue("small", 0.001);
+  writer.writeValue("third", 1.0f / 3);
+  writer.writeValue("tenth", 0.1);
+  writer.writeIPAddress("ip", ip);
+  writer.writeMACAddress("mac", mac);
+  writer.writeBlankLine();
+  bool b = writer.flush();
+  cout << "  Wrote " << writer.getPosition() << " bytes to " << filename
+       << ": " << (b ? "ok" : getErrorMessage(writer.getError())) << endl;
+  file.close();
+
+  IniFile ini(filename);
+  ini.open();
+  char line[80];
+  uint32_t pos = 0;
+  while (ini.readLine(line, sizeof(line), pos) == IniFile::errorNoError)
+    cout << "    " << line << endl;
+
+  bool bval = false;
+  int ival = 0;
+  long lval = 0;
+  unsigned long ulval = 0;
+  double dval = 0, bigval = 0, smallval = 0, tenthval = 0;
+  float thirdval = 0;
+  uint8_t ipval[4], macval[6];
+  ini.getValue("values", "bool", line, sizeof(line), bval);
+  ini.getValue("values", "int", line, sizeof(line), ival);
+  ini.getValue("values", "long", line, sizeof(line), lval);
+  ini.getValue("values", "ulong", line, sizeof(line), ulval);
+  ini.getValue("values", "double", line, sizeof(line), dval);
+  ini.getValue("values", "big", line, sizeof(line), bigval);
+  ini.getValue("values", "small", line, sizeof(line), smallval);
+  ini.getValue("values", "third", line, sizeof(line), thirdval);
+  ini.getValue("values", "tenth", line, sizeof(line), tenthval);
+  ini.getIPAddress("values", "ip", line, sizeof(line), ipval);
+  ini.getMACAddress("values", "mac", line, sizeof(line), macval);
+  cout << "  Read back: " << (bval ? "true" : "false") << ", " << ival
+       << ", " << lval << ", " << ulval << ", " << dval << ", "
+       << bigval << ", "
+       << (memcmp(ipval, ip, 4) == 0 ? "same IP" : "different IP") << ", "
+       << (memcmp(macval, mac, 6) == 0 ? "same MAC" : "different MAC")
+       << endl;
+  cout << "  Round trip exact? " << (smallval == 0.001 ? "true" : "false")
+       << ", " << (thirdval == 1.0f / 3 ? "true" : "false") << ", "
+       << (tenthval == 0.1 ? "true" : "false") << endl;
+  ini.close();
+}
+
+// Write a copy of an ini file and check it is identical
+void copyTest(const IniFile &ini, const char *filename)
+{
+  SD.remove(filename);
+  File file = SD.open(filename, FILE_WRITE);
+  char buffer[512];
+  IniWriter writer(file, buffer, sizeof(buffer));
+  bool b = writer.copy(ini) && writer.flush();
+  file.close();
+
+  static char original[2048], copied[2048];
+  size_t n = 0, m = 0, bytesRead;
+  while (ini.read(n, original + n, sizeof(original) - n, bytesRead)
+	 == IniFile::errorNoError)
+    n += bytesRead;
+  m = loadFile(filename, copied, sizeof(copied));
+  cout << "  Copied " << writer.getPosition() << " bytes to " << filename
+       << ": " << (b ? "ok" : getErrorMessage(writer.getError()))
+       << ", identical? "
+       << (n == m && memcmp(original, copied, n) == 0 ? "true" : "false")
+       << endl;
+}
+
+// Compile an ini file and check that the image gives the same results
+void imageTest(const IniFile &source, const IniFile &other,
+	       const char *filename)
+{
+  SD.remove(filename);
+  File file = SD.open(filename, FILE_WRITE);
+  char writeBuffer[512];
+  IniWriter writer(file, writeBuffer, sizeof(writeBuffer));
+  static IniImageKey keys[100];
+  char buffer[80];
+  int e = IniImage::compile(source, writer, buffer, sizeof(buffer), keys, 100);
+  file.close();
+  cout << "  Compiled " << source.getFilename() << " to " << filename
+       << ": " << getErrorMessage(e) << endl;
+
+  IniFile imageFile(filename);
+  imageFile.open();
+  IniImage image(imageFile);
+  bool b = image.open();
+  cout << "  Image open? " << (b ? "true" : "false") << ", entries: "
+       << image.getNumEntries() << endl
+       << "  Current for " << source.getFilename() << "? "
+       << (image.isCurrent(source, buffer, sizeof(buffer)) ? "true" : "false")
+       << endl
+       << "  Current for " << other.getFilename() << "? "
+       << (image.isCurrent(other, buffer, sizeof(buffer)) ? "true" : "false")
+       << endl;
+
+  const char *lookups[][2] = {
+    {NULL, "mac"}, {"network", "mac"}, {"network2", "mac"}, {"fake", "mac"},
+    {"network", "ip"}, {"NETWORK2", "Hosts Allow"}, {"misc", "string2"},
+    {"misc", "fake"}, {"/data/private", "error document 403"},
+    {"/upload", "allow put"}, {"misc", ""},
+  };
+  char expected[80];
+  for (size_t i = 0; i < sizeof(lookups) / sizeof(lookups[0]); ++i) {
+    const char *section = lookups[i][0];
+    const char *key = lookups[i][1];
+    b = image.getValue(section, key, buffer, sizeof(buffer));
+    bool same = (b == source.getValue(section, key, expected,
+				       sizeof(expected)) &&
+		 image.getError() == source.getError() &&
+		 (!b || strcmp(buffer, expected) == 0));
+    cout << "    " << (section ? section : "(none)") << ", " << key << ": "
+	 << (b ? buffer : getErrorMessage(image.getError()))
+	 << (same ? "" : " (different from IniFile)") << endl;
+  }
+
+  float pi = 0;
+  bool allowPut = false;
+  uint8_t ip[4], mac[6];
+  image.getValue("misc", "pi", buffer, sizeof(buffer), pi);
+  image.getValue("/upload", "allow put", buffer, sizeof(buffer), allowPut);
+  image.getIPAddress("network", "gateway", buffer, sizeof(buffer), ip);
+  image.getMACAddress("network2", "mac", buffer, sizeof(buffer), mac);
+  cout << "  Pi: " << pi << ", allow put: " << (allowPut ? "true" : "false")
+       << ", gateway: " << int(ip[0]) << '.' << int(ip[1]) << '.'
+       << int(ip[2]) << '.' << int(ip[3]) << ", mac[0]: " << hex
+       << int(mac[0]) << dec << endl;
+}
+
+void keyTest(IniFile &ini, const char *section, const char *pattern)
+{
+  char buffer[80];
+  IniFileState state;
+  char *key, *value;
+  cout << "    Keys matching \"" << pattern << "\" in section \""
+       << (section ? section : "(none)") << "\":";
+  while (ini.browseKeys(section, pattern, buffer, sizeof(buffer), state,
+			&key, &value))
+    cout << " " << key << "=" << value << " (line "
+	 << state.getLineNumber() << ")";
+  cout << " [" << getErrorMessage(ini.getError()) << "]" << endl;
+}
+
+void keyTest(IniFile &ini)
+{
+  cout << "  Keys in " << ini.getFilename() << " using "
+       << (ini.getIndex() ? "sorted index" : "search") << endl;
+  keyTest(ini, "channels", "channel*.gain");
+  keyTest(ini, "channels", "channel1*");
+  keyTest(ini, "channels", "*");
+  keyTest(ini, "channels", "?hannel2.*");
+  keyTest(ini, "channels", "nomatch*");
+  keyTest(ini, "empty", "*");
+  keyTest(ini, "missing", "*");
+  keyTest(ini, NULL, "*.gain");
+}
+
+struct AsyncKey {
+  const char *section;
+  const char *key;
+};
+
+const AsyncKey asyncKeys[] = {
+  {NULL, "mac"}, {"network", "mac"}, {"network2", "mac"}, {"fake", "mac"},
+  {NULL, "ip"}, {NULL, "gateway"}, {"network", "hosts allow"},
+  {"network2", "hosts allow"}, {"misc", "string"}, {"misc", "string2"},
+  {"misc", "pi"}, {"misc", ""}, {NULL, NULL},
+};
+
+void asyncDone(IniAsyncLookup &, void *context)
+{
+  ++*(int*)context;
+}
+
+// Compare each lookup with getValue(), listing the results if verbose.
+// The index is not used by IniAsyncLookup, nor by getValue() here, so
+// that the line reported for errors is the same.
+void asyncTest(IniFile &ini, IniAsyncIO &io, const char *ioName, size_t len,
+	       bool verbose)
+{
+  IniIndex *index = ini.getIndex();
+  ini.setIndex(NULL);
+  cout << "  Lookups in " << ini.getFilename() << " using " << ioName
+       << " with buffer of " << len << " bytes" << endl;
+  char buffer[100];
+  char expected[100];
+  IniAsyncLookup lookup(ini, io);
+  int callbacks = 0;
+  int same = 0;
+  int n = 0;
+  for (const AsyncKey *k = asyncKeys; k->key; ++k, ++n) {
+    uint32_t lineNumber, position;
+    bool b = ini.getValue(k->section, k->key, expected, len,
+			  lineNumber, position);
+    if (lookup.begin(k->section, k->key, buffer, len, asyncDone, &callbacks))
+      while (!lookup.poll())
+	;
+    if (lookup.getError() == ini.getError() &&
+	(b || lookup.getError() == IniFile::errorBufferTooSmall
+	 ? strcmp(lookup.getValue(), expected) == 0 : true) &&
+	lookup.getLineNumber() == lineNumber &&
+	lookup.getPosition() == position)
+      ++same;
+    if (verbose)
+      cout << "    Key \"" << k->key << "\" in section \""
+	   << (k->section ? k->section : "(none)") << "\": "
+	   << getErrorMessage(lookup.getError())
+	   << (lookup.getError() ? "" : ", value \"")
+	   << (lookup.getError() ? "" : lookup.getValue())
+	   << (lookup.getError() ? "" : "\"")
+	   << " at line " << lookup.getLineNumber() << endl;
+  }
+  cout << "    " << n << " lookups, " << same << " same as getValue(), "
+       << callbacks << " callbacks" << endl;
+  ini.setIndex(index);
+}
+
+// Look up every key of runTest() through a cache
+void cacheTest(IniFile &ini, uint8_t numBlocks, size_t blockSize,
+	       uint8_t readAhead, bool verbose)
+{
+  static char cacheBuffer[2048];
+  IniCacheBlock blocks[8];
+  IniBlockCache cache(cacheBuffer, numBlocks * blockSize, blocks, numBlocks);
+  cache.setReadAhead(readAhead);
+  IniIndex *index = ini.getIndex();
+  ini.setIndex(NULL);
+  ini.setCache(&cache);
+  cout << "  Cache of " << int(numBlocks) << " blocks of " << blockSize
+       << " bytes, read ahead " << int(readAhead) << endl;
+  if (verbose)
+    runTest(ini);
+  else {
+    char buffer[80];
+    for (const AsyncKey *k = asyncKeys; k->key; ++k)
+      ini.getValue(k->section, k->key, buffer, sizeof(buffer));
+  }
+  cout << "    " << cache.getHits() << " hits, " << cache.getMisses()
+       << " misses" << endl;
+  ini.setCache(NULL);
+  ini.setIndex(index);
+}
+
+void writeFile(const char *filename, const char *contents)
+{
+  FILE *f = fopen(filename, "w");
+  fputs(contents, f);
+  fclose(f);
+}
+
+// Look up every key of runTest() in a shared document from several
+// threads at once, counting the lookups which agree with ini, a copy
+// of the file held in memory
+void documentTest(const char *filename, const IniFile &ini)
+{
+  IniFile::error_t err;
+  IniDocument::handle_t doc = IniDocumentCache::shared().get(filename, err);
+  IniDocument::handle_t again = IniDocumentCache::shared().get(filename, err);
+  cout << "  " << filename << ": " << getErrorMessage(err)
+       << ", indexed? " << (doc->isIndexed() ? "true" : "false")
+       << ", same document? " << (doc == again ? "true" : "false") << endl;
+
+  const int numThreads = 4;
+  int same[numThreads];
+  std::vector<std::thread> threads;
+  for (int t = 0; t < numThreads; ++t)
+    threads.push_back(std::thread([&, t]() {
+      same[t] = 0;
+      for (int i = 0; i < 100; ++i)
+	for (const AsyncKey *k = asyncKeys; k->key; ++k) {
+	  char expected[80];
+	  char buffer[80];
+	  IniFile view(ini); // IniFile records errors, so one per thread
+	  bool b = view.getValue(k->section, k->key, expected, 80);
+	  IniFile::error_t e = doc->getValue(k->section, k->key, buffer, 80);
+	  if (e == view.getError() && (!b || strcmp(buffer, expected) == 0))
+	    ++same[t];
+	}
+    }));
+  int total = 0;
+  for (int t = 0; t < numThreads; ++t) {
+    threads[t].join();
+    total += same[t];
+  }
+  cout << "    " << total << " lookups by " << numThreads
+       << " threads same as getValue()" << endl;
+}
+
+// Reload a file many times while several threads read it. Every
+// snapshot must see both keys from the same version of the file, and
+// no thread may see the version go backwards.
+void liveDocumentTest(void)
+{
+  const char filename[] = "livetest.ini";
+  IniLiveDocument live(filename);
+  char buffer[80];
+  cout << "  Before the first reload: "
+       << getErrorMessage(live.getValue("a", "version", buffer, 80)) << endl;
+  writeFile(filename, "[a]\nversion = 0\ncheck = 0\n");
+  live.reload();
+
+  const int numThreads = 4;
+  const long numReloads = 50;
+  std::atomic<bool> stop(false);
+  int inconsistent[numThreads], backwards[numThreads];
+  std::vector<std::thread> threads;
+  for (int t = 0; t < numThreads; ++t)
+    threads.push_back(std::thread([&, t]() {
+      inconsistent[t] = backwards[t] = 0;
+      long last = 0;
+      char a[80], b[80];
+      while (!stop) {
+	IniLiveDocument::Snapshot snapshot(live);
+	long version = -1, check = -2;
+	snapshot->getValue("a", "version", a, 80, version);
+	snapshot->getValue("a", "check", b, 80, check);
+	if (version != check)
+	  ++inconsistent[t];
+	if (version < last)
+	  ++backwards[t];
+	last = version;
+      }
+    }));
+  for (long i = 1; i <= numReloads; ++i) {
+    char contents[80];
+    snprintf(contents, sizeof(contents),
+	     "[a]\nversion = %ld\n; padding\ncheck = %ld\n", i, i);
+    writeFile(filename, contents);
+    live.reload();
+  }
+  stop = true;
+  int totalInconsistent = 0, totalBackwards = 0;
+  for (int t = 0; t < numThreads; ++t) {
+    threads[t].join();
+    totalInconsistent += inconsistent[t];
+    totalBackwards += backwards[t];
+  }
+  live.getValue("a", "version", buffer, 80);
+  cout << "  " << live.getReloads() << " reloads with " << numThreads
+       << " readers: " << totalInconsistent << " inconsistent, "
+       << totalBackwards << " backwards, version now " << buffer << endl;
+
+  remove(filename);
+  IniFile::error_t err = live.reload();
+  live.getValue("a", "version", buffer, 80);
+  cout << "  Reload of a missing file: " << getErrorMessage(err)
+       << ", version still " << buffer << endl;
+}
+
+// Write the patch from one file to another, apply it and print the
+// patch and the patched file
+void patchTest(const char *from, const char *to)
+{
+  const char fromFilename[] = "patchfrom.ini";
+  const char patchFilename[] = "patch.ini";
+  const char patchedFilename[] = "patched.ini";
+  writeFile(fromFilename, from);
+  IniFile a(fromFilename);
+  a.open();
+  IniFile b(to, strlen(to), IniFile::memoryRAM);
+  char buffer[512], lines[3 * 80], contents[512];
+
+  SD.remove(patchFilename);
+  File file = SD.open(patchFilename, FILE_WRITE);
+  IniWriter writer(file, buffer, sizeof(buffer));
+  IniFile::error_t err = IniPatch::diff(a, b, writer, lines, sizeof(lines));
+  writer.flush();
+  file.close();
+  size_t n = loadFile(patchFilename, contents, sizeof(contents));
+  cout << "  Patch: " << getErrorMessage(err) << ", " << n << " bytes" << endl
+       << string(contents, n);
+
+  IniFile patch(patchFilename);
+  patch.open();
+  SD.remove(patchedFilename);
+  file = SD.open(patchedFilename, FILE_WRITE);
+  IniWriter patchedWriter(file, buffer, sizeof(buffer));
+  err = IniPatch(patch).apply(a, patchedWriter, lines, sizeof(lines));
+  patchedWriter.flush();
+  file.close();
+  n = loadFile(patchedFilename, contents, sizeof(contents));
+  cout << "  Patched: " << getErrorMessage(err) << ", " << n << " bytes"
+       << endl << string(contents, n);
+}
+
+// Load a document into storage fixed at compile time and look up the
+// keys of asyncTest() every way there is, counting allocations
+void staticTest(const IniFile &source)
+{
+  static IniStaticDocument<2048, 100> document;
+  char buffer[80];
+  IniFile::error_t err = document.load(source, buffer, sizeof(buffer));
+  cout << "  Document: " << getErrorMessage(err) << ", "
+       << document.getSize() << " bytes, "
+       << document.getIndex().getNumEntries() << " entries" << endl;
+  IniStaticDocument<64, 100> smallDocument;
+  cout << "  Document of 64 bytes: "
+       << getErrorMessage(smallDocument.load(source, buffer, sizeof(buffer)))
+       << ", " << smallDocument.getSize() << " bytes" << endl;
+
+  IniFile &ini = document.getFile();
+  IniFile hashed(ini.getData(), ini.getDataLen(), IniFile::memoryRAM);
+  static IniStaticIndex<100, true, 128> index;
+  index.build(hashed, buffer, sizeof(buffer));
+  index.sort(hashed, buffer, sizeof(buffer));
+  err = index.buildHashTable(hashed, buffer, sizeof(buffer));
+  cout << "  Sorted index with hash table: " << getErrorMessage(err) << endl;
+  hashed.setIndex(&index);
+  IniFile sparse(ini.getData(), ini.getDataLen(), IniFile::memoryRAM);
+  IniStaticSparseIndex<4> sparseIndex;
+  sparseIndex.build(sparse, buffer, sizeof(buffer));
+  sparse.setSparseIndex(&sparseIndex);
+  IniStaticValueCache<4> cache(ini);
+  IniDirectIO io;
+  IniStaticLookup<80> lookup(ini, io);
+
+  allocations = 0;
+  deallocations = 0;
+  countAllocations = true;
+  string s(100, 'x');
+  countAllocations = false;
+  cout << "  A string of " << s.size() << " characters: " << allocations
+       << " allocations, " << deallocations << " frees" << endl;
+
+  int lookups = 0, found = 0;
+  allocations = 0;
+  deallocations = 0;
+  countAllocations = true;
+  for (int pass = 0; pass < 2; ++pass)
+    for (const AsyncKey *k = asyncKeys; k->key; ++k) {
+      found += ini.getValue(k->section, k->key, buffer, sizeof(buffer));
+      found += hashed.getValue(k->section, k->key, buffer, sizeof(buffer));
+      found += index.getValue(hashed, IniKey(k->section ? k->section : ""),
+			      IniKey(k->key), buffer, sizeof(buffer))
+	== IniFile::errorNoError;
+      found += sparse.getValue(k->section, k->key, buffer, sizeof(buffer));
+      long val;
+      found += cache.getValue(k->section, k->key, buffer, sizeof(buffer), val);
+      lookup.begin(k->section, k->key);
+      while (!lookup.poll())
+	;
+      found += (lookup.getError() == IniFile::errorNoError);
+      lookups += 6;
+    }
+  countAllocations = false;
+  cout << "  " << lookups << " lookups, " << found << " found: "
+       << allocations << " allocations, " << deallocations << " frees"
+       << endl;
+}
+
+// Open ini and look up some values, browse its sections and validate
+// it, then do the lookups again with an index
+void tracedLookups(IniFile &ini, IniIndex &index)
+{
+  char buffer[80];
+  ini.open();
+  ini.getValue("network", "mac", buffer, sizeof(buffer));
+  ini.getValue("misc", "missing", buffer, sizeof(buffer));
+  ini.getValue(NULL, "ip", buffer, sizeof(buffer));
+  IniFileState state;
+  while (ini.browseSections(buffer, sizeof(buffer), state))
+    ;
+  ini.validate(buffer, sizeof(buffer));
+  index.build(ini, buffer, sizeof(buffer));
+  ini.setIndex(&index);
+  ini.getValue("network", "mac", buffer, sizeof(buffer));
+  ini.getValue("misc", "missing", buffer, sizeof(buffer));
+  ini.setIndex(NULL);
+}
+
+// Print the number of times each operation finished, failed and the
+// bytes it read, which unlike the times are always the same, then
+// write a Chrome trace of the same operations
+void traceTest(const char *filename)
+{
+  IniFile ini(filename);
+  IniIndexEntry entries[100];
+  IniIndex index(entries, 100);
+  IniTraceTotals totals;
+  ini.setTrace(&totals);
+  tracedLookups(ini, index);
+  for (uint8_t op = 0; op < IniTrace::numOps; ++op)
+    cout << "  " << IniTrace::getOpName(op) << ": " << totals.getCount(op)
+	 << " times, " << totals.getErrors(op) << " errors, "
+	 << totals.getBytesRead(op) << " bytes" << endl;
+  cout << "  " << totals.getBytesRead() << " bytes read in total" << endl;
+
+  IniChromeTrace trace;
+  trace.setOps(IniTrace::allOps & ~(1 << IniTrace::opReadLine));
+  ini.setTrace(&trace);
+  tracedLookups(ini, index);
+  ini.setTrace(NULL);
+  const char traceFilename[] = "trace.json";
+  bool written = trace.write(traceFilename);
+  char contents[4096];
+  size_t n = loadFile(traceFilename, contents, sizeof(contents) - 1);
+  contents[n] = '\0';
+  cout << "  Chrome trace of " << trace.getNumEvents() << " events written? "
+       << (written ? "true" : "false") << ", complete? "
+       << (strncmp(contents, "{\"traceEvents\":[", 16) == 0 &&
+	   strstr(contents, "\"name\":\"findKey\"") &&
+	   strcmp(contents + n - 3, "\"}\n") == 0 ? "true" : "false")
+       << endl;
+}
+
+const IniSchemaKey testSchema[] = {
+  {"network", "mac", IniSchema::typeMACAddress, IniSchema::flagRequired,
+   0, 0, NULL, NULL},
+  {"network", "ip", IniSchema::typeIPAddress, IniSchema::flagRequired,
+   0, 0, NULL, NULL},
+  {"network", "hosts allow", IniSchema::typeString, IniSchema::flagRange,
+   1, 20, NULL, NULL},
+  {"network2", "hosts allow", IniSchema::typeString, 0, 0, 0, NULL, NULL},
+  {NULL, "gateway", IniSchema::typeIPAddress, 0, 0, 0, NULL, NULL},
+  {"misc", "pi", IniSchema::typeDouble, IniSchema::flagRange, 3, 4, NULL,
+   NULL},
+  {"misc", "string", IniSchema::typeString, IniSchema::flagRange, 0, 40,
+   NULL, NULL},
+  {"misc", "string2", IniSchema::typeLong, 0, 0, 0, NULL, NULL},
+  {"misc", "timeout", IniSchema::typeLong, IniSchema::flagRange, 1, 60,
+   NULL, "30"},
+  {"misc", "retries", IniSchema::typeLong, IniSchema::flagRequired, 0, 0,
+   NULL, "3"},
+  {"/src", "handler", IniSchema::typeChoice, 0, 0, 0,
+   "default|prohibit|status|temporary redirect", NULL},
+  {"/data/private", "handler", IniSchema::typeChoice, 0, 0, 0,
+   "default|status", NULL},
+  {"/upload", "allow put", IniSchema::typeBool, 0, 0, 0, NULL, NULL},
+  {"/upload", "max size", IniSchema::typeLong, 0, 0, 0, NULL, "1k"},
+};
+
+const char* schemaStatus[] = {
+  "missing", "default", "valid", "invalid", "out of range",
+};
+
+const char typedImageFilename[] = "typed.ini.img";
+
+// Check every key of testSchema in one pass and print the results,
+// checking that keys are found on the lines that getValue() finds
+void schemaTest(IniFile &ini)
+{
+  const uint16_t numKeys = sizeof(testSchema) / sizeof(testSchema[0]);
+  IniSchemaValue values[numKeys];
+  IniSchema schema(testSchema, values, numKeys);
+  char buffer[80];
+  bool b = ini.validate(buffer, sizeof(buffer), schema);
+  cout << "  validate(): " << (b ? "true" : "false") << ", "
+       << getErrorMessage(ini.getError()) << ", " << schema.getNumMissing()
+       << " missing, " << schema.getNumInvalid() << " invalid" << endl;
+  int differ = 0;
+  for (uint16_t n = 0; n < numKeys; ++n) {
+    const IniSchemaKey &k = schema.getKey(n);
+    const IniSchemaValue &v = schema.getValue(n);
+    cout << "    " << (k.section ? k.section : "(none)") << ": " << k.key
+	 << ": " << schemaStatus[v.status];
+    if (v.line)
+      cout << " on line " << v.line;
+    if (v.status == IniSchema::statusValid ||
+	v.status == IniSchema::statusDefault) {
+      cout << ", ";
+      switch (k.type) {
+      case IniSchema::typeString:
+	schema.getString(ini, n, buffer, sizeof(buffer));
+	cout << '"' << buffer << '"';
+	break;
+      case IniSchema::typeBool:
+	cout << (v.value.b ? "true" : "false");
+	break;
+      case IniSchema::typeLong:
+	cout << v.value.l;
+	break;
+      case IniSchema::typeDouble:
+	cout << v.value.d;
+	break;
+      case IniSchema::typeChoice:
+	cout << "choice " << v.value.choice;
+	break;
+      case IniSchema::typeIPAddress:
+	cout << int(v.value.bytes[0]) << '.' << int(v.value.bytes[1]) << '.'
+	     << int(v.value.bytes[2]) << '.' << int(v.value.bytes[3]);
+	break;
+      case IniSchema::typeMACAddress:
+	cout << hex << int(v.value.bytes[0]) << ":" << int(v.value.bytes[5])
+	     << dec;
+	break;
+      }
+    }
+    cout << endl;
+
+    uint32_t lineNumber, position;
+    bool found = ini.getValue(k.section, k.key, buffer, sizeof(buffer),
+			      lineNumber, position);
+    if (found != (v.line != 0) || (found && lineNumber != v.line))
+      ++differ;
+  }
+  cout << "    " << differ << " differ from getValue()" << endl;
+
+  const char data[] = "[a]\nsmall = 200\nbig = 300\nbad = 12abc\n";
+  IniFile mem(data, strlen(data), IniFile::memoryRAM);
+  const char* keys[] = {"small", "big", "bad"};
+  for (int i = 0; i < 3; ++i) {
+    uint8_t u8 = 0;
+    uint16_t u16 = 0;
+    bool b8 = mem.getValue("a", keys[i], buffer, sizeof(buffer), u8);
+    bool b16 = mem.getValue("a", keys[i], buffer, sizeof(buffer), u16);
+    cout << "  " << keys[i] << " as uint8_t: " << (b8 ? "true" : "false")
+	 << " " << int(u8) << ", as uint16_t: " << (b16 ? "true" : "false")
+	 << " " << u16 << endl;
+  }
+
+  // The same values read through a cache (twice, so once from the
+  // cache) and an image must convert as strictly
+  IniCachedValue cached[8];
+  IniValueCache cache(mem, cached, 8);
+  SD.remove(typedImageFilename);
+  File file = SD.open(typedImageFilename, FILE_WRITE);
+  char writeBuffer[128];
+  IniWriter writer(file, writeBuffer, sizeof(writeBuffer));
+  IniImageKey imageKeys[8];
+  IniImage::compile(mem, writer, buffer, sizeof(buffer), imageKeys, 8);
+  file.close();
+  IniFile imageFile(typedImageFilename);
+  imageFile.open();
+  IniImage image(imageFile);
+  image.open();
+  int cacheDiffer = 0, imageDiffer = 0;
+  for (int pass = 0; pass < 2; ++pass)
+    for (int i = 0; i < 3; ++i) {
+      uint8_t u8 = 0, c8 = 0, i8 = 0;
+      uint16_t u16 = 0, c16 = 0, i16 = 0;
+      bool b8 = mem.getValue("a", keys[i], buffer, sizeof(buffer), u8);
+      bool b16 = mem.getValue("a", keys[i], buffer, sizeof(buffer), u16);
+      if (cache.getValue("a", keys[i], buffer, sizeof(buffer), c8) != b8 ||
+	  c8 != u8 ||
+	  cache.getValue("a", keys[i], buffer, sizeof(buffer), c16) != b16 ||
+	  c16 != u16)
+	++cacheDiffer;
+      if (image.getValue("a", keys[i], buffer, sizeof(buffer), i8) != b8 ||
+	  i8 != u8 ||
+	  image.getValue("a", keys[i], buffer, sizeof(buffer), i16) != b16 ||
+	  i16 != u16)
+	++imageDiffer;
+    }
+  imageFile.close();
+  cout << "  " << cacheDiffer << " differ through IniValueCache ("
+       << cache.getHits() << " hits), " << imageDiffer
+       << " through IniImage" << endl;
+}
+
+// Read some values twice through a cache, printing the values and the
+// number of lookups answered by the cache
+void valueCacheTest(IniValueCache &cache, char *buffer, size_t len)
+{
+  uint8_t mac[6];
+  uint8_t ip[4];
+  double pi = 0;
+  long val = 0;
+  for (int pass = 0; pass < 2; ++pass) {
+    bool found = cache.getMACAddress("network", "mac", buffer, len, mac);
+    cout << "  mac: " << (found ? "found" : "not found");
+    if (found)
+      cout << hex << " " << int(mac[0]) << ":" << int(mac[5]) << dec;
+    found = cache.getIPAddress("network", "ip", buffer, len, ip);
+    cout << ", ip: " << (found ? "found" : "not found");
+    if (found)
+      cout << " " << int(ip[0]) << '.' << int(ip[1]) << '.' << int(ip[2])
+	   << '.' << int(ip[3]);
+    found = cache.getValue("misc", "pi", buffer, len, pi);
+    cout << ", pi: " << (found ? "found" : "not found");
+    if (found)
+      cout << " " << pi;
+    found = cache.getValue("misc", "missing", buffer, len, val);
+    cout << ", missing: " << getErrorMessage(cache.getError()) << endl;
+  }
+  cout << "    " << cache.getHits() << " hits, " << cache.getMisses()
+       << " misses" << endl;
+}
+
+// Keys whose hashes are the same are told apart by their names, and a
+// name too long to copy into the cache is read from the file each time
+void valueCacheCollisionTest(void)
+{
+  const char data[] = "[c]\nqzcmfnde = 1\nbekikogo = 2\n"
+    "a rather long key name = 3\n";
+  IniFile ini(data, strlen(data), IniFile::memoryRAM);
+  IniCachedValue values[4];
+  IniValueCache cache(ini, values, 4);
+  char buffer[40];
+  const char *keys[] = {"qzcmfnde", "bekikogo", "a rather long key name"};
+  // The cache sets the lowest bit of every hash
+  cout << "  Same hash? "
+       << ((IniTokenizer::hash(keys[0]) | 1) ==
+	   (IniTokenizer::hash(keys[1]) | 1) ? "true" : "false")
+       << ", values:";
+  for (int pass = 0; pass < 2; ++pass)
+    for (int i = 0; i < 3; ++i) {
+      long val = 0;
+      cache.getValue("c", keys[i], buffer, sizeof(buffer), val);
+      cout << " " << val;
+    }
+  cout << ", " << cache.getHits() << " hits, " << cache.getMisses()
+       << " misses" << endl;
+}
+
+void printNetAddress(const IniNetAddress &addr)
+{
+  if (addr.family == IniNetAddress::familyIPv4)
+    cout << int(addr.addr[0]) << '.' << int(addr.addr[1]) << '.'
+	 << int(addr.addr[2]) << '.' << int(addr.addr[3]);
+  else {
+    cout << hex;
+    for (int i = 0; i < 16; i += 2)
+      cout << (i ? ":" : "") << ((addr.addr[i] << 8) | addr.addr[i + 1]);
+    cout << dec;
+  }
+  cout << '/' << int(addr.prefix);
+}
+
+// Read every key of the sections in nettest.ini as a network value
+void networkTest(IniFile &ini)
+{
+  const char *acl[] = {"lan", "host", "v6net", "loopback", "mapped", "full",
+		       "big octet", "short", "bad prefix", "two gaps", NULL};
+  const char *servers[] = {"web", "db", "plain", "v6", "no port", "big port",
+			   NULL};
+  char buffer[80];
+  IniNetAddress lan, v6net;
+  ini.getNetAddress("acl", "lan", buffer, sizeof(buffer), lan);
+  ini.getNetAddress("acl", "v6net", buffer, sizeof(buffer), v6net);
+  for (const char **key = acl; *key; ++key) {
+    IniNetAddress addr;
+    cout << "  " << *key << ": ";
+    if (ini.getNetAddress("acl", *key, buffer, sizeof(buffer), addr)) {
+      printNetAddress(addr);
+      cout << ", in lan? "
+	   << (IniNetwork::contains(lan, addr) ? "true" : "false")
+	   << ", in v6net? "
+	   << (IniNetwork::contains(v6net, addr) ? "true" : "false");
+    }
+    else
+      cout << "not valid";
+    uint8_t ip[4];
+    cout << ", getIPAddress() "
+	 << (ini.getIPAddress("acl", *key, buffer, sizeof(buffer), ip) ?
+	     "true" : "false") << endl;
+  }
+  for (const char **key = servers; *key; ++key) {
+    char *host;
+    uint16_t port = 80;
+    cout << "  " << *key << ": ";
+    if (ini.getHostPort("servers", *key, buffer, sizeof(buffer), &host, port))
+      cout << host << " port " << port << endl;
+    else
+      cout << "not valid" << endl;
+  }
+}
+
+// Resolve the references in data, printing the outcome
+void interpolationTest(const char *data)
+{
+  IniFile ini(data, strlen(data), IniFile::memoryRAM);
+  IniIndexEntry entries[10];
+  IniIndex index(entries, 10);
+  char buffer[80];
+  index.build(ini, buffer, sizeof(buffer));
+  ini.setIndex(&index);
+  char arena[100];
+  IniResolvedValue values[4];
+  IniInterpolation interpolation(arena, sizeof(arena), values, 4);
+  int e = interpolation.resolve(ini, buffer, sizeof(buffer));
+  cout << "  Resolve: " << getErrorMessage(e) << " at line "
+       << interpolation.getErrorLine() << endl;
+}
+
+// Look up every key of syntaxtest.ini with the given syntax, by reading
+// the file, through the index and with IniAsyncLookup
+void syntaxTest(IniFile &ini, uint8_t syntax, IniIndex &index)
+{
+  const char *keys[][2] = {
+    {"quotes", "padded"}, {"quotes", "semicolon"}, {"quotes", "escapes"},
+    {"quotes", "mixed"}, {"quotes", "unclosed"}, {"comments", "hash"},
+    {"comments", "tight"}, {"comments", "only"}, {"comments", "url"},
+    {"continuation", "list"}, {"continuation", "quoted"},
+    {"continuation", "spaces"}, {"continuation", "comment"},
+    {"continuation", "last"}, {"continuation", "next"},
+    {"continuation", "after"}, {NULL, NULL},
+  };
+  char buffer[80];
+  char indexed[80];
+  ini.setSyntax(syntax);
+  cout << "  Syntax " << int(syntax) << endl;
+  ini.setIndex(NULL);
+  for (int i = 0; keys[i][0]; ++i) {
+    ini.getValue(keys[i][0], keys[i][1], buffer, sizeof(buffer));
+    int e = ini.getError();
+    cout << "    " << keys[i][1] << ": " << getErrorMessage(e);
+    if (e == IniFile::errorNoError) {
+      cout << ", \"";
+      for (const char *cp = buffer; *cp; ++cp)
+	if (*cp == '\t')
+	  cout << "\\t";
+	else
+	  cout << *cp;
+      cout << "\"";
+    }
+    cout << endl;
+
+    int ei = index.build(ini, indexed, sizeof(indexed));
+    if (ei == IniFile::errorNoError)
+      ei = index.getValue(ini, keys[i][0], keys[i][1], indexed,
+			  sizeof(indexed));
+    IniDirectIO io;
+    IniAsyncLookup lookup(ini, io);
+    char async[80];
+    if (lookup.begin(keys[i][0], keys[i][1], async, sizeof(async)))
+      while (!lookup.poll())
+	;
+    if (ei != e || lookup.getError() != e ||
+	(e == IniFile::errorNoError && (strcmp(indexed, buffer) != 0 ||
+					strcmp(async, buffer) != 0)))
+      cout << "      index or async lookup differs" << endl;
+  }
+  IniFileState state;
+  char *key, *value;
+  cout << "    Keys of continuation:";
+  while (ini.browseKeys("continuation", "*", buffer, sizeof(buffer), state,
+			&key, &value))
+    cout << " " << key << "=\"" << value << "\"";
+  cout << endl;
+}
+
+// Names hashed by the compiler
+static constexpr IniKey networkKey("network"), macKey("mac");
+static_assert(macKey.getLength() == 3, "IniKey is not constexpr");
+
+// Look up keys by IniKey through an index with a hash table and compare
+// with looking them up by name
+void iniKeyTest(IniFile &ini, IniIndex &index, IniIndex::entry_t *slots,
+		IniIndex::entry_t numSlots, bool verbose)
+{
+  char buffer[80];
+  char hashed[80];
+  int e = index.build(ini, buffer, sizeof(buffer));
+  if (e == IniFile::errorNoError)
+    e = index.buildHashTable(ini, buffer, sizeof(buffer), slots, numSlots);
+  cout << "  Hash table with " << numSlots << " slots: " << getErrorMessage(e)
+       << ", hash table? " << (index.hasHashTable() ? "true" : "false")
+       << endl;
+  int differ = 0;
+  for (int i = 0; asyncKeys[i].key; ++i) {
+    if (asyncKeys[i].section == NULL)
+      continue;
+    ini.getValue(asyncKeys[i].section, asyncKeys[i].key, buffer,
+		 sizeof(buffer));
+    int e1 = ini.getError();
+    ini.getValue(IniKey(asyncKeys[i].section), IniKey(asyncKeys[i].key),
+		 hashed, sizeof(hashed));
+    int e2 = ini.getError();
+    if (verbose) {
+      cout << "    " << asyncKeys[i].section << ":" << asyncKeys[i].key
+	   << ": " << getErrorMessage(e2);
+      if (e2 == IniFile::errorNoError)
+	cout << ", \"" << hashed << "\"";
+      cout << endl;
+    }
+    if (e1 != e2 || (e1 == IniFile::errorNoError && strcmp(buffer, hashed)))
+      ++differ;
+  }
+  cout << "    " << differ << " lookups differ from lookups by name" << endl;
+}
+
+// Look up keys through a sparse index of numCheckpoints checkpoints
+// and compare with searching the file
+void sparseIndexTest(IniFile &ini, uint16_t numCheckpoints)
+{
+  char buffer[80];
+  char sparse[80];
+  IniCheckpoint checkpoints[16];
+  IniSparseIndex index(checkpoints, numCheckpoints);
+  int e = index.build(ini, buffer, sizeof(buffer));
+  cout << "  Sparse index of " << numCheckpoints << ": "
+       << getErrorMessage(e) << ", " << index.getNumCheckpoints()
+       << " checkpoints of " << index.getSectionsPerCheckpoint()
+       << " sections" << endl;
+  const char *keys[][2] = {
+    {"network", "mac"}, {"network2", "subnet mask"}, {"misc", "pi"},
+    {"mime types", "pdf"}, {"/data/private", "handler"},
+    {"/upload", "allow put"}, {"/src", "handler"}, {"/cgi", "location"},
+    {"fake", "mac"}, {NULL, "ip"}, {NULL, NULL},
+  };
+  int differ = 0;
+  for (int i = 0; keys[i][1]; ++i) {
+    IniFileState state, sparseState;
+    ini.setSparseIndex(NULL);
+    while (!ini.getValue(keys[i][0], keys[i][1], buffer, sizeof(buffer),
+			 state))
+      ;
+    int e1 = ini.getError();
+    ini.setSparseIndex(&index);
+    while (!ini.getValue(keys[i][0], keys[i][1], sparse, sizeof(sparse),
+			 sparseState))
+      ;
+    int e2 = ini.getError();
+    if (e1 != e2 || (e1 == IniFile::errorNoError &&
+		     (strcmp(buffer, sparse) != 0 ||
+		      state.getLineNumber() != sparseState.getLineNumber())))
+      ++differ;
+    if (i == 4)
+      cout << "    " << keys[i][0] << ":" << keys[i][1] << " \"" << sparse
+	   << "\" at line " << sparseState.getLineNumber() << endl;
+  }
+  ini.setSparseIndex(NULL);
+  cout << "    " << differ << " lookups differ from searching the file"
+       << endl;
+}
+
+// Look up keys in a generated file of sorted sections by binary search
+// and compare with searching the file
+void sortedSectionsTest(bool caseSensitive)
+{
+  string data = "; generated\nversion = 1\n";
+  char name[20];
+  for (int i = 0; i < 200; ++i) {
+    snprintf(name, sizeof(name), "%s%03d", (i % 2 ? "Sect" : "sect"), i);
+    data = data + "[" + name + "]\nid = " + to_string(i) + "\n; comment\n"
+      + "name = " + name + "\n\n";
+  }
+  IniFile ini(data.c_str(), data.size(), IniFile::memoryRAM, caseSensitive);
+  char buffer[80];
+  bool sorted = ini.checkSortedSections(buffer, sizeof(buffer));
+  cout << "  Case sensitive? " << (caseSensitive ? "true" : "false")
+       << ", sorted? " << (sorted ? "true" : "false") << endl;
+  ini.setSortedSections(sorted);
+  int found = 0, differ = 0;
+  for (int i = -1; i <= 200; ++i) {
+    snprintf(name, sizeof(name), "sect%03d", i);
+    IniFileState state;
+    while (!ini.getValue(name, "name", buffer, sizeof(buffer), state))
+      ;
+    int e1 = ini.getError();
+    uint32_t position = state.getPosition();
+    string value = buffer;
+    ini.setSortedSections(false);
+    ini.getValue(name, "name", buffer, sizeof(buffer));
+    ini.setSortedSections(sorted);
+    if (e1 == IniFile::errorNoError)
+      ++found;
+    if (e1 != ini.getError() ||
+	(e1 == IniFile::errorNoError &&
+	 (value != buffer || position != data.find("name = " + value))))
+      ++differ;
+  }
+  cout << "    " << found << " found, " << differ
+       << " differ from searching the file" << endl;
+  ini.getValue(NULL, "version", buffer, sizeof(buffer));
+  cout << "    version: " << getErrorMessage(ini.getError()) << ", \""
+       << buffer << "\"" << endl;
+}
+
 int main(void)
 {
 
@@ -164,6 +1398,386 @@ int main(void)
   runTest(testIni);
   browseTestIni.open();
   browseTest(browseTestIni);
+
+  cout << "*** Testing IniFile(const char*, size_t) ***" << endl;
+  static char testIniData[2048];
+  static char browseTestIniData[2048];
+  size_t testIniLen = loadFile(testIniFilename, testIniData,
+			       sizeof(testIniData));
+  size_t browseTestIniLen = loadFile(browseTestIniFilename, browseTestIniData,
+				     sizeof(browseTestIniData));
+  IniFile memoryIni(testIniData, testIniLen, IniFile::memoryRAM);
+  IniFile browseMemoryIni(browseTestIniData, browseTestIniLen,
+			  IniFile::memoryRAM);
+  runTest(memoryIni);
+  browseTest(browseMemoryIni);
+
+  cout << "*** Testing IniFile with IniInflate ***" << endl;
+  char compressedIniFilename[] = "test.ini.gz";
+  static uint8_t window[1024];
+  IniInflate inflate(window, sizeof(window));
+  IniFile compressedIni(compressedIniFilename);
+  compressedIni.setInflate(&inflate);
+  compressedIni.open();
+  runTest(compressedIni);
+
+  cout << "*** Testing IniFile with IniIndex ***" << endl;
+  const int maxEntries = 40;
+  IniIndexEntry entries[maxEntries];
+  IniIndex index(entries, maxEntries);
+  char buffer[80];
+  testIni.setIndex(&index);
+  int e = index.build(testIni, buffer, sizeof(buffer));
+  cout << "Index build: " << getErrorMessage(e) << ", "
+       << index.getNumEntries() << " entries" << endl;
+  runTest(testIni);
+  testIni.open();
+  cout << "  Index valid after open()? "
+       << (index.isValid() ? "true" : "false") << endl;
+
+  // Split test.ini into chunks of (at least) 1 byte, ie one per thread
+  IniIndexEntry parallelEntries[maxEntries];
+  IniIndex parallelIndex(parallelEntries, maxEntries);
+  memoryIni.setIndex(&parallelIndex);
+  e = parallelIndex.buildParallel(memoryIni, buffer, sizeof(buffer), 4, 1);
+  cout << "Parallel index build: " << getErrorMessage(e) << ", "
+       << parallelIndex.getNumEntries() << " entries" << endl;
+  bool same = (index.build(memoryIni, buffer, sizeof(buffer)) == 0 &&
+	       index.getNumEntries() == parallelIndex.getNumEntries());
+  for (IniIndex::entry_t i = 0; same && i < index.getNumEntries(); ++i) {
+    const IniIndexEntry &a = index.getEntry(i);
+    const IniIndexEntry &b = parallelIndex.getEntry(i);
+    same = (a.position == b.position && a.hash == b.hash &&
+	    a.section == b.section && a.type == b.type);
+  }
+  cout << "  Same as sequential index? " << (same ? "true" : "false") << endl;
+  runTest(memoryIni);
+
+  // More lines than 16 bit entry numbers could hold
+  string large;
+  for (int i = 0; i < 1000; ++i) {
+    large += "[s" + to_string(i) + "]\n";
+    for (int k = 0; k < 69; ++k)
+      large += "k" + to_string(k) + " = " + to_string(i * 100 + k) + "\n";
+  }
+  vector<IniIndexEntry> largeEntries(80000);
+  IniIndex largeIndex(largeEntries.data(), largeEntries.size());
+  IniFile largeIni(large.data(), large.size(), IniFile::memoryRAM);
+  largeIni.setIndex(&largeIndex);
+  e = largeIndex.buildParallel(largeIni, buffer, sizeof(buffer), 4);
+  bool found = largeIni.getValue("s999", "k68", buffer, sizeof(buffer));
+  cout << "Large index build: " << getErrorMessage(e) << ", "
+       << largeIndex.getNumEntries() << " entries, s999 k68 = "
+       << (found ? buffer : getErrorMessage(largeIni.getError())) << endl;
+
+  // Entries run out
+  IniIndex smallIndex(entries, 5);
+  e = smallIndex.build(testIni, buffer, sizeof(buffer));
+  cout << "Small index build: " << getErrorMessage(e) << endl;
+
+  cout << "*** Testing locations ***" << endl;
+  testIni.setIndex(NULL);
+  locationTest(testIni);
+  testIni.setIndex(&index);
+  index.build(testIni, buffer, sizeof(buffer));
+  locationTest(testIni);
+  IniFileState state;
+  char sectName[80];
+  cout << "  Sections in " << browseTestIni.getFilename() << endl;
+  while (browseTestIni.browseSections(sectName, sizeof(sectName), state))
+    cout << "    " << sectName << " at line " << state.getLineNumber()
+	 << ", position " << state.getPosition() << endl;
+
+  cout << "*** Testing validate() ***" << endl;
+  char validateTestIniFilename[] = "validatetest.ini";
+  IniFile validateTestIni(validateTestIniFilename);
+  validateTestIni.open();
+  validateTest(testIni, 80);
+  validateTest(validateTestIni, 80);
+  validateTest(validateTestIni, 100);
+  duplicateTest(false);
+  duplicateTest(true);
+
+  cout << "*** Testing IniWriter ***" << endl;
+  writeTest("writetest.ini");
+  copyTest(memoryIni, "copytest.ini");
+  copyTest(compressedIni, "copytest.ini");
+
+  cout << "*** Testing IniImage ***" << endl;
+  imageTest(testIni, browseTestIni, "test.ini.img");
+
+  cout << "*** Testing browseKeys() ***" << endl;
+  char keyTestIniFilename[] = "keytest.ini";
+  IniFile keyTestIni(keyTestIniFilename);
+  keyTestIni.open();
+  keyTest(keyTestIni);
+  keyTestIni.setCaseSensitive(true);
+  keyTest(keyTestIni);
+  keyTestIni.setCaseSensitive(false);
+  IniIndexEntry keyEntries[maxEntries];
+  IniIndex keyIndex(keyEntries, maxEntries);
+  IniIndex::entry_t order[maxEntries];
+  keyTestIni.setIndex(&keyIndex);
+  keyIndex.build(keyTestIni, buffer, sizeof(buffer));
+  e = keyIndex.sort(keyTestIni, buffer, sizeof(buffer), order);
+  cout << "Index sort: " << getErrorMessage(e) << ", sorted? "
+       << (keyIndex.isSorted(keyTestIni) ? "true" : "false") << endl;
+  keyTest(keyTestIni);
+  keyTestIni.setCaseSensitive(true);
+  keyIndex.sort(keyTestIni, buffer, sizeof(buffer), order);
+  keyTest(keyTestIni);
+  // The case-sensitive order cannot be searched without case
+  keyTestIni.setCaseSensitive(false);
+  cout << "  Case insensitive, sorted? "
+       << (keyIndex.isSorted(keyTestIni) ? "true" : "false") << endl;
+  keyTest(keyTestIni, "channels", "channel4*");
+
+  cout << "*** Testing IniAsyncLookup ***" << endl;
+  IniDirectIO directIO;
+  IniThreadIO threadIO;
+  asyncTest(memoryIni, directIO, "IniDirectIO", 80, true);
+  asyncTest(memoryIni, directIO, "IniDirectIO", 20, false);
+  asyncTest(memoryIni, directIO, "IniDirectIO", 3, false);
+  asyncTest(testIni, threadIO, "IniThreadIO", 80, false);
+  asyncTest(testIni, threadIO, "IniThreadIO", 21, false);
+  asyncTest(compressedIni, threadIO, "IniThreadIO", 40, false);
+  asyncTest(missingIni, directIO, "IniDirectIO", 80, false);
+
+  cout << "*** Testing IniBlockCache ***" << endl;
+  cacheTest(testIni, 4, 64, 0, true);
+  cacheTest(testIni, 4, 64, 0, false);
+  cacheTest(testIni, 4, 64, 2, false);
+  cacheTest(testIni, 2, 512, 0, false);
+  cacheTest(testIni, 2, 512, 1, false);
+  cacheTest(testIni, 1, 512, 0, false);
+
+  cout << "*** Testing IniDocumentCache ***" << endl;
+  IniFile memoryTestIni(testIniData, testIniLen, IniFile::memoryRAM);
+  documentTest(testIniFilename, memoryTestIni);
+  IniFile::error_t err;
+  IniDocumentCache &docs = IniDocumentCache::shared();
+  IniDocument::handle_t doc = docs.get("missing.ini", err);
+  cout << "  missing.ini: " << getErrorMessage(err) << ", document? "
+       << (doc ? "true" : "false") << endl;
+  writeFile("doctest.ini", "[a]\nkey = 1\n");
+  IniDocument::handle_t before = docs.get("doctest.ini", err);
+  writeFile("doctest.ini", "[a]\nkey = 22\n");
+  IniDocument::handle_t after = docs.get("doctest.ini", err);
+  long oldVal = 0, newVal = 0;
+  before->getValue("a", "key", buffer, sizeof(buffer), oldVal);
+  after->getValue("a", "key", buffer, sizeof(buffer), newVal);
+  cout << "  doctest.ini changed: old document " << oldVal
+       << ", new document " << newVal << ", same document? "
+       << (before == after ? "true" : "false") << endl;
+  // Replaced with one of the same size, perhaps within the same second
+  writeFile("doctest.tmp", "[a]\nkey = 33\n");
+  rename("doctest.tmp", "doctest.ini");
+  IniDocument::handle_t replaced = docs.get("doctest.ini", err);
+  replaced->getValue("a", "key", buffer, sizeof(buffer), newVal);
+  cout << "  doctest.ini replaced with the same size: " << newVal << endl;
+  // Threads which want the same new document at once share one load
+  writeFile("doctest.ini", "[a]\nkey = 4444\n");
+  uint32_t loads = docs.getLoads();
+  IniDocument::handle_t shared[4];
+  std::vector<std::thread> loaders;
+  for (int t = 0; t < 4; ++t)
+    loaders.push_back(std::thread([&, t]() {
+      IniFile::error_t e;
+      shared[t] = docs.get("doctest.ini", e);
+    }));
+  for (int t = 0; t < 4; ++t)
+    loaders[t].join();
+  cout << "  Loaded by 4 threads: " << docs.getLoads() - loads
+       << " loads, same document? "
+       << (shared[0] == shared[1] && shared[1] == shared[2] &&
+	   shared[2] == shared[3] ? "true" : "false") << endl;
+  cout << "  " << docs.size() << " documents, " << docs.getLoads()
+       << " loads" << endl;
+  docs.clear();
+  cout << "  After clear(): " << docs.size() << " documents, old still "
+       << "usable? " << (after->getValue("a", "key", buffer,
+					   sizeof(buffer)) == 0 ? "true" : "false")
+       << endl;
+
+  cout << "*** Testing IniLiveDocument ***" << endl;
+  liveDocumentTest();
+
+  cout << "*** Testing IniNetwork ***" << endl;
+  char netTestIniFilename[] = "nettest.ini";
+  IniFile netTestIni(netTestIniFilename);
+  netTestIni.open();
+  networkTest(netTestIni);
+
+  cout << "*** Testing IniInterpolation ***" << endl;
+  char interpTestIniFilename[] = "interptest.ini";
+  IniFile interpTestIni(interpTestIniFilename);
+  interpTestIni.open();
+  setenv("INIFILE_TEST_HOME", "/home/test", 1);
+  IniIndexEntry interpEntries[maxEntries];
+  IniIndex interpIndex(interpEntries, maxEntries);
+  interpTestIni.setIndex(&interpIndex);
+  interpIndex.build(interpTestIni, buffer, sizeof(buffer));
+  char arena[200];
+  IniResolvedValue resolved[8];
+  IniInterpolation interpolation(arena, sizeof(arena), resolved, 8);
+  interpTestIni.setInterpolation(&interpolation);
+  e = interpolation.resolve(interpTestIni, buffer, sizeof(buffer));
+  cout << "Resolve: " << getErrorMessage(e) << ", "
+       << interpolation.getNumValues() << " values, "
+       << interpolation.getArenaUsed() << " bytes" << endl;
+  const char *interpKeys[][2] = {
+    {"paths", "archive"}, {"paths", "logs"}, {"paths", "home"},
+    {"paths", "price"}, {"paths", "plain"}, {"server", "log file"},
+    {"server", "port"}, {NULL, NULL},
+  };
+  for (int i = 0; interpKeys[i][0]; ++i) {
+    interpTestIni.getValue(interpKeys[i][0], interpKeys[i][1], buffer,
+			   sizeof(buffer));
+    cout << "  " << interpKeys[i][1] << ": "
+	 << getErrorMessage(interpTestIni.getError()) << ", \"" << buffer
+	 << "\"" << endl;
+  }
+  long port = 0;
+  interpTestIni.getValue("server", "port", buffer, sizeof(buffer), port);
+  cout << "  port as long: " << port << endl;
+  interpTestIni.getValue("server", "log file", buffer, 20);
+  cout << "  log file with 20 byte buffer: "
+       << getErrorMessage(interpTestIni.getError()) << endl;
+  // A value cache must not keep values from before interpolation
+  // changed
+  IniCachedValue interpCached[4];
+  IniValueCache interpCache(interpTestIni, interpCached, 4);
+  long ports[3];
+  interpCache.getValue("server", "port", buffer, sizeof(buffer), ports[0]);
+  interpTestIni.setInterpolation(NULL);
+  interpCache.getValue("server", "port", buffer, sizeof(buffer), ports[1]);
+  interpTestIni.setInterpolation(&interpolation);
+  interpCache.getValue("server", "port", buffer, sizeof(buffer), ports[2]);
+  cout << "  port through a value cache: " << ports[0]
+       << ", detached: " << ports[1] << ", attached again: " << ports[2]
+       << endl;
+  interpTestIni.open();
+  cout << "  Valid after open()? "
+       << (interpolation.isValid(interpTestIni) ? "true" : "false") << endl;
+  interpolationTest("[a]\nx = ${y}\ny = ${x}\n");
+  interpolationTest("[a]\nx = ${x}\n");
+  interpolationTest("[a]\nx = 1\ny = ${b:x}\n");
+  interpolationTest("[a]\nx = ${ENV:INIFILE_TEST_MISSING}\n");
+  interpolationTest("[a]\nx = ${y\n");
+  interpolationTest("[a]\nx = 1234567890\ny = ${x}${x}${x}${x}${x}${x}"
+		    "${x}${x}${x}${x}${x}\n");
+
+  cout << "*** Testing value syntax ***" << endl;
+  char syntaxTestIniFilename[] = "syntaxtest.ini";
+  IniFile syntaxTestIni(syntaxTestIniFilename);
+  syntaxTestIni.open();
+  IniIndexEntry syntaxEntries[maxEntries];
+  IniIndex syntaxIndex(syntaxEntries, maxEntries);
+  syntaxTest(syntaxTestIni, 0, syntaxIndex);
+  syntaxTest(syntaxTestIni, IniFile::syntaxQuotes |
+	     IniFile::syntaxInlineComments | IniFile::syntaxContinuation,
+	     syntaxIndex);
+  syntaxTest(syntaxTestIni, IniFile::syntaxContinuation, syntaxIndex);
+
+  cout << "*** Testing IniKey ***" << endl;
+  cout << "  Hash same as IniTokenizer::hash()? "
+       << (networkKey.getHash() == IniTokenizer::hash("network") &&
+	   macKey.getHash() == IniTokenizer::hash("MAC") ? "true" : "false")
+       << endl;
+  IniIndex::entry_t slots[maxEntries + 1];
+  testIni.setIndex(&index);
+  iniKeyTest(testIni, index, slots, maxEntries + 1, true);
+  testIni.getValue(networkKey, macKey, buffer, sizeof(buffer));
+  cout << "  network:mac " << getErrorMessage(testIni.getError()) << ", \""
+       << buffer << "\"" << endl;
+  double pi = 0;
+  testIni.getValue(IniKey("misc"), IniKey("pi"), buffer, sizeof(buffer), pi);
+  cout << "  misc:pi " << getErrorMessage(testIni.getError()) << ", "
+       << pi << endl;
+  iniKeyTest(testIni, index, slots, 10, false);
+  testIni.setIndex(NULL);
+  testIni.getValue(networkKey, macKey, buffer, sizeof(buffer));
+  cout << "  network:mac without an index "
+       << getErrorMessage(testIni.getError()) << ", \"" << buffer << "\""
+       << endl;
+  const char duplicates[] =
+    "[a]\nx = 1\n[b]\nx = 2\n[A]\nx = 3\nsection = 4\n[c]\n[b]\n";
+  IniFile duplicateIni(duplicates, strlen(duplicates), IniFile::memoryRAM);
+  IniIndex duplicateIndex(entries, maxEntries);
+  duplicateIni.setIndex(&duplicateIndex);
+  duplicateIndex.build(duplicateIni, buffer, sizeof(buffer));
+  duplicateIndex.buildHashTable(duplicateIni, buffer, sizeof(buffer), slots,
+				maxEntries + 1);
+  const char *duplicateKeys[][2] = {
+    {"a", "x"}, {"b", "x"}, {"a", "section"}, {"c", "x"}, {"d", "x"},
+    {NULL, NULL},
+  };
+  for (int i = 0; duplicateKeys[i][0]; ++i) {
+    bool found = duplicateIni.getValue(IniKey(duplicateKeys[i][0]),
+				       IniKey(duplicateKeys[i][1]), buffer,
+				       sizeof(buffer));
+    cout << "  " << duplicateKeys[i][0] << ":" << duplicateKeys[i][1] << " "
+	 << getErrorMessage(duplicateIni.getError());
+    if (found)
+      cout << ", \"" << buffer << "\"";
+    cout << endl;
+  }
+
+  cout << "*** Testing IniSparseIndex ***" << endl;
+  testIni.setIndex(NULL);
+  sparseIndexTest(testIni, 16);
+  sparseIndexTest(testIni, 5);
+  sparseIndexTest(testIni, 1);
+  sparseIndexTest(testIni, 0);
+
+  cout << "*** Testing sorted sections ***" << endl;
+  cout << "  " << testIni.getFilename() << " sorted? "
+       << (testIni.checkSortedSections(buffer, sizeof(buffer)) ? "true"
+	   : "false") << endl;
+  sortedSectionsTest(false);
+  sortedSectionsTest(true);
+
+  cout << "*** Testing IniPatch ***" << endl;
+  patchTest("; settings\nversion = 2\n\n[network]\nip = 192.168.1.2\n"
+	    "gateway = 192.168.1.1\n\n; time\n[ntp]\nserver = pool.ntp.org\n",
+	    "; settings\nversion = 3\n\n[network]\nip = 192.168.1.3\n"
+	    "mask = 255.255.255.0\n\n[log]\nlevel = 2\n");
+  patchTest("[a]\nx = 1\n", "[a]\nx = 1\n");
+  {
+    const char badPatch[] = "[a]\nnot a key\n";
+    IniFile patch(badPatch, strlen(badPatch), IniFile::memoryRAM);
+    IniFile ini("[a]\nx = 1\n", 10, IniFile::memoryRAM);
+    SD.remove("patched.ini");
+    File file = SD.open("patched.ini", FILE_WRITE);
+    IniWriter writer(file, buffer, sizeof(buffer));
+    char lines[3 * 80];
+    cout << "  Bad patch: "
+	 << getErrorMessage(IniPatch(patch).apply(ini, writer, lines,
+						   sizeof(lines)))
+	 << endl;
+    file.close();
+  }
+
+  cout << "*** Testing static storage ***" << endl;
+  staticTest(testIni);
+
+  cout << "*** Testing IniTrace ***" << endl;
+  traceTest(testIniFilename);
+
+  cout << "*** Testing IniSchema ***" << endl;
+  schemaTest(testIni);
+
+  cout << "*** Testing IniValueCache ***" << endl;
+  IniCachedValue values[4];
+  IniValueCache valueCache(testIni, values, 4);
+  valueCacheTest(valueCache, buffer, sizeof(buffer));
+  testIni.open();
+  cout << "  After open()" << endl;
+  valueCacheTest(valueCache, buffer, sizeof(buffer));
+  IniValueCache smallValueCache(testIni, values, 2);
+  cout << "  Cache of 2 values" << endl;
+  valueCacheTest(smallValueCache, buffer, sizeof(buffer));
+  valueCacheCollisionTest();
   cout << "Done" << endl;
 
 }
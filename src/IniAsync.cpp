@@ -0,0 +1,337 @@
+#include "IniAsync.h"
+
+#include <string.h>
+
+IniDirectIO::IniDirectIO()
+{
+	_err = IniFile::errorNoError;
+	_bytesRead = 0;
+}
+
+bool IniDirectIO::startRead(const IniFile &ini, uint32_t pos,
+							char* buffer, size_t len)
+{
+	_err = ini.read(pos, buffer, len, _bytesRead);
+	return true;
+}
+
+bool IniDirectIO::readDone(IniFile::error_t &err, size_t &bytesRead)
+{
+	err = _err;
+	bytesRead = _bytesRead;
+	return true;
+}
+
+#if defined(INIFILE_HOST)
+IniThreadIO::IniThreadIO()
+{
+	_ini = nullptr;
+	_pos = 0;
+	_buffer = nullptr;
+	_len = 0;
+	_bytesRead = 0;
+	_err = IniFile::errorNoError;
+	_pending = false;
+	_done = false;
+	_stop = false;
+	_thread = std::thread(&IniThreadIO::run, this);
+}
+
+IniThreadIO::~IniThreadIO()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+	}
+	_wake.notify_one();
+	_thread.join();
+}
+
+bool IniThreadIO::startRead(const IniFile &ini, uint32_t pos,
+							char* buffer, size_t len)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_pending)
+			return false;
+		_ini = &ini;
+		_pos = pos;
+		_buffer = buffer;
+		_len = len;
+		_pending = true;
+		_done = false;
+	}
+	_wake.notify_one();
+	return true;
+}
+
+bool IniThreadIO::readDone(IniFile::error_t &err, size_t &bytesRead)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (!_done)
+		return false;
+	_done = false;
+	err = _err;
+	bytesRead = _bytesRead;
+	return true;
+}
+
+void IniThreadIO::run(void)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true) {
+		_wake.wait(lock, [this] { return _pending || _stop; });
+		if (_stop)
+			return;
+		// Read without holding the lock so that readDone() never waits
+		const IniFile* ini = _ini;
+		uint32_t pos = _pos;
+		char* buffer = _buffer;
+		size_t len = _len;
+		lock.unlock();
+		size_t bytesRead;
+		IniFile::error_t err = ini->read(pos, buffer, len, bytesRead);
+		lock.lock();
+		_err = err;
+		_bytesRead = bytesRead;
+		_pending = false;
+		_done = true;
+	}
+}
+#endif
+
+IniAsyncLookup::IniAsyncLookup(const IniFile &ini, IniAsyncIO &io)
+	: _ini(ini), _io(io)
+{
+	_section = NULL;
+	_key = NULL;
+	_sectionLength = 0;
+	_keyLength = 0;
+	_buffer = NULL;
+	_len = 0;
+	_used = 0;
+	_keep = 0;
+	_valueStart = 0;
+	_valueState = 0;
+	_bufferPos = 0;
+	_lineNumber = 0;
+	_linePosition = 0;
+	_skipNewline = '\0';
+	_state = stateDone;
+	_error = IniFile::errorNoError;
+	_callback = NULL;
+	_context = NULL;
+}
+
+bool IniAsyncLookup::begin(const char* section, const char* key,
+						   char* buffer, size_t len, callback_t callback,
+						   void* context)
+{
+	_section = section;
+	_key = key;
+	_sectionLength = (section == NULL ? 0 : strlen(section));
+	_keyLength = (key == NULL ? 0 : strlen(key));
+	_buffer = buffer;
+	_len = len;
+	_used = 0;
+	_keep = 0;
+	_valueStart = 0;
+	_valueState = 0;
+	_bufferPos = 0;
+	_lineNumber = 0;
+	_linePosition = 0;
+	_skipNewline = '\0';
+	_callback = callback;
+	_context = context;
+	_state = (section == NULL ? stateFindKey : stateFindSection);
+
+	if (!_ini.isOpen())
+		return !finish(IniFile::errorFileNotOpen);
+	if (len < 3)
+		return !finish(IniFile::errorBufferTooSmall);
+	if (section == NULL && (key == NULL || *key == '\0'))
+		return !finish(IniFile::errorKeyNotFound);
+	_error = IniFile::errorNoError;
+	return !readMore();
+}
+
+bool IniAsyncLookup::poll(void)
+{
+	if (_state == stateDone)
+		return true;
+
+	IniFile::error_t err;
+	size_t bytesRead;
+	if (!_io.readDone(err, bytesRead))
+		return false;
+	bool atEnd = (err == IniFile::errorEndOfFile);
+	if (atEnd)
+		bytesRead = 0;
+	else if (err != IniFile::errorNoError)
+		return finish(err);
+	_used += bytesRead;
+
+	// Look at every complete line in the buffer. A newline at the end
+	// of the data may be the first half of a two character newline,
+	// which is dealt with when the next data arrives. As for
+	// IniFile::readLine() the newline must be within len - 1 bytes of
+	// the start of the line; while collecting a value the lines are
+	// read after it, with less room.
+	size_t start = _keep;
+	while (true) {
+		if (_skipNewline != '\0' && start < _used) {
+			if (_buffer[start] == _skipNewline)
+				++start;
+			_skipNewline = '\0';
+		}
+		size_t end = start;
+		while (end < _used && _buffer[end] != '\n' && _buffer[end] != '\r')
+			++end;
+		if (end < _used) {
+			if (end - start >= _len - _keep - 1)
+				return tooLong(start);
+			_skipNewline = (_buffer[end] == '\n' ? '\r' : '\n');
+		}
+		else if (!atEnd || end == start)
+			break;
+
+		_buffer[end] = '\0';
+		if (_state != stateReadValue) {
+			++_lineNumber;
+			_linePosition = _bufferPos + start;
+		}
+		char* line = _buffer + start;
+		start = end + 1;
+		if (processLine(line, end == _used))
+			return true;
+	}
+
+	if (atEnd) {
+		if (_state == stateReadValue) {
+			_valueState = 0;
+			return continueValue(true);
+		}
+		return finish(_state == stateFindSection
+					  ? IniFile::errorSectionNotFound
+					  : IniFile::errorKeyNotFound);
+	}
+
+	// Keep any incomplete line and read the rest of it
+	if (_used - start >= _len - _keep)
+		return tooLong(start);
+	memmove(_buffer + _keep, _buffer + start, _used - start);
+	_bufferPos += start - _keep;
+	_used -= start - _keep;
+	return readMore();
+}
+
+// Returns true if the lookup is done. last is true for a final line
+// without a newline.
+bool IniAsyncLookup::processLine(char* line, bool last)
+{
+	// Lines which continue a value are skipped as by
+	// IniFile::readNextLine(), or added to the value being collected
+	uint8_t syntax = _ini.getSyntax();
+	if (_valueState & IniFile::valueContinues) {
+		if (_state != stateReadValue) {
+			IniFile::decodeValue(line, syntax, _valueState, false);
+			return false;
+		}
+		size_t n = IniFile::decodeValue(line, syntax, _valueState);
+		memmove(_buffer + _keep, line, n);
+		_keep += n;
+		return continueValue(last);
+	}
+	if (syntax & IniFile::syntaxContinuation) {
+		char* value = IniFile::findValue(line);
+		_valueState = 0;
+		if (value)
+			IniFile::decodeValue(value, syntax, _valueState, false);
+	}
+
+	char* cp = IniFile::skipWhiteSpace(line);
+	if (IniFile::isCommentChar(*cp))
+		return false;
+
+	if (_state == stateFindSection) {
+		if (*cp == '[') {
+			cp = IniFile::parseSection(cp);
+			if (cp != NULL && _ini.matchName(cp, _section, _sectionLength)) {
+				if (_key == NULL || *_key == '\0')
+					return finish(IniFile::errorKeyNotFound);
+				_state = stateFindKey;
+			}
+		}
+		return false;
+	}
+
+	if (_section && *cp == '[')
+		return finish(IniFile::errorKeyNotFound); // Start of the next section
+
+	char* value;
+	cp = IniFile::parseKey(cp, &value);
+	if (cp == NULL || !_ini.matchName(cp, _key, _keyLength))
+		return false;
+	if (syntax) {
+		// As IniFile::readValue(), the value is decoded where it would
+		// be if the line were at the start of the buffer
+		if (*IniFile::skipWhiteSpace(line) == '[')
+			syntax &= ~IniFile::syntaxContinuation;
+		_valueState = 0;
+		size_t n = IniFile::decodeValue(value, syntax, _valueState);
+		_valueStart = value - line;
+		memmove(_buffer + _valueStart, value, n);
+		_keep = _valueStart + n;
+		_state = stateReadValue;
+		return continueValue(false);
+	}
+	value = IniFile::skipWhiteSpace(value);
+	IniFile::removeTrailingWhiteSpace(value);
+	memmove(_buffer, value, strlen(value) + 1);
+	return finish(IniFile::errorNoError);
+}
+
+// Returns true if the lookup is done. As IniFile::readValue() the next
+// line needs room for at least one character, unless there is none.
+bool IniAsyncLookup::continueValue(bool last)
+{
+	if (_valueState & IniFile::valueContinues) {
+		if (_len - _keep < 3 && !last)
+			return finish(IniFile::errorBufferTooSmall);
+		return false;
+	}
+	memmove(_buffer, _buffer + _valueStart, _keep - _valueStart);
+	_buffer[_keep - _valueStart] = '\0';
+	return finish(IniFile::errorNoError);
+}
+
+bool IniAsyncLookup::finish(IniFile::error_t err)
+{
+	_error = err;
+	_state = stateDone;
+	if (_callback)
+		_callback(*this, _context);
+	return true;
+}
+
+// The line at start does not fit in the buffer. As readLine() as much
+// as fits is left in the buffer.
+bool IniAsyncLookup::tooLong(size_t start)
+{
+	if (_state == stateReadValue)
+		return finish(IniFile::errorBufferTooSmall);
+	memmove(_buffer, _buffer + start, _len - 1);
+	_buffer[_len - 1] = '\0';
+	++_lineNumber;
+	_linePosition = _bufferPos + start;
+	return finish(IniFile::errorBufferTooSmall);
+}
+
+// Returns true if the lookup is done
+bool IniAsyncLookup::readMore(void)
+{
+	uint32_t pos = _bufferPos + _used;
+	if (!_io.startRead(_ini, pos, _buffer + _used, _len - _used))
+		return finish(IniFile::errorUnknownError);
+	return false;
+}
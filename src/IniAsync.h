@@ -0,0 +1,201 @@
+#ifndef _INIASYNC_H
+#define _INIASYNC_H
+
+#include "IniFile.h"
+
+#if defined(INIFILE_HOST)
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+#if defined(INIFILE_HOST) && defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+
+// Source of reads for IniAsyncLookup. An implementation starts a read
+// and reports later when it has finished, so that the caller can get
+// on with other work meanwhile; for instance a DMA transfer from an SD
+// card or a read by another thread. Only one read is outstanding at a
+// time.
+class IniAsyncIO {
+public:
+	virtual ~IniAsyncIO() {}
+
+	// Start reading up to len bytes from pos, as IniFile::read().
+	// Returns false if the read could not be started.
+	virtual bool startRead(const IniFile &ini, uint32_t pos,
+						   char* buffer, size_t len) = 0;
+
+	// True once the read has finished, with err and bytesRead as
+	// IniFile::read() would give. Must not block.
+	virtual bool readDone(IniFile::error_t &err, size_t &bytesRead) = 0;
+};
+
+// Reads at once with IniFile::read(), for data sources which are fast
+// enough not to need anything better (memory, or small files).
+class IniDirectIO : public IniAsyncIO {
+public:
+	IniDirectIO();
+
+	virtual bool startRead(const IniFile &ini, uint32_t pos,
+						   char* buffer, size_t len);
+	virtual bool readDone(IniFile::error_t &err, size_t &bytesRead);
+
+private:
+	IniFile::error_t _err;
+	size_t _bytesRead;
+};
+
+#if defined(INIFILE_HOST)
+// Reads with a worker thread, so that an event loop is never held up
+// by the file system. The IniFile must not be used by anything else
+// while a read is in progress.
+class IniThreadIO : public IniAsyncIO {
+public:
+	IniThreadIO();
+	virtual ~IniThreadIO();
+
+	virtual bool startRead(const IniFile &ini, uint32_t pos,
+						   char* buffer, size_t len);
+	virtual bool readDone(IniFile::error_t &err, size_t &bytesRead);
+
+private:
+	void run(void);
+
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	const IniFile* _ini;
+	uint32_t _pos;
+	char* _buffer;
+	size_t _len;
+	size_t _bytesRead;
+	IniFile::error_t _err;
+	bool _pending;
+	bool _done;
+	bool _stop;
+	std::thread _thread;
+};
+#endif
+
+// Look up a value without blocking. begin() starts the lookup and
+// poll() is called from the event loop until it returns true; each
+// call only checks whether a read has finished and, if so, parses the
+// lines read and starts the next read. The file is read in blocks of
+// the buffer size, so a lookup needs only a few reads. The result is
+// the same as IniFile::getValue(): the value is left in the buffer.
+// An index attached to the IniFile is not used.
+class IniAsyncLookup {
+public:
+	typedef void (*callback_t)(IniAsyncLookup &lookup, void* context);
+
+	IniAsyncLookup(const IniFile &ini, IniAsyncIO &io);
+
+	// Start looking up key in section (which may be NULL, as for
+	// getValue()). buffer must stay valid until the lookup is done and
+	// hold the longest line. callback, if not NULL, is called once
+	// when the lookup is done. Returns false if the lookup finished
+	// at once with an error, in which case callback has been called.
+	bool begin(const char* section, const char* key, char* buffer,
+			   size_t len, callback_t callback = NULL,
+			   void* context = NULL);
+
+	// Make progress. Returns true when the lookup is done.
+	bool poll(void);
+
+	inline bool isDone(void) const;
+	inline IniFile::error_t getError(void) const;
+	// The value, once done without error
+	inline const char* getValue(void) const;
+	// Line number and position of the key line, or of the last line
+	// read if it was not found
+	inline uint32_t getLineNumber(void) const;
+	inline uint32_t getPosition(void) const;
+
+#if defined(INIFILE_HOST) && defined(__cpp_impl_coroutine)
+	// co_await the lookup from a C++20 coroutine, which is resumed by
+	// the poll() call which finishes the lookup and is given the
+	// error. This replaces any callback.
+	struct Awaiter {
+		IniAsyncLookup &lookup;
+		bool await_ready(void) const {
+			return lookup.isDone();
+		}
+		void await_suspend(std::coroutine_handle<> handle) {
+			lookup._callback = &resume;
+			lookup._context = handle.address();
+		}
+		IniFile::error_t await_resume(void) const {
+			return lookup.getError();
+		}
+		static void resume(IniAsyncLookup &, void* address) {
+			std::coroutine_handle<>::from_address(address).resume();
+		}
+	};
+	Awaiter operator co_await(void) {
+		return Awaiter{*this};
+	}
+#endif
+
+private:
+	enum {
+		stateDone = 0,
+		stateFindSection,
+		stateFindKey,
+		stateReadValue, // Collecting the continuation lines of the value
+	};
+
+	bool processLine(char* line, bool last);
+	bool continueValue(bool last);
+	bool finish(IniFile::error_t err);
+	bool tooLong(size_t start);
+	bool readMore(void);
+
+	const IniFile &_ini;
+	IniAsyncIO &_io;
+	const char* _section;
+	const char* _key;
+	size_t _sectionLength;
+	size_t _keyLength;
+	char* _buffer;
+	size_t _len;
+	size_t _used;        // Bytes in the buffer
+	size_t _keep;        // Bytes of value before the lines in the buffer
+	size_t _valueStart;  // Where the value starts within them
+	uint8_t _valueState; // As IniFileState::valueState
+	uint32_t _bufferPos; // Position in the file of the buffer's start
+	uint32_t _lineNumber;
+	uint32_t _linePosition;
+	char _skipNewline;   // Second character of a two character newline
+	uint8_t _state;
+	IniFile::error_t _error;
+	callback_t _callback;
+	void* _context;
+};
+
+bool IniAsyncLookup::isDone(void) const
+{
+	return _state == stateDone;
+}
+
+IniFile::error_t IniAsyncLookup::getError(void) const
+{
+	return _error;
+}
+
+const char* IniAsyncLookup::getValue(void) const
+{
+	return _buffer;
+}
+
+uint32_t IniAsyncLookup::getLineNumber(void) const
+{
+	return _lineNumber;
+}
+
+uint32_t IniAsyncLookup::getPosition(void) const
+{
+	return _linePosition;
+}
+
+#endif
@@ -0,0 +1,147 @@
+#include "IniBlockCache.h"
+
+#include <string.h>
+
+IniBlockCache::IniBlockCache(char* buffer, size_t len, IniCacheBlock* blocks,
+							 uint8_t numBlocks)
+{
+	_buffer = buffer;
+	_blocks = blocks;
+	_numBlocks = numBlocks;
+	size_t blockSize = (numBlocks ? len / numBlocks : 0);
+	_blockSize = (blockSize > 0xFFFF ? 0xFFFF : blockSize);
+	_readAhead = 0;
+	for (uint8_t i = 0; i < _numBlocks; ++i)
+		_blocks[i].slot = i;
+	clear();
+}
+
+void IniBlockCache::setReadAhead(uint8_t blocks)
+{
+	if (_numBlocks && blocks >= _numBlocks)
+		blocks = _numBlocks - 1;
+	_readAhead = blocks;
+}
+
+void IniBlockCache::clear(void)
+{
+	for (uint8_t i = 0; i < _numBlocks; ++i) {
+		_blocks[i].position = noBlock;
+		_blocks[i].length = 0;
+	}
+	_fileSize = noBlock;
+	_hits = 0;
+	_misses = 0;
+}
+
+IniFile::error_t IniBlockCache::read(File &file, uint32_t pos, char* buffer,
+									 size_t len, size_t &bytesRead)
+{
+	bytesRead = 0;
+	if (!file)
+		return IniFile::errorFileNotOpen;
+	if (_blockSize == 0)
+		return IniFile::errorBufferTooSmall;
+	if (_fileSize == noBlock)
+		_fileSize = file.size();
+
+	bool readAhead = true;
+	while (bytesRead < len) {
+		uint32_t offset = pos % _blockSize;
+		IniCacheBlock* block;
+		IniFile::error_t err = getBlock(file, pos - offset, readAhead, block);
+		if (err != IniFile::errorNoError)
+			return err;
+		// Only read ahead once for each call
+		readAhead = false;
+		if (offset >= block->length)
+			break; // End of the file
+		size_t n = block->length - offset;
+		if (n > len - bytesRead)
+			n = len - bytesRead;
+		memcpy(buffer + bytesRead, _buffer + size_t(block->slot) * _blockSize
+			   + offset, n);
+		bytesRead += n;
+		pos += n;
+		if (block->length < _blockSize)
+			break; // A short block is the last one
+	}
+	return (bytesRead ? IniFile::errorNoError : IniFile::errorEndOfFile);
+}
+
+IniFile::error_t IniBlockCache::getBlock(File &file, uint32_t blockPos,
+										 bool readAhead,
+										 IniCacheBlock* &block)
+{
+	for (uint8_t i = 0; i < _numBlocks; ++i)
+		if (_blocks[i].position == blockPos) {
+			++_hits;
+			makeMostRecent(i);
+			block = &_blocks[0];
+			return IniFile::errorNoError;
+		}
+
+	IniFile::error_t err;
+	block = load(file, blockPos, err);
+	if (block == nullptr)
+		return err;
+	if (!readAhead || block->length < _blockSize)
+		return IniFile::errorNoError;
+
+	// Read the next blocks while the file is positioned there, then
+	// make the wanted block the most recent again
+	for (uint8_t i = 1; i <= _readAhead; ++i) {
+		uint32_t nextPos = blockPos + uint32_t(i) * _blockSize;
+		if (nextPos >= _fileSize)
+			break;
+		bool cached = false;
+		for (uint8_t j = 0; j < _numBlocks && !cached; ++j)
+			cached = (_blocks[j].position == nextPos);
+		if (cached)
+			break;
+		if (load(file, nextPos, err) == nullptr)
+			return err;
+	}
+	for (uint8_t i = 0; i < _numBlocks; ++i)
+		if (_blocks[i].position == blockPos) {
+			makeMostRecent(i);
+			break;
+		}
+	block = &_blocks[0];
+	return IniFile::errorNoError;
+}
+
+// Read a block into the least recently used slot, which becomes the
+// most recently used
+IniCacheBlock* IniBlockCache::load(File &file, uint32_t blockPos,
+								   IniFile::error_t &err)
+{
+	++_misses;
+	makeMostRecent(_numBlocks - 1);
+	IniCacheBlock &block = _blocks[0];
+	block.position = noBlock;
+	if (!file.seek(blockPos)) {
+		err = IniFile::errorSeekError;
+		return nullptr;
+	}
+	char* data = _buffer + size_t(block.slot) * _blockSize;
+#if defined(ARDUINO_ARCH_ESP32) && !defined(PREFER_SDFAT_LIBRARY)
+	int n = file.readBytes(data, _blockSize);
+#else
+	int n = file.read(data, _blockSize);
+#endif
+	if (n < 0) {
+		err = IniFile::errorUnknownError;
+		return nullptr;
+	}
+	block.position = blockPos;
+	block.length = n;
+	return &block;
+}
+
+void IniBlockCache::makeMostRecent(uint8_t n)
+{
+	IniCacheBlock block = _blocks[n];
+	memmove(&_blocks[1], &_blocks[0], n * sizeof(IniCacheBlock));
+	_blocks[0] = block;
+}
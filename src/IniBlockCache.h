@@ -0,0 +1,86 @@
+#ifndef _INIBLOCKCACHE_H
+#define _INIBLOCKCACHE_H
+
+#include "IniFile.h"
+
+// One block held by an IniBlockCache. Stored by IniBlockCache in a
+// caller-supplied array.
+struct IniCacheBlock {
+	uint32_t position; // Start of the block in the file
+	uint16_t length;   // Less than the block size at the end of the file
+	uint8_t slot;      // Where the data is in the cache's buffer
+};
+
+// Cache of the most recently used blocks of a file, used by IniFile
+// so that each line is not a separate seek and read. Every read from
+// the card is a whole block on a block boundary, so with 512 byte
+// blocks (or a multiple) the card transfers whole sectors straight
+// into the buffer. The buffer, supplied by the user, is split into
+// numBlocks blocks of equal size. When a block has to be read the
+// following blocks can be read straight after it, while the card is
+// still positioned there, since lookups read forward.
+class IniBlockCache {
+public:
+	static const uint32_t noBlock = 0xFFFFFFFF;
+
+	IniBlockCache(char* buffer, size_t len, IniCacheBlock* blocks,
+				  uint8_t numBlocks);
+
+	// Number of extra blocks to read after a block which is not in the
+	// cache, at most one less than the number of blocks
+	void setReadAhead(uint8_t blocks);
+
+	// Forget all blocks. Must be called if the file changes;
+	// IniFile::open() does this for its cache.
+	void clear(void);
+
+	// As File::seek() followed by File::read(), for up to len bytes
+	IniFile::error_t read(File &file, uint32_t pos, char* buffer, size_t len,
+						  size_t &bytesRead);
+
+	// Size of the file, found by the first read after clear()
+	inline uint32_t getFileSize(void) const;
+	inline uint16_t getBlockSize(void) const;
+
+	// Number of blocks found in the cache and read from the file
+	inline uint32_t getHits(void) const;
+	inline uint32_t getMisses(void) const;
+
+private:
+	IniFile::error_t getBlock(File &file, uint32_t blockPos, bool readAhead,
+							  IniCacheBlock* &block);
+	IniCacheBlock* load(File &file, uint32_t blockPos,
+						IniFile::error_t &err);
+	void makeMostRecent(uint8_t n);
+
+	char* _buffer;
+	uint16_t _blockSize;
+	IniCacheBlock* _blocks; // Most recently used first
+	uint8_t _numBlocks;
+	uint8_t _readAhead;
+	uint32_t _fileSize;
+	uint32_t _hits;
+	uint32_t _misses;
+};
+
+uint32_t IniBlockCache::getFileSize(void) const
+{
+	return _fileSize;
+}
+
+uint16_t IniBlockCache::getBlockSize(void) const
+{
+	return _blockSize;
+}
+
+uint32_t IniBlockCache::getHits(void) const
+{
+	return _hits;
+}
+
+uint32_t IniBlockCache::getMisses(void) const
+{
+	return _misses;
+}
+
+#endif
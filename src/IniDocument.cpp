@@ -0,0 +1,264 @@
+#include "IniDocument.h"
+
+#if defined(INIFILE_HOST)
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <thread>
+
+IniDocument::handle_t IniDocument::load(const char* filename,
+										bool caseSensitive,
+										IniFile::error_t &err)
+{
+	FILE* f = fopen(filename, "rb");
+	if (f == NULL) {
+		err = IniFile::errorFileNotFound;
+		return handle_t();
+	}
+	std::vector<char> data;
+	char block[4096];
+	size_t n;
+	while ((n = fread(block, 1, sizeof(block), f)) > 0)
+		data.insert(data.end(), block, block + n);
+	bool failed = ferror(f);
+	fclose(f);
+	if (failed) {
+		err = IniFile::errorUnknownError;
+		return handle_t();
+	}
+
+	// There cannot be more entries than lines
+	size_t lines = 1;
+	for (size_t i = 0; i < data.size(); ++i)
+		if (data[i] == '\n' || data[i] == '\r')
+			++lines;
+	if (lines >= IniIndex::noSection)
+		lines = IniIndex::noSection - 1;
+
+	err = IniFile::errorNoError;
+	return handle_t(new IniDocument(filename, data, lines, caseSensitive));
+}
+
+IniDocument::IniDocument(const char* filename, std::vector<char> &data,
+						 size_t maxEntries, bool caseSensitive)
+	: _filename(filename), _caseSensitive(caseSensitive),
+	  _entries(maxEntries), _index(_entries.data(), maxEntries)
+{
+	_data.swap(data);
+	IniFile ini = view();
+	char buffer[512];
+	_indexed = (_index.buildParallel(ini, buffer, sizeof(buffer)) ==
+				IniFile::errorNoError);
+}
+
+IniFile::error_t IniDocument::getValue(const char* section, const char* key,
+									   char* buffer, size_t len) const
+{
+	IniFile ini = view();
+	if (_indexed)
+		return _index.getValue(ini, section, key, buffer, len);
+	ini.getValue(section, key, buffer, len);
+	return ini.getError();
+}
+
+IniFile::error_t IniDocument::getValue(const char* section, const char* key,
+									   char* buffer, size_t len,
+									   bool& b) const
+{
+	IniFile::error_t err = getValue(section, key, buffer, len);
+	if (err == IniFile::errorNoError && !IniFile::parseBool(buffer, b))
+		err = IniFile::errorUnknownError;
+	return err;
+}
+
+IniFile::error_t IniDocument::getValue(const char* section, const char* key,
+									   char* buffer, size_t len,
+									   long& val) const
+{
+	IniFile::error_t err = getValue(section, key, buffer, len);
+	if (err == IniFile::errorNoError)
+		val = atol(buffer);
+	return err;
+}
+
+IniFile::error_t IniDocument::getValue(const char* section, const char* key,
+									   char* buffer, size_t len,
+									   unsigned long& val) const
+{
+	IniFile::error_t err = getValue(section, key, buffer, len);
+	if (err == IniFile::errorNoError &&
+		!IniFile::parseUnsignedLong(buffer, val))
+		err = IniFile::errorUnknownError;
+	return err;
+}
+
+IniFile::error_t IniDocument::getValue(const char* section, const char* key,
+									   char* buffer, size_t len,
+									   double& val) const
+{
+	IniFile::error_t err = getValue(section, key, buffer, len);
+	if (err == IniFile::errorNoError)
+		val = atof(buffer);
+	return err;
+}
+
+IniDocumentCache& IniDocumentCache::shared(void)
+{
+	static IniDocumentCache cache;
+	return cache;
+}
+
+// Modification time in nanoseconds, or seconds where that is all the
+// system gives
+static long long modificationTime(const struct stat &st)
+{
+#if defined(__APPLE__)
+	return st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+	return st.st_mtime * 1000000000LL;
+#else
+	return st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+}
+
+IniDocument::handle_t IniDocumentCache::get(const char* filename,
+											IniFile::error_t &err,
+											bool caseSensitive)
+{
+	struct stat st;
+	if (stat(filename, &st) != 0) {
+		err = IniFile::errorFileNotFound;
+		return IniDocument::handle_t();
+	}
+	long long mtime = modificationTime(st);
+
+	// A file wanted by several threads at once is only read once: the
+	// others wait for the first to load it
+	key_t key(filename, caseSensitive);
+	std::unique_lock<std::mutex> lock(_mutex);
+	std::map<key_t, Entry>::iterator it;
+	while ((it = _entries.find(key)) != _entries.end() &&
+		   it->second.loading)
+		_loaded.wait(lock);
+	if (it != _entries.end() && it->second.mtime == mtime &&
+		it->second.size == st.st_size && it->second.inode == st.st_ino) {
+		err = IniFile::errorNoError;
+		return it->second.document;
+	}
+	Entry &e = _entries[key];
+	e.mtime = mtime;
+	e.size = st.st_size;
+	e.inode = st.st_ino;
+	uint32_t load = ++_loads;
+	e.loading = load;
+
+	// Load without the lock, so other files are not held up
+	lock.unlock();
+	IniDocument::handle_t document =
+		IniDocument::load(filename, caseSensitive, err);
+	lock.lock();
+
+	// The entry may have been removed meanwhile, and even replaced
+	it = _entries.find(key);
+	if (it != _entries.end() && it->second.loading == load) {
+		if (document) {
+			it->second.document = document;
+			it->second.loading = 0;
+		}
+		else
+			_entries.erase(it);
+	}
+	_loaded.notify_all();
+	return document;
+}
+
+void IniDocumentCache::remove(const char* filename)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_entries.erase(key_t(filename, false));
+	_entries.erase(key_t(filename, true));
+}
+
+void IniDocumentCache::clear(void)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_entries.clear();
+}
+
+size_t IniDocumentCache::size(void) const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _entries.size();
+}
+
+IniLiveDocument::IniLiveDocument(const char* filename, bool caseSensitive)
+	: _filename(filename), _caseSensitive(caseSensitive), _current(nullptr),
+	  _epoch(0), _reloads(0)
+{
+	_readers[0] = 0;
+	_readers[1] = 0;
+}
+
+IniLiveDocument::~IniLiveDocument()
+{
+	// Snapshots must not outlive the document
+	_current = nullptr;
+}
+
+IniFile::error_t IniLiveDocument::reload(void)
+{
+	// Loading is the slow part and happens before anything is locked
+	IniFile::error_t err;
+	IniDocument::handle_t document =
+		IniDocument::load(_filename.c_str(), _caseSensitive, err);
+	if (document)
+		publish(document);
+	return err;
+}
+
+void IniLiveDocument::publish(IniDocument::handle_t document)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_current = document.get();
+	// Readers which arrive from now on count in the new epoch and see
+	// the new document. Those in the old epoch may still be using the
+	// old one, so wait for them before letting it go. The epoch before
+	// that was emptied by the previous publish().
+	unsigned old = _epoch.fetch_add(1);
+	while (_readers[old & 1] != 0)
+		std::this_thread::yield();
+	_published.swap(document);
+	++_reloads;
+}
+
+IniLiveDocument::Snapshot::Snapshot(const IniLiveDocument &live)
+	: _live(live)
+{
+	// Count this reader in the current epoch. If the epoch moved on
+	// meanwhile publish() may not have seen the count, so try again.
+	while (true) {
+		unsigned epoch = live._epoch;
+		_slot = epoch & 1;
+		++live._readers[_slot];
+		if (live._epoch == epoch)
+			break;
+		--live._readers[_slot];
+	}
+	_document = live._current;
+}
+
+IniLiveDocument::Snapshot::~Snapshot()
+{
+	--_live._readers[_slot];
+}
+
+IniFile::error_t IniLiveDocument::getValue(const char* section,
+										   const char* key, char* buffer,
+										   size_t len) const
+{
+	Snapshot snapshot(*this);
+	if (!snapshot)
+		return IniFile::errorFileNotOpen;
+	return snapshot->getValue(section, key, buffer, len);
+}
+#endif
@@ -0,0 +1,233 @@
+#ifndef _INIDOCUMENT_H
+#define _INIDOCUMENT_H
+
+#include "IniFile.h"
+
+#if defined(INIFILE_HOST)
+#include "IniIndex.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// An ini file read into memory and indexed, which never changes once
+// loaded. Lookups do not modify anything so any number of threads can
+// use the same document at once without locking. Values and errors are
+// as IniFile::getValue(). Documents are shared through IniDocumentCache.
+class IniDocument {
+public:
+	typedef std::shared_ptr<const IniDocument> handle_t;
+
+	// Read and index a file. Returns an empty handle on error.
+	static handle_t load(const char* filename, bool caseSensitive,
+						 IniFile::error_t &err);
+
+	IniFile::error_t getValue(const char* section, const char* key,
+							  char* buffer, size_t len) const;
+	// As above, returning errorUnknownError if the value is not valid
+	IniFile::error_t getValue(const char* section, const char* key,
+							  char* buffer, size_t len, bool& b) const;
+	IniFile::error_t getValue(const char* section, const char* key,
+							  char* buffer, size_t len, long& val) const;
+	IniFile::error_t getValue(const char* section, const char* key,
+							  char* buffer, size_t len,
+							  unsigned long& val) const;
+	IniFile::error_t getValue(const char* section, const char* key,
+							  char* buffer, size_t len, double& val) const;
+
+	inline const std::string& getFilename(void) const;
+	inline bool getCaseSensitive(void) const;
+	inline uint32_t getSize(void) const;
+	// False if the file has too many lines to index, when lookups
+	// search the file instead
+	inline bool isIndexed(void) const;
+
+private:
+	IniDocument(const char* filename, std::vector<char> &data,
+				size_t maxEntries, bool caseSensitive);
+	IniDocument(const IniDocument &) = delete;
+	IniDocument& operator=(const IniDocument &) = delete;
+
+	// Each lookup uses its own IniFile, since IniFile records errors
+	inline IniFile view(void) const;
+
+	std::string _filename;
+	std::vector<char> _data;
+	bool _caseSensitive;
+	std::vector<IniIndexEntry> _entries;
+	IniIndex _index;
+	bool _indexed;
+};
+
+// Documents shared by every part of a program which reads the same
+// file, so that it is read and indexed only once. A file is read again
+// when its modification time (to the nanosecond where the system
+// records it), size or inode changes; handles to the old document stay
+// valid until released. A rewrite of the same size within the
+// resolution of the file system's timestamps is not seen, so replace
+// files by renaming a new one into place. Files are loaded without
+// holding the lock, so a slow load only delays other requests for the
+// same file, which wait for it rather than load it again.
+class IniDocumentCache {
+public:
+	// The cache shared by the whole process
+	static IniDocumentCache& shared(void);
+
+	// The document for filename, loaded if it is not in the cache or
+	// the file has changed. Returns an empty handle on error.
+	IniDocument::handle_t get(const char* filename, IniFile::error_t &err,
+							  bool caseSensitive = false);
+
+	// Forget documents, although they live on while handles remain
+	void remove(const char* filename);
+	void clear(void);
+	size_t size(void) const;
+
+	// Number of times a file has been read into the cache
+	inline uint32_t getLoads(void) const;
+
+private:
+	struct Entry {
+		long long mtime; // Nanoseconds
+		long long size;
+		unsigned long long inode;
+		IniDocument::handle_t document;
+		uint32_t loading; // Number of the load in progress, or zero
+	};
+	typedef std::pair<std::string, bool> key_t; // Filename, case sensitive
+
+	mutable std::mutex _mutex;
+	std::condition_variable _loaded; // A load has finished
+	std::map<key_t, Entry> _entries;
+	uint32_t _loads = 0;
+};
+
+// The current version of a file which a running program reloads. A
+// reload reads and indexes the new file into a separate document and
+// then publishes it with a single pointer swap. Readers take a
+// Snapshot, which only counts them in the current epoch and so never
+// waits; the old document is released once every reader of the epoch
+// before the swap has finished. A snapshot always sees one whole
+// document, old or new.
+class IniLiveDocument {
+public:
+	explicit IniLiveDocument(const char* filename, bool caseSensitive = false);
+	~IniLiveDocument();
+
+	// Read the file again and publish it. On error the current
+	// document stays. Waits for readers of the old document to finish,
+	// so call it from a thread which does not hold a Snapshot.
+	IniFile::error_t reload(void);
+	// Publish a document loaded elsewhere, such as by IniDocumentCache
+	void publish(IniDocument::handle_t document);
+
+	// The document as it was when the snapshot was taken. Empty until
+	// a document has been published. Keep snapshots short, a reload
+	// waits for them.
+	class Snapshot {
+	public:
+		explicit Snapshot(const IniLiveDocument &live);
+		~Snapshot();
+		inline const IniDocument* get(void) const;
+		inline const IniDocument* operator->(void) const;
+		inline explicit operator bool(void) const;
+
+	private:
+		Snapshot(const Snapshot &) = delete;
+		Snapshot& operator=(const Snapshot &) = delete;
+
+		const IniLiveDocument &_live;
+		unsigned _slot;
+		const IniDocument* _document;
+	};
+
+	// As IniDocument::getValue() on a snapshot, errorFileNotOpen if
+	// no document has been published
+	IniFile::error_t getValue(const char* section, const char* key,
+							  char* buffer, size_t len) const;
+
+	inline const std::string& getFilename(void) const;
+	// Number of documents published
+	inline uint32_t getReloads(void) const;
+
+private:
+	IniLiveDocument(const IniLiveDocument &) = delete;
+	IniLiveDocument& operator=(const IniLiveDocument &) = delete;
+
+	std::string _filename;
+	bool _caseSensitive;
+	std::mutex _mutex; // Serialises writers only
+	IniDocument::handle_t _published; // Keeps _current alive
+	std::atomic<const IniDocument*> _current;
+	std::atomic<unsigned> _epoch;
+	// Readers in each of the current and previous epochs
+	mutable std::atomic<uint32_t> _readers[2];
+	std::atomic<uint32_t> _reloads;
+};
+
+const std::string& IniDocument::getFilename(void) const
+{
+	return _filename;
+}
+
+bool IniDocument::getCaseSensitive(void) const
+{
+	return _caseSensitive;
+}
+
+uint32_t IniDocument::getSize(void) const
+{
+	return _data.size();
+}
+
+bool IniDocument::isIndexed(void) const
+{
+	return _indexed;
+}
+
+IniFile IniDocument::view(void) const
+{
+	// An empty file must still have data to be open
+	return IniFile(_data.empty() ? "" : _data.data(), _data.size(),
+				   IniFile::memoryRAM, _caseSensitive);
+}
+
+uint32_t IniDocumentCache::getLoads(void) const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _loads;
+}
+
+const IniDocument* IniLiveDocument::Snapshot::get(void) const
+{
+	return _document;
+}
+
+const IniDocument* IniLiveDocument::Snapshot::operator->(void) const
+{
+	return _document;
+}
+
+IniLiveDocument::Snapshot::operator bool(void) const
+{
+	return _document != nullptr;
+}
+
+const std::string& IniLiveDocument::getFilename(void) const
+{
+	return _filename;
+}
+
+uint32_t IniLiveDocument::getReloads(void) const
+{
+	return _reloads;
+}
+
+#endif
+
+#endif
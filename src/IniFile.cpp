@@ -1,9 +1,43 @@
 #include "IniFile.h"
+#include "IniBlockCache.h"
+#include "IniInflate.h"
+#include "IniInterpolation.h"
+#include "IniKey.h"
+#include "IniNetwork.h"
+#include "IniSchema.h"
+#include "IniSparseIndex.h"
+#include "IniTokenizer.h"
+#include "IniTrace.h"
+#include "IniValidation.h"
+#include "IniIndex.h"
 
 #include <string.h>
 
 const uint8_t IniFile::maxFilenameLen = INI_FILE_MAX_FILENAME_LEN;
 
+// Reports an operation to the trace of an IniFile, if it has one which
+// wants the operation, from construction until the end of the scope
+class IniTraceScope {
+public:
+	IniTraceScope(const IniFile &ini, uint8_t op, const char* name)
+		: _ini(ini), _op(op) {
+		_trace = ini.getTrace();
+		if (_trace && !_trace->isTraced(op))
+			_trace = nullptr;
+		if (_trace)
+			_trace->begin(ini, op, name);
+	}
+	~IniTraceScope() {
+		if (_trace)
+			_trace->end(_ini, _op, _ini.getError());
+	}
+
+private:
+	const IniFile &_ini;
+	IniTrace* _trace;
+	uint8_t _op;
+};
+
 IniFile::IniFile(const char* filename, mode_t mode,
 				 bool caseSensitive)
 {
@@ -13,6 +47,41 @@ IniFile::IniFile(const char* filename, mode_t mode,
 		_filename[0] = '\0';
 	_mode = mode;
 	_caseSensitive = caseSensitive;
+	_sortedSections = false;
+	_syntax = 0;
+	_data = nullptr;
+	_dataLen = 0;
+	_memType = memoryRAM;
+	_memoryOpen = false;
+	_inflate = nullptr;
+	_index = nullptr;
+	_sparseIndex = nullptr;
+	_cache = nullptr;
+	_interpolation = nullptr;
+	_trace = nullptr;
+	_generation = 0;
+}
+
+IniFile::IniFile(const char* data, size_t dataLen, memory_t memType,
+				 bool caseSensitive)
+{
+	_filename[0] = '\0';
+	_mode = FILE_READ;
+	_caseSensitive = caseSensitive;
+	_sortedSections = false;
+	_syntax = 0;
+	_data = data;
+	_dataLen = dataLen;
+	_memType = memType;
+	_memoryOpen = (data != nullptr);
+	_inflate = nullptr;
+	_index = nullptr;
+	_sparseIndex = nullptr;
+	_cache = nullptr;
+	_interpolation = nullptr;
+	_trace = nullptr;
+	_generation = 0;
+	_error = (data == nullptr ? errorFileNotOpen : errorNoError);
 }
 
 IniFile::~IniFile()
@@ -21,38 +90,287 @@ IniFile::~IniFile()
 	//  _file.close();
 }
 
+bool IniFile::open(void)
+{
+	IniTraceScope scope(*this, IniTrace::opOpen, NULL);
+	if (isMemory()) {
+		_memoryOpen = true;
+		_error = errorNoError;
+		return true;
+	}
+	if (_file)
+		_file.close();
+	_file = SD.open(_filename, _mode);
+	if (isOpen()) {
+		resetSource();
+		_error = errorNoError;
+		return true;
+	}
+	else {
+		_error = errorFileNotFound;
+		return false;
+	}
+}
+
 
 bool IniFile::validate(char* buffer, size_t len) const
 {
+	IniValidation validation;
+	return validate(buffer, len, validation);
+}
+
+bool IniFile::validate(char* buffer, size_t len,
+					   IniValidation &validation) const
+{
+	IniTraceScope scope(*this, IniTrace::opValidate, NULL);
+	validation.begin(len);
+	if (len < 3) {
+		_error = errorBufferTooSmall;
+		return false;
+	}
+
+	IniTokenizer tokenizer;
+	tokenizer.setSyntax(_syntax);
 	uint32_t pos = 0;
+	size_t bytesRead;
 	error_t err;
-	while ((err = readLine(_file, buffer, len, pos)) == errorNoError)
-		;
+	while ((err = read(pos, buffer, len, bytesRead)) == errorNoError) {
+		const char* cp = buffer;
+		size_t left = bytesRead;
+		while (left) {
+			size_t used = tokenizer.scan(cp, left);
+			cp += used;
+			left -= used;
+			if (tokenizer.lineReady() &&
+				validation.addLine(tokenizer.getLine(), false)) {
+				// Comparing the names needs the buffer, so read the
+				// rest of it again
+				err = checkDuplicateKey(validation, tokenizer.getLine(),
+										buffer, len);
+				break;
+			}
+		}
+		if (err != errorNoError)
+			break;
+		pos += bytesRead - left;
+	}
 	if (err == errorEndOfFile) {
-		_error = errorNoError;
-		return true;
+		err = errorNoError;
+		tokenizer.finish();
+		if (tokenizer.lineReady() &&
+			validation.addLine(tokenizer.getLine(), true))
+			err = checkDuplicateKey(validation, tokenizer.getLine(),
+									buffer, len);
 	}
-	else {
+	if (err != errorNoError) {
 		_error = err;
 		return false;
 	}
+
+	if (validation._numTooLong) {
+		_error = errorBufferTooSmall;
+		return false;
+	}
+	_error = errorNoError;
+	return true;
+}
+
+IniFile::error_t IniFile::checkDuplicateKey(IniValidation &validation,
+											const IniLine &key, char* buffer,
+											size_t len) const
+{
+	// Read the section again up to key, comparing the names of keys
+	// with the same hash
+	uint32_t pos = validation._sectionPosition;
+	IniTokenizer tokenizer(pos);
+	tokenizer.setSyntax(_syntax);
+	while (pos < key.position) {
+		size_t bytesRead;
+		error_t err = read(pos, buffer, len, bytesRead);
+		if (err != errorNoError)
+			return err;
+		const char* cp = buffer;
+		size_t left = bytesRead;
+		while (left) {
+			size_t used = tokenizer.scan(cp, left);
+			cp += used;
+			left -= used;
+			if (!tokenizer.lineReady())
+				continue;
+			const IniLine &line = tokenizer.getLine();
+			if (line.position >= key.position)
+				return errorNoError;
+			if (line.type == IniLine::typeKey &&
+				line.nameHash == key.nameHash &&
+				line.nameLength == key.nameLength) {
+				bool same;
+				err = compareNamesAt(line.nameStart, key.nameStart,
+									 key.nameLength, buffer, len, same);
+				if (err != errorNoError)
+					return err;
+				if (same) {
+					validation.addProblem(IniFileProblem::problemDuplicateKey,
+										  key);
+					return errorNoError;
+				}
+				// The buffer was used, read on from this line
+				break;
+			}
+		}
+		pos += bytesRead - left;
+	}
+	return errorNoError;
+}
+
+IniFile::error_t IniFile::compareNamesAt(uint32_t a, uint32_t b, uint32_t n,
+										 char* buffer, size_t len,
+										 bool &same) const
+{
+	// Half of the buffer for each name
+	size_t half = len / 2;
+	same = true;
+	while (n && same) {
+		size_t chunk = (n < half ? n : half);
+		for (size_t done = 0; done < chunk * 2; ) {
+			size_t bytesRead;
+			bool second = (done >= chunk);
+			size_t offset = (second ? done - chunk : done);
+			error_t err = read((second ? b : a) + offset,
+							   buffer + (second ? half : 0) + offset,
+							   chunk - offset, bytesRead);
+			if (err != errorNoError)
+				return err;
+			done += bytesRead;
+		}
+		if (_caseSensitive)
+			same = (memcmp(buffer, buffer + half, chunk) == 0);
+		else
+			same = equalFolded(buffer, buffer + half, chunk);
+		a += chunk;
+		b += chunk;
+		n -= chunk;
+	}
+	return errorNoError;
+}
+
+bool IniFile::validate(char* buffer, size_t len, IniSchema &schema) const
+{
+	IniTraceScope scope(*this, IniTrace::opValidate, NULL);
+	schema.begin();
+	if (!isOpen()) {
+		_error = errorFileNotOpen;
+		return false;
+	}
+
+	IniFileState state;
+	while (true) {
+		error_t err = readNextLine(buffer, len, state);
+		if (err == errorEndOfFile && buffer[0] == '\0')
+			break;
+		if (err != errorNoError && err != errorEndOfFile) {
+			_error = err;
+			return false;
+		}
+
+		char* cp = skipWhiteSpace(buffer);
+		char* key;
+		char* value;
+		if (*cp == '[')
+			schema.startSection(*this, parseSection(cp));
+		else if (!isCommentChar(*cp) &&
+				 (key = parseKey(cp, &value)) != NULL && *key != '\0') {
+			// An empty key is never found, as by getValue()
+			uint32_t hash = IniTokenizer::hash(key);
+			uint16_t n = schema.findKey(*this, key, hash, 0);
+			if (n < schema.getNumKeys()) {
+				// Take the value as getValue() would, once for all of
+				// the keys which want it
+				if (_syntax) {
+					if (readValue(buffer, len, value,
+								  state.readLinePosition) != errorNoError)
+						value = NULL;
+				}
+				else {
+					value = skipWhiteSpace(value);
+					removeTrailingWhiteSpace(value);
+				}
+				for (; n < schema.getNumKeys();
+					 n = schema.findKey(*this, key, hash, n + 1))
+					schema.setValue(*this, n, value, state.getLineNumber(),
+									state.getPosition());
+			}
+		}
+		if (err == errorEndOfFile)
+			break;
+	}
+	schema.finish(*this);
+	_error = (schema.isValid() ? errorNoError : errorSchemaError);
+	return _error == errorNoError;
 }
 
 bool IniFile::getValue(const char* section, const char* key,
 					   char* buffer, size_t len, IniFileState &state) const
+{
+	if (_trace == nullptr)
+		return getValueStep(section, key, buffer, len, state);
+	uint8_t before = state.getValueState;
+	bool done = getValueStep(section, key, buffer, len, state);
+	traceStep(before, state, done, section, key);
+	return done;
+}
+
+bool IniFile::getValueStep(const char* section, const char* key,
+						   char* buffer, size_t len,
+						   IniFileState &state) const
 {
 	char *cp = nullptr;
 	bool done = false;
-	if (!_file) {
+	if (!isOpen()) {
 		_error = errorFileNotOpen;
 		return true;
 	}
 
 	switch (state.getValueState) {
 	case IniFileState::funcUnset:
+		state.readLinePosition = 0;
+		state.linePosition = 0;
+		state.lineNumber = 0;
+		state.valueState = 0;
+		state.checkpoint = IniSparseIndex::noCheckpoint;
+		state.countLines = true;
+		if (_index && _index->isValid()) {
+			// The index finds the line directly, no need for more steps
+			entry_t entry;
+			traceBegin(IniTrace::opIndexLookup, key);
+			_error = _index->getValue(*this, section, key, buffer, len,
+									  &entry);
+			traceEnd(IniTrace::opIndexLookup, _error);
+			if (_error == errorNoError) {
+				state.linePosition = _index->getEntry(entry).position;
+				state.lineNumber = _index->getEntry(entry).line;
+				copyResolved(entry, buffer, len);
+			}
+			return true;
+		}
+		state.sectionLength = (section == NULL ? 0 : strlen(section));
+		state.keyLength = (key == NULL ? 0 : strlen(key));
 		state.getValueState = (section == NULL ? IniFileState::funcFindKey
 							   : IniFileState::funcFindSection);
-		state.readLinePosition = 0;
+		if (section && _sortedSections && _inflate == nullptr &&
+			!(_syntax & syntaxContinuation)) {
+			// The search goes on from the section line, which
+			// findSection() reads again
+			traceBegin(IniTrace::opSortedSearch, section);
+			_error = findSortedSection(section, buffer, len,
+									   state.readLinePosition);
+			traceEnd(IniTrace::opSortedSearch, _error);
+			if (_error != errorNoError)
+				return true;
+			state.countLines = false;
+		}
+		else if (section && _sparseIndex && _sparseIndex->isValid() &&
+				 !skipToCheckpoint(section, 0, state))
+			return true;
 		break;
 
 	case IniFileState::funcFindSection:
@@ -61,6 +379,11 @@ bool IniFile::getValue(const char* section, const char* key,
 				return true;
 			state.getValueState = IniFileState::funcFindKey;
 		}
+		else if (state.checkpoint != IniSparseIndex::noCheckpoint &&
+				 state.readLinePosition >=
+				 _sparseIndex->getEnd(state.checkpoint) &&
+				 !skipToCheckpoint(section, state.checkpoint + 1, state))
+			return true;
 		break;
 
 	case IniFileState::funcFindKey:
@@ -68,6 +391,11 @@ bool IniFile::getValue(const char* section, const char* key,
 			if (_error != errorNoError)
 				return true;
 			// Found key line in correct section
+			if (_syntax) {
+				_error = readValue(buffer, len, cp, state.readLinePosition);
+				memmove(buffer, cp, strlen(cp) + 1);
+				return true;
+			}
 			cp = skipWhiteSpace(cp);
 			removeTrailingWhiteSpace(cp);
 
@@ -99,6 +427,18 @@ bool IniFile::getValue(const char* section, const char* key,
 }
 
 
+bool IniFile::getValue(const char* section, const char* key,
+					   char* buffer, size_t len,
+					   uint32_t &lineNumber, uint32_t &position) const
+{
+	IniFileState state;
+	while (!getValue(section, key, buffer, len, state))
+		;
+	lineNumber = state.getLineNumber();
+	position = state.getPosition();
+	return _error == errorNoError;
+}
+
 bool IniFile::getValue(const char* section, const char* key,
 					   char* buffer, size_t len, char *value, size_t vlen) const
 {
@@ -111,27 +451,13 @@ bool IniFile::getValue(const char* section, const char* key,
 }
 
 
-// For true accept: true, yes, 1
-// For false accept: false, no, 0
 bool IniFile::getValue(const char* section, const char* key,
 					   char* buffer, size_t len, bool& val) const
 {
 	if (!getValue(section, key, buffer, len))
 		return false; // error
 
-	if (strcasecmp(buffer, "true") == 0 ||
-		strcasecmp(buffer, "yes") == 0 ||
-		strcasecmp(buffer, "1") == 0) {
-		val = true;
-		return true;
-	}
-	if (strcasecmp(buffer, "false") == 0 ||
-		strcasecmp(buffer, "no") == 0 ||
-		strcasecmp(buffer, "0") == 0) {
-		val = false;
-		return true;
-	}
-	return false; // does not match any known strings
+	return parseBool(buffer, val);
 }
 
 bool IniFile::getValue(const char* section, const char* key,
@@ -158,20 +484,22 @@ bool IniFile::getValue(const char* section, const char* key,
 					   char* buffer, size_t len, uint8_t& val) const
 {
 	long longval;
-	bool r = getValue(section, key, buffer, len, longval);
-	if (r)
-		val = uint8_t(longval);
-	return r;
+	if (!getValue(section, key, buffer, len) ||
+		!parseLong(buffer, longval) || longval < 0 || longval > 0xFF)
+		return false;
+	val = uint8_t(longval);
+	return true;
 }
 
 bool IniFile::getValue(const char* section, const char* key,
 					   char* buffer, size_t len, uint16_t& val) const
 {
 	long longval;
-	bool r = getValue(section, key, buffer, len, longval);
-	if (r)
-		val = uint16_t(longval);
-	return r;
+	if (!getValue(section, key, buffer, len) ||
+		!parseLong(buffer, longval) || longval < 0 || longval > 0xFFFF)
+		return false;
+	val = uint16_t(longval);
+	return true;
 }
 
 bool IniFile::getValue(const char* section, const char* key,
@@ -190,17 +518,7 @@ bool IniFile::getValue(const char* section, const char* key,
 	if (!getValue(section, key, buffer, len))
 		return false; // error
 
-	char *endptr;
-	unsigned long tmp = strtoul(buffer, &endptr, 10);
-	if (endptr == buffer)
-		return false; // no conversion
-	if (*endptr == '\0') {
-		val = tmp;
-		return true; // valid conversion
-	}
-	// buffer has trailing non-numeric characters, and since the buffer
-	// already had whitespace removed discard the entire results
-	return false;
+	return parseUnsignedLong(buffer, val);
 }
 
 
@@ -210,19 +528,72 @@ bool IniFile::getValue(const char* section, const char* key,
 	if (!getValue(section, key, buffer, len))
 		return false; // error
 
-	char *endptr;
-	float tmp = strtod(buffer, &endptr);
-	if (endptr == buffer)
-		return false; // no conversion
-	if (*endptr == '\0') {
-		val = tmp;
-		return true; // valid conversion
-	}
-	// buffer has trailing non-numeric characters, and since the buffer
-	// already had whitespace removed discard the entire results
-	return false;
+	return parseFloat(buffer, val);
+}
+
+
+bool IniFile::getValue(const IniKey& section, const IniKey& key,
+					   char* buffer, size_t len) const
+{
+	if (!isOpen() || _index == nullptr || !_index->isValid())
+		return getValue(section.getName(), key.getName(), buffer, len);
+	entry_t entry;
+	_error = _index->getValue(*this, section, key, buffer, len, &entry);
+	if (_error == errorNoError)
+		copyResolved(entry, buffer, len);
+	return _error == errorNoError;
+}
+
+bool IniFile::getValue(const IniKey& section, const IniKey& key,
+					   char* buffer, size_t len, bool& b) const
+{
+	if (!getValue(section, key, buffer, len))
+		return false; // error
+
+	return parseBool(buffer, b);
+}
+
+bool IniFile::getValue(const IniKey& section, const IniKey& key,
+					   char* buffer, size_t len, long& val) const
+{
+	if (!getValue(section, key, buffer, len))
+		return false; // error
+
+	val = atol(buffer);
+	return true;
+}
+
+bool IniFile::getValue(const IniKey& section, const IniKey& key,
+					   char* buffer, size_t len, unsigned long& val) const
+{
+	if (!getValue(section, key, buffer, len))
+		return false; // error
+
+	return parseUnsignedLong(buffer, val);
+}
+
+bool IniFile::getValue(const IniKey& section, const IniKey& key,
+					   char* buffer, size_t len, double& val) const
+{
+	if (!getValue(section, key, buffer, len))
+		return false; // error
+
+	val = atof(buffer);
+	return true;
 }
 
+void IniFile::copyResolved(entry_t entry, char* buffer, size_t len) const
+{
+	const char* resolved = nullptr;
+	if (_interpolation && _interpolation->isValid(*this))
+		resolved = _interpolation->getValue(entry);
+	if (resolved) {
+		if (strlen(resolved) < len)
+			strcpy(buffer, resolved);
+		else
+			_error = errorBufferTooSmall;
+	}
+}
 
 bool IniFile::getIPAddress(const char* section, const char* key,
 						   char* buffer, size_t len, uint8_t* ip) const
@@ -234,26 +605,7 @@ bool IniFile::getIPAddress(const char* section, const char* key,
 	if (!getValue(section, key, buffer, len))
 		return false; // error
 
-	int i = 0;
-	char* cp = buffer;
-	ip[0] = ip[1] = ip[2] = ip[3] = 0;
-	while (*cp != '\0' && i < 4) {
-		if (*cp == '.') {
-			++i;
-			++cp;
-			continue;
-		}
-		if (isdigit(*cp)) {
-			ip[i] *= 10;
-			ip[i] += (*cp - '0');
-		}
-		else {
-			ip[0] = ip[1] = ip[2] = ip[3] = 0;
-			return false;
-		}
-		++cp;
-	}
-	return true;
+	return parseIPAddress(buffer, ip);
 }
 
 
@@ -265,29 +617,11 @@ bool IniFile::getIPAddress(const char* section, const char* key,
 	if (len < 16)
 		return false;
 
-	if (!getValue(section, key, buffer, len))
-		return false; // error
-
-	int i = 0;
-	char* cp = buffer;
-	ip = IPAddress(0, 0, 0, 0);
-	while (*cp != '\0' && i < 4) {
-		if (*cp == '.') {
-			++i;
-			++cp;
-			continue;
-		}
-		if (isdigit(*cp)) {
-			ip[i] *= 10;
-			ip[i] += (*cp - '0');
-		}
-		else {
-			ip = IPAddress(0, 0, 0, 0);
-			return false;
-		}
-		++cp;
-	}
-	return true;
+	uint8_t a[4];
+	bool r = getIPAddress(section, key, buffer, len, a);
+	if (r)
+		ip = IPAddress(a[0], a[1], a[2], a[3]);
+	return r;
 }
 #endif
 
@@ -301,45 +635,42 @@ bool IniFile::getMACAddress(const char* section, const char* key,
 	if (!getValue(section, key, buffer, len))
 		return false; // error
 
-	int i = 0;
-	char* cp = buffer;
-	memset(mac, 0, 6);
+	return parseMACAddress(buffer, mac);
+}
 
-	while (*cp != '\0' && i < 6) {
-		if (*cp == ':' || *cp == '-') {
-			++i;
-			++cp;
-			continue;
-		}
-		if (isdigit(*cp)) {
-			mac[i] *= 16; // working in hex!
-			mac[i] += (*cp - '0');
-		}
-		else {
-			if (isxdigit(*cp)) {
-				mac[i] *= 16; // working in hex!
-				mac[i] += (toupper(*cp) - 55); // convert A to 0xA, F to 0xF
-			}
-			else {
-				memset(mac, 0, 6);
-				return false;
-			}
-		}
-		++cp;
-	}
-	return true;
+bool IniFile::getNetAddress(const char* section, const char* key,
+							char* buffer, size_t len,
+							IniNetAddress &addr) const
+{
+	if (!getValue(section, key, buffer, len))
+		return false; // error
+
+	return IniNetwork::parseAddress(buffer, addr);
+}
+
+bool IniFile::getHostPort(const char* section, const char* key,
+						  char* buffer, size_t len, char** host,
+						  uint16_t &port) const
+{
+	if (!getValue(section, key, buffer, len))
+		return false; // error
+
+	*host = IniNetwork::parseHostPort(buffer, port);
+	return *host != NULL;
 }
 
 // From the file location saved in 'state' look for the next section and read its name.
 // The name will be in the buffer. Returns false if no section found. 
 bool IniFile::browseSections(char* buffer, size_t len, IniFileState &state) const
 {
+	IniTraceScope scope(*this, IniTrace::opBrowseSections, NULL);
 	error_t err = errorNoError;
 	
 	do {
-		err = IniFile::readLine(_file, buffer, len, state.readLinePosition);
+		err = readNextLine(buffer, len, state);
 		
-		if (err != errorNoError) {
+		if (err != errorNoError &&
+			(err != errorEndOfFile || buffer[0] == '\0')) {
 			// end of file or other error
 			_error = err;
 			return false;
@@ -348,12 +679,8 @@ bool IniFile::browseSections(char* buffer, size_t len, IniFileState &state) cons
 
 			if (*cp == '[') {
 				// Found a section, read the name
-				++cp;
-				cp = skipWhiteSpace(cp);
-				char *ep = strchr(cp, ']');
-				if (ep != NULL) {
-					*ep = '\0'; // make ] be end of string
-					removeTrailingWhiteSpace(cp);
+				cp = parseSection(cp);
+				if (cp != NULL) {
 					// Copy from cp to buffer, but the strings overlap so strcpy is out
 					while (*cp != '\0')
 						*buffer++ = *cp++;
@@ -366,12 +693,11 @@ bool IniFile::browseSections(char* buffer, size_t len, IniFileState &state) cons
 		// continue searching
 	} while (err == errorNoError);
 	
-	// we should never get here...
+	// The last line had no newline and was not a section
 	_error = err;
 	return false;
 }
 
-//int8_t IniFile::readLine(File &file, char *buffer, size_t len, uint32_t &pos)
 IniFile::error_t IniFile::readLine(File &file, char *buffer, size_t len, uint32_t &pos)
 {
 	if (!file)
@@ -388,34 +714,312 @@ IniFile::error_t IniFile::readLine(File &file, char *buffer, size_t len, uint32_
 #else
 	size_t bytesRead = file.read(buffer, len);
 #endif
-	if (!bytesRead) {
-		buffer[0] = '\0';
-		//return 1; // done
-		return errorEndOfFile;
-	}
+	return terminateLine(buffer, len, bytesRead, !file.available(), pos);
+}
 
-	for (size_t i = 0; i < bytesRead && i < len-1; ++i) {
-		// Test for '\n' with optional '\r' too
-		// if (endOfLineTest(buffer, len, i, '\n', '\r')
+IniFile::error_t IniFile::readLine(const char* data, size_t dataLen,
+								   memory_t memType, char *buffer, size_t len,
+								   uint32_t &pos)
+{
+	if (data == nullptr)
+		return errorFileNotOpen;
 
-		if (buffer[i] == '\n' || buffer[i] == '\r') {
-			char match = buffer[i];
-			char otherNewline = (match == '\n' ? '\r' : '\n');
-			// end of line, discard any trailing character of the other sort
-			// of newline
-			buffer[i] = '\0';
+	if (len < 3)
+		return errorBufferTooSmall;
 
-			if (buffer[i+1] == otherNewline)
-				++i;
-			pos += (i + 1); // skip past newline(s)
-			//return (i+1 == bytesRead && !file.available());
-			return errorNoError;
-		}
-	}
-	if (!file.available()) {
-		// end of file without a newline
-		buffer[bytesRead] = '\0';
-		// return 1; //done
+	if (pos > dataLen)
+		return errorSeekError;
+
+	// No seek needed, copy only as much as could be returned
+	size_t bytesRead = dataLen - pos;
+	if (bytesRead > len)
+		bytesRead = len;
+#if defined(__AVR__)
+	if (memType == memoryPROGMEM)
+		memcpy_P(buffer, data + pos, bytesRead);
+	else
+#else
+	(void)memType;
+#endif
+		memcpy(buffer, data + pos, bytesRead);
+	return terminateLine(buffer, len, bytesRead, pos + bytesRead >= dataLen,
+						 pos);
+}
+
+IniFile::error_t IniFile::readLine(char *buffer, size_t len, uint32_t &pos) const
+{
+	if (_trace == nullptr)
+		return readSourceLine(buffer, len, pos);
+	traceBegin(IniTrace::opReadLine, NULL);
+	uint32_t start = pos;
+	error_t err = readSourceLine(buffer, len, pos);
+	// The last line of a file with no newline at the end does not move
+	// pos on
+	if (err == errorNoError)
+		_trace->addBytesRead(pos - start);
+	else if (err == errorEndOfFile)
+		_trace->addBytesRead(strlen(buffer));
+	traceEnd(IniTrace::opReadLine, err);
+	return err;
+}
+
+IniFile::error_t IniFile::readSourceLine(char *buffer, size_t len,
+										 uint32_t &pos) const
+{
+	if (isMemory()) {
+		if (!_memoryOpen)
+			return errorFileNotOpen;
+		return readLine(_data, _dataLen, _memType, buffer, len, pos);
+	}
+	if (_inflate == nullptr && _cache == nullptr)
+		return readLine(_file, buffer, len, pos);
+
+	if (!_file)
+		return errorFileNotOpen;
+
+	if (len < 3)
+		return errorBufferTooSmall;
+
+	size_t bytesRead;
+	bool atEnd;
+	if (_inflate == nullptr) {
+		// Through the block cache
+		error_t err = _cache->read(_file, pos, buffer, len, bytesRead);
+		if (err != errorNoError && err != errorEndOfFile)
+			return err;
+		atEnd = (pos + bytesRead >= _cache->getFileSize());
+		return terminateLine(buffer, len, bytesRead, atEnd, pos);
+	}
+
+	bytesRead = _inflate->read(_file, pos, buffer, len);
+	if (_inflate->getError())
+		return errorDecompressionError;
+	// A full buffer might be all there is, check for one more byte
+	char c;
+	atEnd = (bytesRead < len ||
+			 _inflate->read(_file, pos + bytesRead, &c, 1) == 0);
+	return terminateLine(buffer, len, bytesRead, atEnd, pos);
+}
+
+IniFile::error_t IniFile::read(uint32_t pos, char *buffer, size_t len,
+							   size_t &bytesRead) const
+{
+	bytesRead = 0;
+	if (!isOpen())
+		return errorFileNotOpen;
+
+	if (isMemory()) {
+		if (pos > _dataLen)
+			return errorSeekError;
+		bytesRead = _dataLen - pos;
+		if (bytesRead > len)
+			bytesRead = len;
+#if defined(__AVR__)
+		if (_memType == memoryPROGMEM)
+			memcpy_P(buffer, _data + pos, bytesRead);
+		else
+#endif
+			memcpy(buffer, _data + pos, bytesRead);
+	}
+	else if (_inflate) {
+		bytesRead = _inflate->read(_file, pos, buffer, len);
+		if (_inflate->getError())
+			return errorDecompressionError;
+	}
+	else if (_cache) {
+		error_t err = _cache->read(_file, pos, buffer, len, bytesRead);
+		if (_trace)
+			_trace->addBytesRead(bytesRead);
+		return err;
+	}
+	else {
+		if (!_file.seek(pos))
+			return errorSeekError;
+#if defined(ARDUINO_ARCH_ESP32) && !defined(PREFER_SDFAT_LIBRARY)
+		bytesRead = _file.readBytes(buffer, len);
+#else
+		bytesRead = _file.read(buffer, len);
+#endif
+	}
+	if (_trace)
+		_trace->addBytesRead(bytesRead);
+	return (bytesRead ? errorNoError : errorEndOfFile);
+}
+
+IniFile::error_t IniFile::readNextLine(char *buffer, size_t len,
+									   IniFileState &state) const
+{
+	while (true) {
+		uint32_t pos = state.readLinePosition;
+		error_t err = readLine(buffer, len, state.readLinePosition);
+		// Reaching the end of the file is not a line
+		if (err != errorEndOfFile || buffer[0] != '\0') {
+			state.linePosition = pos;
+			if (state.countLines)
+				++state.lineNumber;
+		}
+		// A last line without a newline is not read again by the next call
+		if (err == errorEndOfFile)
+			state.readLinePosition = pos + strlen(buffer);
+		if (!(_syntax & syntaxContinuation) ||
+			(err != errorNoError && err != errorEndOfFile))
+			return err;
+
+		// Lines which continue a value are not lines of their own
+		bool continuation = (state.valueState & valueContinues);
+		char* value = (continuation ? buffer : findValue(buffer));
+		if (value)
+			decodeValue(value, _syntax, state.valueState, false);
+		else
+			state.valueState = 0;
+		if (!continuation)
+			return err;
+		if (err == errorEndOfFile) {
+			buffer[0] = '\0';
+			return err;
+		}
+	}
+}
+
+bool IniFile::checkSortedSections(char* buffer, size_t len) const
+{
+	if (!isOpen()) {
+		_error = errorFileNotOpen;
+		return false;
+	}
+	size_t half = len / 2;
+	char* last = buffer + half;
+	bool first = true;
+	IniFileState state;
+	while (true) {
+		error_t err = readNextLine(buffer, half, state);
+		if (err != errorNoError && err != errorEndOfFile) {
+			_error = err;
+			return false;
+		}
+		char* cp = skipWhiteSpace(buffer);
+		if (*cp == '[' && (cp = parseSection(cp)) != NULL) {
+			if (!first && compareNames(last, cp) > 0) {
+				_error = errorNoError;
+				return false;
+			}
+			memmove(last, cp, strlen(cp) + 1);
+			first = false;
+		}
+		if (err == errorEndOfFile)
+			break;
+	}
+	_error = errorNoError;
+	return true;
+}
+
+IniFile::error_t IniFile::findSortedSection(const char* section,
+											char* buffer, size_t len,
+											uint32_t &pos) const
+{
+	// Every section which starts before lo sorts before section, and
+	// the first one which starts at or after hi does not
+	uint32_t lo = 0;
+	uint32_t hi = (isMemory() ? _dataLen : _file.size());
+	uint32_t start;
+	char* name;
+	error_t err;
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		pos = mid;
+		err = nextSection(buffer, len, pos, start, &name);
+		if (err == errorEndOfFile)
+			hi = mid;
+		else if (err != errorNoError)
+			return err;
+		else if (compareNames(name, section) < 0)
+			lo = start + 1;
+		else
+			hi = mid;
+	}
+	pos = lo;
+	err = nextSection(buffer, len, pos, start, &name);
+	if (err == errorEndOfFile || (err == errorNoError &&
+								  !matchName(name, section)))
+		return errorSectionNotFound;
+	pos = start;
+	return err;
+}
+
+IniFile::error_t IniFile::nextSection(char* buffer, size_t len,
+									  uint32_t &pos, uint32_t &start,
+									  char** name) const
+{
+	error_t err;
+	if (pos) {
+		// Skip the rest of the line holding the byte before pos
+		--pos;
+		err = readLine(buffer, len, pos);
+		if (err != errorNoError)
+			return err;
+	}
+	while (true) {
+		start = pos;
+		err = readLine(buffer, len, pos);
+		if (err != errorNoError && err != errorEndOfFile)
+			return err;
+		char* cp = skipWhiteSpace(buffer);
+		if (*cp == '[' && (*name = parseSection(cp)) != NULL)
+			return errorNoError;
+		if (err == errorEndOfFile)
+			return err;
+	}
+}
+
+int IniFile::compareNames(const char* a, const char* b) const
+{
+	return (_caseSensitive ? strcmp(a, b) : strcasecmp(a, b));
+}
+
+bool IniFile::skipToCheckpoint(const char* section, uint16_t n,
+							   IniFileState &state) const
+{
+	n = _sparseIndex->find(IniTokenizer::hash(section), n);
+	state.checkpoint = n;
+	if (n == IniSparseIndex::noCheckpoint) {
+		_error = errorSectionNotFound;
+		return false;
+	}
+	// Checkpoints are at section lines, which never continue a value
+	const IniCheckpoint &c = _sparseIndex->getCheckpoint(n);
+	state.readLinePosition = c.position;
+	state.lineNumber = c.line - 1;
+	state.valueState = 0;
+	return true;
+}
+
+IniFile::error_t IniFile::terminateLine(char *buffer, size_t len,
+										size_t bytesRead, bool atEnd,
+										uint32_t &pos)
+{
+	if (!bytesRead) {
+		buffer[0] = '\0';
+		return errorEndOfFile;
+	}
+
+	for (size_t i = 0; i < bytesRead && i < len-1; ++i) {
+		// Test for '\n' with optional '\r' too
+		if (buffer[i] == '\n' || buffer[i] == '\r') {
+			char match = buffer[i];
+			char otherNewline = (match == '\n' ? '\r' : '\n');
+			// end of line, discard any trailing character of the other sort
+			// of newline
+			buffer[i] = '\0';
+
+			if (i+1 < bytesRead && buffer[i+1] == otherNewline)
+				++i;
+			pos += (i + 1); // skip past newline(s)
+			return errorNoError;
+		}
+	}
+	if (atEnd && bytesRead < len) {
+		// end of file without a newline
+		buffer[bytesRead] = '\0';
 		return errorEndOfFile;
 	}
 
@@ -423,6 +1027,100 @@ IniFile::error_t IniFile::readLine(File &file, char *buffer, size_t len, uint32_
 	return errorBufferTooSmall;
 }
 
+size_t IniFile::decodeValue(char* str, uint8_t syntax, uint8_t &state,
+							bool write)
+{
+	char* in = skipWhiteSpace(str);
+	char* out = str;
+	char* end = str; // After the last character kept
+	bool quoted = (state & valueQuoted);
+	bool space = true; // Whether the previous character was whitespace
+	state = 0;
+	while (*in) {
+		char c = *in++;
+		if (quoted) {
+			if (c == '"')
+				quoted = false;
+			else if (c == '\\' && *in == '\0' &&
+					 (syntax & syntaxContinuation)) {
+				state = valueQuoted | valueContinues;
+				break;
+			}
+			else {
+				if (c == '\\' && *in != '\0') {
+					c = *in++;
+					if (c == 'n')
+						c = '\n';
+					else if (c == 't')
+						c = '\t';
+					else if (c == 'r')
+						c = '\r';
+				}
+				if (write)
+					*out = c;
+				++out;
+			}
+			end = out;
+			space = false;
+			continue;
+		}
+
+		if (c == '"' && (syntax & syntaxQuotes)) {
+			quoted = true;
+			space = false;
+			continue;
+		}
+		if (isCommentChar(c) && space && (syntax & syntaxInlineComments))
+			break;
+		if (c == '\\' && (syntax & syntaxContinuation) &&
+			*skipWhiteSpace(in) == '\0') {
+			// Whitespace before the backslash is kept
+			state = valueContinues;
+			end = out;
+			break;
+		}
+		if (write)
+			*out = c;
+		++out;
+		space = isspace(c);
+		if (!space)
+			end = out;
+	}
+	if (write)
+		*end = '\0';
+	return end - str;
+}
+
+IniFile::error_t IniFile::readValue(char* buffer, size_t len, char* value,
+									uint32_t pos) const
+{
+	// As for readNextLine(), a line starting with '[' never continues
+	uint8_t syntax = _syntax;
+	if (*skipWhiteSpace(buffer) == '[')
+		syntax &= ~syntaxContinuation;
+	uint8_t state = 0;
+	size_t n = decodeValue(value, syntax, state);
+	while (state & valueContinues) {
+		char* cp = value + n;
+		error_t err = readLine(cp, len - (cp - buffer), pos);
+		if (err != errorNoError && err != errorEndOfFile)
+			return err;
+		n += decodeValue(cp, syntax, state);
+		if (err == errorEndOfFile)
+			break;
+	}
+	return errorNoError;
+}
+
+char* IniFile::findValue(char* line)
+{
+	char* cp = skipWhiteSpace(line);
+	if (isCommentChar(*cp) || *cp == '[')
+		return NULL;
+	cp = strchr(cp, '=');
+	return (cp == NULL ? NULL : cp + 1);
+}
+
 bool IniFile::isCommentChar(char c)
 {
 	return (c == ';' || c == '#');
@@ -446,6 +1144,216 @@ void IniFile::removeTrailingWhiteSpace(char* str)
 		*cp-- = '\0';
 }
 
+char* IniFile::parseSection(char* str)
+{
+	char *cp = skipWhiteSpace(str + 1);
+	char *ep = strchr(cp, ']');
+	if (ep == NULL)
+		return NULL;
+	*ep = '\0'; // make ] be end of string
+	removeTrailingWhiteSpace(cp);
+	return cp;
+}
+
+char* IniFile::parseKey(char* str, char** value)
+{
+	char *ep = strchr(str, '=');
+	if (ep == NULL)
+		return NULL;
+	*ep = '\0'; // make = be the end of string
+	removeTrailingWhiteSpace(str);
+	*value = ep + 1;
+	return str;
+}
+
+bool IniFile::matchName(const char* name, const char* wanted) const
+{
+	return matchName(name, wanted, strlen(wanted));
+}
+
+bool IniFile::matchName(const char* name, const char* wanted,
+						size_t wantedLen) const
+{
+	if (strlen(name) != wantedLen)
+		return false;
+	if (_caseSensitive)
+		return memcmp(name, wanted, wantedLen) == 0;
+	return equalFolded(name, wanted, wantedLen);
+}
+
+bool IniFile::equalFolded(const char* a, const char* b, size_t len)
+{
+	size_t i = 0;
+#if defined(INIFILE_HOST)
+	// Eight characters at a time. Words which differ only in the case
+	// bit (0x20) of bytes which are letters in a are equal. In each
+	// byte bit 7 of ge is set if a's lower-case 7 bits are at least
+	// 'a', and of gt if they are more than 'z'.
+	const uint64_t ones = 0x0101010101010101ULL;
+	const uint64_t high = ones * 0x80;
+	for (; i + 8 <= len; i += 8) {
+		uint64_t wa, wb;
+		memcpy(&wa, a + i, 8);
+		memcpy(&wb, b + i, 8);
+		uint64_t diff = wa ^ wb;
+		if (diff == 0)
+			continue;
+		if (diff & ~(ones * 0x20))
+			return false;
+		uint64_t low = (wa | ones * 0x20) & ~high;
+		uint64_t ge = low + ones * (0x80 - 'a');
+		uint64_t gt = low + ones * (0x80 - 'z' - 1);
+		uint64_t letter = ge & ~gt & ~wa & high;
+		if ((diff << 2) & ~letter)
+			return false;
+	}
+#endif
+	for (; i < len; ++i)
+		if (a[i] != b[i] &&
+			IniTokenizer::foldCase(a[i]) != IniTokenizer::foldCase(b[i]))
+			return false;
+	return true;
+}
+
+bool IniFile::matchPattern(const char* name, const char* pattern) const
+{
+	// After a mismatch go back to the last '*' and let it match one
+	// more character
+	const char* star = nullptr;
+	const char* retry = nullptr;
+	while (*name != '\0') {
+		if (*pattern == '*') {
+			star = ++pattern;
+			retry = name;
+		}
+		else if (*pattern != '\0' &&
+				 (*pattern == '?' || *pattern == *name ||
+				  (!_caseSensitive && IniTokenizer::foldCase(*pattern) ==
+				   IniTokenizer::foldCase(*name)))) {
+			++pattern;
+			++name;
+		}
+		else if (star) {
+			pattern = star;
+			name = ++retry;
+		}
+		else
+			return false;
+	}
+	while (*pattern == '*')
+		++pattern;
+	return *pattern == '\0';
+}
+
+// For true accept: true, yes, 1
+// For false accept: false, no, 0
+bool IniFile::parseBool(const char* str, bool& val)
+{
+	if (strcasecmp(str, "true") == 0 ||
+		strcasecmp(str, "yes") == 0 ||
+		strcasecmp(str, "1") == 0) {
+		val = true;
+		return true;
+	}
+	if (strcasecmp(str, "false") == 0 ||
+		strcasecmp(str, "no") == 0 ||
+		strcasecmp(str, "0") == 0) {
+		val = false;
+		return true;
+	}
+	return false; // does not match any known strings
+}
+
+bool IniFile::parseUnsignedLong(const char* str, unsigned long& val)
+{
+	char *endptr;
+	unsigned long tmp = strtoul(str, &endptr, 10);
+	if (endptr == str)
+		return false; // no conversion
+	if (*endptr == '\0') {
+		val = tmp;
+		return true; // valid conversion
+	}
+	// str has trailing non-numeric characters, and since values
+	// already have whitespace removed discard the entire results
+	return false;
+}
+
+bool IniFile::parseLong(const char* str, long& val)
+{
+	char *endptr;
+	long tmp = strtol(str, &endptr, 10);
+	if (endptr == str || *endptr != '\0')
+		return false; // No conversion, or trailing characters
+	val = tmp;
+	return true;
+}
+
+bool IniFile::parseFloat(const char* str, float& val)
+{
+	char *endptr;
+	float tmp = strtod(str, &endptr);
+	if (endptr == str)
+		return false; // no conversion
+	if (*endptr == '\0') {
+		val = tmp;
+		return true; // valid conversion
+	}
+	// As above, trailing non-numeric characters are not allowed
+	return false;
+}
+
+bool IniFile::parseDouble(const char* str, double& val)
+{
+	char *endptr;
+	double tmp = strtod(str, &endptr);
+	if (endptr == str || *endptr != '\0')
+		return false; // No conversion, or trailing characters
+	val = tmp;
+	return true;
+}
+
+bool IniFile::parseIPAddress(const char* str, uint8_t* ip)
+{
+	const char* cp = IniNetwork::parseIPv4(str, ip);
+	if (cp == NULL || *cp != '\0') {
+		ip[0] = ip[1] = ip[2] = ip[3] = 0;
+		return false;
+	}
+	return true;
+}
+
+bool IniFile::parseMACAddress(const char* str, uint8_t mac[6])
+{
+	int i = 0;
+	const char* cp = str;
+	memset(mac, 0, 6);
+
+	while (*cp != '\0' && i < 6) {
+		if (*cp == ':' || *cp == '-') {
+			++i;
+			++cp;
+			continue;
+		}
+		if (isdigit(*cp)) {
+			mac[i] *= 16; // working in hex!
+			mac[i] += (*cp - '0');
+		}
+		else {
+			if (isxdigit(*cp)) {
+				mac[i] *= 16; // working in hex!
+				mac[i] += (toupper(*cp) - 55); // convert A to 0xA, F to 0xF
+			}
+			else {
+				memset(mac, 0, 6);
+				return false;
+			}
+		}
+		++cp;
+	}
+	return true;
+}
+
 bool IniFile::findSection(const char* section, char* buffer, size_t len,
 						  IniFileState &state) const
 {
@@ -454,7 +1362,7 @@ bool IniFile::findSection(const char* section, char* buffer, size_t len,
 		return true;
 	}
 
-	error_t err = IniFile::readLine(_file, buffer, len, state.readLinePosition);
+	error_t err = readNextLine(buffer, len, state);
 
 	if (err != errorNoError && err != errorEndOfFile) {
 		// Signal to caller to stop looking and any error value
@@ -477,24 +1385,10 @@ bool IniFile::findSection(const char* section, char* buffer, size_t len,
 
 	if (*cp == '[') {
 		// Start of section
-		++cp;
-		cp = skipWhiteSpace(cp);
-		char *ep = strchr(cp, ']');
-		if (ep != NULL) {
-			*ep = '\0'; // make ] be end of string
-			removeTrailingWhiteSpace(cp);
-			if (_caseSensitive) {
-				if (strcmp(cp, section) == 0) {
-					_error = errorNoError;
-					return true;
-				}
-			}
-			else {
-				if (strcasecmp(cp, section) == 0) {
-					_error = errorNoError;
-					return true;
-				}
-			}
+		cp = parseSection(cp);
+		if (cp != NULL && matchName(cp, section, state.sectionLength)) {
+			_error = errorNoError;
+			return true;
 		}
 	}
 
@@ -519,7 +1413,7 @@ bool IniFile::findKey(const char* section, const char* key,
 		return true;
 	}
 
-	error_t err = IniFile::readLine(_file, buffer, len, state.readLinePosition);
+	error_t err = readNextLine(buffer, len, state);
 	if (err != errorNoError && err != errorEndOfFile) {
 		_error = err;
 		return true;
@@ -544,24 +1438,12 @@ bool IniFile::findKey(const char* section, const char* key,
 	}
 
 	// Find '='
-	char *ep = strchr(cp, '=');
-	if (ep != NULL) {
-		*ep = '\0'; // make = be the end of string
-		removeTrailingWhiteSpace(cp);
-		if (_caseSensitive) {
-			if (strcmp(cp, key) == 0) {
-				*keyptr = ep + 1;
-				_error = errorNoError;
-				return true;
-			}
-		}
-		else {
-			if (strcasecmp(cp, key) == 0) {
-				*keyptr = ep + 1;
-				_error = errorNoError;
-				return true;
-			}
-		}
+	char *vp;
+	cp = parseKey(cp, &vp);
+	if (cp != NULL && matchName(cp, key, state.keyLength)) {
+		*keyptr = vp;
+		_error = errorNoError;
+		return true;
 	}
 
 	// Not the valid key line
@@ -572,6 +1454,118 @@ bool IniFile::findKey(const char* section, const char* key,
 	return false;
 }
 
+bool IniFile::browseKeys(const char* section, const char* pattern,
+						 char* buffer, size_t len, IniFileState &state,
+						 char** key, char** value) const
+{
+	if (!isOpen()) {
+		_error = errorFileNotOpen;
+		return false;
+	}
+	// Only the part before any wildcard can be used to search the index
+	size_t prefixLen = strcspn(pattern, "*?");
+
+	if (state.getValueState == IniFileState::funcUnset) {
+		state.readLinePosition = 0;
+		state.valueState = 0;
+		if (_index && _index->isSorted(*this) && section != NULL) {
+			entry_t n;
+			_error = _index->findPrefix(*this, section, pattern, prefixLen,
+										buffer, len, n);
+			if (_error != errorNoError)
+				return false;
+			state.readLinePosition = n;
+			state.getValueState = IniFileState::funcBrowseIndex;
+		}
+		else {
+			state.sectionLength = (section == NULL ? 0 : strlen(section));
+			if (section != NULL)
+				while (!findSection(section, buffer, len, state))
+					;
+			else
+				_error = errorNoError;
+			if (_error != errorNoError)
+				return false;
+			state.getValueState = IniFileState::funcBrowseKeys;
+		}
+	}
+
+	error_t err = errorNoError;
+	char* cp;
+	switch (state.getValueState) {
+	case IniFileState::funcBrowseIndex:
+		while (state.readLinePosition < _index->getNumEntries()) {
+			const IniIndexEntry &e =
+				_index->getEntry(_index->getSorted(state.readLinePosition));
+			if (e.type != IniLine::typeKey)
+				break; // End of the section
+			++state.readLinePosition;
+			uint32_t pos = e.position;
+			err = readLine(buffer, len, pos);
+			if (err != errorNoError && err != errorEndOfFile) {
+				_error = err;
+				return false;
+			}
+			if (err == errorEndOfFile)
+				pos = e.position + strlen(buffer);
+			cp = parseKey(skipWhiteSpace(buffer), value);
+			if (cp == NULL)
+				continue;
+			if ((_caseSensitive ? strncmp(cp, pattern, prefixLen)
+				 : strncasecmp(cp, pattern, prefixLen)) != 0)
+				break; // No more keys with the prefix
+			if (matchPattern(cp, pattern)) {
+				state.linePosition = e.position;
+				state.lineNumber = e.line;
+				*key = cp;
+				return readBrowsedValue(buffer, len, value, pos);
+			}
+		}
+		break;
+
+	case IniFileState::funcBrowseKeys:
+		while (err != errorEndOfFile) {
+			err = readNextLine(buffer, len, state);
+			if (err != errorNoError && err != errorEndOfFile) {
+				_error = err;
+				return false;
+			}
+			cp = skipWhiteSpace(buffer);
+			if (isCommentChar(*cp))
+				continue;
+			if (section && *cp == '[')
+				break; // End of the section
+			cp = parseKey(cp, value);
+			if (cp != NULL && *cp != '\0' && matchPattern(cp, pattern)) {
+				*key = cp;
+				return readBrowsedValue(buffer, len, value,
+										state.readLinePosition);
+			}
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	state.getValueState = IniFileState::funcBrowseEnd;
+	_error = errorEndOfFile;
+	return false;
+}
+
+bool IniFile::readBrowsedValue(char* buffer, size_t len, char** value,
+								uint32_t pos) const
+{
+	if (_syntax) {
+		_error = readValue(buffer, len, *value, pos);
+		return (_error == errorNoError);
+	}
+	*value = skipWhiteSpace(*value);
+	removeTrailingWhiteSpace(*value);
+	_error = errorNoError;
+	return true;
+}
+
 bool IniFile::getCaseSensitive(void) const
 {
 	return _caseSensitive;
@@ -579,11 +1573,99 @@ bool IniFile::getCaseSensitive(void) const
 
 void IniFile::setCaseSensitive(bool cs)
 {
+	if (cs != _caseSensitive)
+		++_generation;
 	_caseSensitive = cs;
 }
 
+void IniFile::setSyntax(uint8_t syntax)
+{
+	_syntax = syntax;
+	resetSource();
+}
+
+void IniFile::setInflate(IniInflate* inflate)
+{
+	_inflate = inflate;
+	resetSource();
+}
+
+void IniFile::setIndex(IniIndex* index)
+{
+	_index = index;
+}
+
+void IniFile::setSparseIndex(IniSparseIndex* sparseIndex)
+{
+	_sparseIndex = sparseIndex;
+}
+
+void IniFile::setInterpolation(IniInterpolation* interpolation)
+{
+	_interpolation = interpolation;
+}
+
+void IniFile::traceStep(uint8_t before, const IniFileState &state,
+						bool done, const char* section,
+						const char* key) const
+{
+	// A search ends when the lookup is done or moves on to the next
+	// stage, and starts when a step moves on to it
+	uint8_t after = (done ? uint8_t(IniFileState::funcUnset)
+					 : state.getValueState);
+	if (before == after)
+		return;
+	if (before == IniFileState::funcFindSection)
+		traceEnd(IniTrace::opFindSection, _error);
+	else if (before == IniFileState::funcFindKey)
+		traceEnd(IniTrace::opFindKey, _error);
+	if (after == IniFileState::funcFindSection)
+		traceBegin(IniTrace::opFindSection, section);
+	else if (after == IniFileState::funcFindKey)
+		traceBegin(IniTrace::opFindKey, key);
+}
+
+void IniFile::traceBegin(uint8_t op, const char* name) const
+{
+	if (_trace && _trace->isTraced(op))
+		_trace->begin(*this, op, name);
+}
+
+void IniFile::traceEnd(uint8_t op, error_t err) const
+{
+	if (_trace && _trace->isTraced(op))
+		_trace->end(*this, op, err);
+}
+
+void IniFile::setCache(IniBlockCache* cache)
+{
+	_cache = cache;
+	if (_cache)
+		_cache->clear();
+}
+
+void IniFile::resetSource(void)
+{
+	++_generation;
+	if (_inflate)
+		_inflate->reset();
+	if (_cache)
+		_cache->clear();
+	if (_index)
+		_index->clear();
+	if (_sparseIndex)
+		_sparseIndex->clear();
+}
+
 IniFileState::IniFileState()
 {
 	readLinePosition = 0;
+	linePosition = 0;
+	lineNumber = 0;
+	sectionLength = 0;
+	keyLength = 0;
 	getValueState = funcUnset;
+	valueState = 0;
+	checkpoint = IniSparseIndex::noCheckpoint;
+	countLines = true;
 }
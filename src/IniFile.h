@@ -11,13 +11,34 @@ extern SdFat SD;
 #endif
 #include "IPAddress.h"
 
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#endif
+
 #define INIFILE_VERSION "1.3.0"
 
+// Features which need threads or the C++ standard library are only
+// built for a host operating system, not for Arduino
+#if !defined(ARDUINO) && !defined(INIFILE_NO_HOST)
+#define INIFILE_HOST
+#endif
+
 // Maximum length for filename, excluding NULL char 26 chars allows an
 // 8.3 filename instead and 8.3 directory with a leading slash
 #define INI_FILE_MAX_FILENAME_LEN 26
 
+class IniBlockCache;
 class IniFileState;
+class IniInflate;
+class IniIndex;
+class IniInterpolation;
+class IniKey;
+class IniSchema;
+class IniSparseIndex;
+class IniTrace;
+class IniValidation;
+struct IniLine;
+struct IniNetAddress;
 
 class IniFile {
 public:
@@ -39,16 +60,56 @@ public:
 		errorKeyNotFound,
 		errorEndOfFile,
 		errorUnknownError,
+		errorDecompressionError,
+		errorWriteError,
+		errorImageError,
+		errorInterpolationError,
+		errorPatchError,
+		errorSchemaError,
+	};
+
+	// Entry number of an IniIndex. On a host a generated file may well
+	// have more section and key lines than 16 bits can number.
+#if defined(INIFILE_HOST)
+	typedef uint32_t entry_t;
+#else
+	typedef uint16_t entry_t;
+#endif
+
+	// Where the data for an IniFile held in memory is stored
+	enum memory_t {
+		memoryRAM = 0,
+		memoryPROGMEM,
+	};
+
+	// Optional value syntax, see setSyntax()
+	enum syntax_t {
+		syntaxQuotes = 1,         // "..." with \ escapes, ; and # literal
+		syntaxInlineComments = 2, // ; or # after whitespace ends the value
+		syntaxContinuation = 4,   // \ at the end of a line joins the next
 	};
 
+	// Carried from one line of a value to the next by decodeValue()
+	static const uint8_t valueQuoted = 1;
+	static const uint8_t valueContinues = 2;
+
 	static const uint8_t maxFilenameLen;
 
 	// Create an IniFile object. It isn't opened until open() is called on it.
 	IniFile(const char* filename, mode_t mode = FILE_READ,
 			bool caseSensitive = false);
+
+	// Create an IniFile object which reads directly from a buffer in
+	// memory instead of a file. The data is not copied so it must
+	// remain valid for the lifetime of the object. Use memoryPROGMEM
+	// for data stored in program memory on AVR; flash-mapped data on
+	// other architectures can be read as memoryRAM. The object is open
+	// as soon as it is created.
+	IniFile(const char* data, size_t dataLen, memory_t memType,
+			bool caseSensitive = false);
 	~IniFile();
 
-	inline bool open(void); // Returns true if open succeeded
+	bool open(void); // Returns true if open succeeded
 	inline void close(void);
 
 	inline bool isOpen(void) const;
@@ -61,7 +122,22 @@ public:
 	// Get the filename asscoiated with the ini file object
 	inline const char* getFilename(void) const;
 
+	// True if the data is read from memory instead of a file
+	inline bool isMemory(void) const;
+	// The data and its length when held in memory
+	inline const char* getData(void) const;
+	inline uint32_t getDataLen(void) const;
+
+	// Check that every line can be read using a buffer of len
+	// bytes. The file is read once, in blocks of len bytes.
 	bool validate(char* buffer, size_t len) const;
+	// As above, also reporting the line numbers and positions of
+	// any problems and statistics about the file
+	bool validate(char* buffer, size_t len, IniValidation &validation) const;
+	// Check and convert the values of every key in schema, reading the
+	// file once. Returns false with errorSchemaError if a required key
+	// is missing or a value is not valid; the schema has the details.
+	bool validate(char* buffer, size_t len, IniSchema &schema) const;
 
 	// Get value from the file, but split into many short tasks. Return
 	// value: false means continue, true means stop. Call getError() to
@@ -74,6 +150,12 @@ public:
 	bool getValue(const char* section, const char* key,
 				  char* buffer, size_t len) const;
 
+	// As above, also returning the line number and position of the
+	// key, or of the line where the search failed (see IniFileState)
+	bool getValue(const char* section, const char* key,
+				  char* buffer, size_t len,
+				  uint32_t &lineNumber, uint32_t &position) const;
+
 	// Get the value as a string, storing the result in a new buffer
 	// (not the working buffer)
 	bool getValue(const char* section, const char* key,
@@ -91,11 +173,11 @@ public:
 	bool getValue(const char* section, const char* key,
 				  char* buffer, size_t len, double& val) const;
 
-	// Get a uint8_t value
+	// Get a uint8_t value. False if it is not a number in range.
 	bool getValue(const char* section, const char* key,
 				  char* buffer, size_t len, uint8_t& val) const;
 
-	// Get a uint16_t value
+	// Get a uint16_t value. False if it is not a number in range.
 	bool getValue(const char* section, const char* key,
 				  char* buffer, size_t len, uint16_t& val) const;
 
@@ -110,6 +192,20 @@ public:
 	bool getValue(const char* section, const char* key,
 				  char* buffer, size_t len, float& val) const;
 
+	// As above with names whose hashes are already known (see
+	// IniKey.h), which an index with a hash table finds with a single
+	// probe. Without an index these are the same as passing the names.
+	bool getValue(const IniKey& section, const IniKey& key,
+				  char* buffer, size_t len) const;
+	bool getValue(const IniKey& section, const IniKey& key,
+				  char* buffer, size_t len, bool& b) const;
+	bool getValue(const IniKey& section, const IniKey& key,
+				  char* buffer, size_t len, long& val) const;
+	bool getValue(const IniKey& section, const IniKey& key,
+				  char* buffer, size_t len, unsigned long& val) const;
+	bool getValue(const IniKey& section, const IniKey& key,
+				  char* buffer, size_t len, double& val) const;
+
 	bool getIPAddress(const char* section, const char* key,
 					  char* buffer, size_t len, uint8_t* ip) const;
 
@@ -120,28 +216,207 @@ public:
 
 	bool getMACAddress(const char* section, const char* key,
 					   char* buffer, size_t len, uint8_t mac[6]) const;
+
+	// Get an IPv4 or IPv6 address with an optional "/prefix", as
+	// IniNetwork::parseAddress()
+	bool getNetAddress(const char* section, const char* key,
+					   char* buffer, size_t len, IniNetAddress &addr) const;
+
+	// Get "host:port", "[IPv6 address]:port" or just a host. host
+	// points into buffer. port is unchanged if the value has none.
+	bool getHostPort(const char* section, const char* key,
+					 char* buffer, size_t len, char** host,
+					 uint16_t &port) const;
 					   
 	// From the file location saved in 'state' look for the next section and read its name.
 	// The name will be in the buffer. Returns false if no section found. 
 	bool browseSections(char* buffer, size_t len, IniFileState &state) const;
 
+	// Find the keys in section which match pattern, one per call,
+	// starting with a new IniFileState. In pattern '*' matches any
+	// characters and '?' any one character. On success the line is in
+	// buffer with key and value pointing into it. Returns false at the
+	// end (errorEndOfFile) or on error. If section is NULL keys from
+	// the whole file are given. Keys come in file order, unless the
+	// index is sorted; then only those which start with the part of
+	// pattern before any wildcard are read, in sorted order.
+	bool browseKeys(const char* section, const char* pattern,
+					char* buffer, size_t len, IniFileState &state,
+					char** key, char** value) const;
+
 	// Utility function to read a line from a file, make available to all
 	//static int8_t readLine(File &file, char *buffer, size_t len, uint32_t &pos);
 	static error_t readLine(File &file, char *buffer, size_t len, uint32_t &pos);
+	// As above but reading from a buffer in memory
+	static error_t readLine(const char* data, size_t dataLen, memory_t memType,
+							char *buffer, size_t len, uint32_t &pos);
+	// Read a line from whichever file or memory buffer the object uses
+	error_t readLine(char *buffer, size_t len, uint32_t &pos) const;
+	// Read up to len bytes from pos, without regard to lines
+	error_t read(uint32_t pos, char *buffer, size_t len,
+				 size_t &bytesRead) const;
 	static bool isCommentChar(char c);
 	static char* skipWhiteSpace(char* str);
 	static void removeTrailingWhiteSpace(char* str);
+	// Split a section line, which must start with '[', in place.
+	// Returns the section name or NULL if it is not a valid section.
+	static char* parseSection(char* str);
+	// Split a key line in place. Returns the key and sets value to the
+	// text after '=', or returns NULL if there is no '='.
+	static char* parseKey(char* str, char** value);
+	// Compare a section name or key, taking account of case sensitivity
+	bool matchName(const char* name, const char* wanted) const;
+	// As above, given the length of wanted. Names of a different length
+	// are rejected without comparing them.
+	bool matchName(const char* name, const char* wanted,
+				   size_t wantedLen) const;
+	// Compare len characters, ignoring the case of ASCII letters
+	static bool equalFolded(const char* a, const char* b, size_t len);
+	// As above, where pattern may contain the wildcards '*' and '?'
+	bool matchPattern(const char* name, const char* pattern) const;
+	// Convert a value, as done by getValue(), getIPAddress() and
+	// getMACAddress(). Return false if the value is not valid.
+	static bool parseBool(const char* str, bool& val);
+	static bool parseUnsignedLong(const char* str, unsigned long& val);
+	static bool parseLong(const char* str, long& val);
+	static bool parseFloat(const char* str, float& val);
+	static bool parseDouble(const char* str, double& val);
+	static bool parseIPAddress(const char* str, uint8_t* ip);
+	static bool parseMACAddress(const char* str, uint8_t mac[6]);
 
 	bool getCaseSensitive(void) const;
 	void setCaseSensitive(bool cs);
 
+	// Choose which of the syntax_t features values may use, none by
+	// default. The index must be built again after changing this.
+	void setSyntax(uint8_t syntax);
+	inline uint8_t getSyntax(void) const;
+
+	// Decode one line of a value in place according to syntax, removing
+	// leading and trailing whitespace, quotes and comments. Returns the
+	// length of the result. Start with state 0; while it has
+	// valueContinues set the next line belongs to the value and should
+	// be decoded with the same state. If write is false str is not
+	// changed, only state is found.
+	static size_t decodeValue(char* str, uint8_t syntax, uint8_t &state,
+							  bool write = true);
+	// The value of a key line, or NULL for other lines. The line is not
+	// changed.
+	static char* findValue(char* line);
+	// Decode the value of the key line in buffer, in place at value,
+	// reading any continuation lines from pos into the rest of buffer
+	error_t readValue(char* buffer, size_t len, char* value,
+					  uint32_t pos) const;
+
+	// Read the file through a decompressor, for files compressed with
+	// gzip or zlib. The IniInflate object must remain valid while in
+	// use. Pass nullptr to read the file uncompressed.
+	void setInflate(IniInflate* inflate);
+	inline IniInflate* getInflate(void) const;
+
+	// Use an index to look up keys. The index must have been built for
+	// this object; open() marks it as invalid and if it is not valid
+	// the file is searched as normal. Pass nullptr to stop using it.
+	void setIndex(IniIndex* index);
+	inline IniIndex* getIndex(void) const;
+
+	// Trust that section names are in sorted order (byte order, or
+	// ignoring case unless case sensitive) so that a lookup finds its
+	// section by a binary search of the file, reading only a few lines
+	// and using no memory. Sections of the same name must be together.
+	// Not used for compressed files or with syntaxContinuation, and
+	// line numbers of keys found this way are not known.
+	inline void setSortedSections(bool sorted);
+	inline bool getSortedSections(void) const;
+	// Read the whole file to check that the sections are sorted, using
+	// half of buffer for each name compared
+	bool checkSortedSections(char* buffer, size_t len) const;
+
+	// Use a sparse index of section positions to skip to the section
+	// of a lookup, for when an IniIndex will not fit. As setIndex(); a
+	// valid IniIndex is used in preference.
+	void setSparseIndex(IniSparseIndex* sparseIndex);
+	inline IniSparseIndex* getSparseIndex(void) const;
+
+	// Read an uncompressed file through a cache of whole blocks. The
+	// cache must remain valid while in use and is cleared by open().
+	// Pass nullptr to read the file directly.
+	void setCache(IniBlockCache* cache);
+	inline IniBlockCache* getCache(void) const;
+
+	// Return values with references resolved by an IniInterpolation,
+	// which is only used while valid for the index. Pass nullptr to
+	// return values as they are in the file.
+	void setInterpolation(IniInterpolation* interpolation);
+	inline IniInterpolation* getInterpolation(void) const;
+
+	// Report the slower operations and the bytes read to a trace, to
+	// find out where the time goes. Pass nullptr to stop tracing.
+	inline void setTrace(IniTrace* trace);
+	inline IniTrace* getTrace(void) const;
+
+	// Changed whenever anything which depends on the file contents
+	// must be forgotten, ie by open(), setInflate() and
+	// setCaseSensitive()
+	inline uint32_t getGeneration(void) const;
+
 protected:
+	// One step of getValue(), without tracing
+	bool getValueStep(const char* section, const char* key, char* buffer,
+					  size_t len, IniFileState &state) const;
+	// Report the start and end of the searches of a getValue() step
+	// which went from the state before to state
+	void traceStep(uint8_t before, const IniFileState &state, bool done,
+				   const char* section, const char* key) const;
+	void traceBegin(uint8_t op, const char* name) const;
+	void traceEnd(uint8_t op, error_t err) const;
+	// readLine() without tracing
+	error_t readSourceLine(char *buffer, size_t len, uint32_t &pos) const;
+
 	// True means stop looking, false means not yet found
 	bool findSection(const char* section, char* buffer, size_t len,
 					 IniFileState &state) const;
 	bool findKey(const char* section, const char* key, char* buffer,
 				 size_t len, char** keyptr, IniFileState &state) const;
 
+	// Terminate the line in buffer after it has been read, advancing
+	// pos past the newline. atEnd indicates no data follows the bytes read.
+	static error_t terminateLine(char *buffer, size_t len, size_t bytesRead,
+								 bool atEnd, uint32_t &pos);
+	// Read the next line of a search, recording where it is and
+	// skipping lines which continue a value
+	error_t readNextLine(char *buffer, size_t len, IniFileState &state) const;
+	// Binary search for section in a file with sorted sections,
+	// setting pos to the start of its line
+	error_t findSortedSection(const char* section, char* buffer,
+							  size_t len, uint32_t &pos) const;
+	// Find the first section line which starts at or after pos. On
+	// success name points to its name in buffer, start is where the
+	// line starts and pos is after it.
+	error_t nextSection(char* buffer, size_t len, uint32_t &pos,
+						uint32_t &start, char** name) const;
+	// Compare section names for sorting, taking account of case
+	// sensitivity
+	int compareNames(const char* a, const char* b) const;
+	// Continue a section search from the first checkpoint from n of
+	// the sparse index which may hold section. False if there is none.
+	bool skipToCheckpoint(const char* section, uint16_t n,
+						  IniFileState &state) const;
+	// Replace the value of index entry in buffer with its resolved
+	// value, if interpolation has one
+	void copyResolved(entry_t entry, char* buffer, size_t len) const;
+	// Finish a key found by browseKeys(); pos is the line after it
+	bool readBrowsedValue(char* buffer, size_t len, char** value,
+						  uint32_t pos) const;
+	// Forget anything which depends on the file contents
+	void resetSource(void);
+	// Report key to validation if an earlier key of its section has
+	// the same name, reading the section again
+	error_t checkDuplicateKey(IniValidation &validation, const IniLine &key,
+							  char* buffer, size_t len) const;
+	// Set same if the names of n bytes at a and b in the file match
+	error_t compareNamesAt(uint32_t a, uint32_t b, uint32_t n, char* buffer,
+						   size_t len, bool &same) const;
 
 private:
 	char _filename[INI_FILE_MAX_FILENAME_LEN];
@@ -149,31 +424,32 @@ private:
 	mutable error_t _error;
 	mutable File _file;
 	bool _caseSensitive;
+	bool _sortedSections;
+	uint8_t _syntax;
+	const char* _data;
+	uint32_t _dataLen;
+	memory_t _memType;
+	bool _memoryOpen;
+	IniInflate* _inflate;
+	IniIndex* _index;
+	IniSparseIndex* _sparseIndex;
+	IniBlockCache* _cache;
+	IniInterpolation* _interpolation;
+	IniTrace* _trace;
+	uint32_t _generation;
 };
 
-bool IniFile::open(void)
-{
-	if (_file)
-		_file.close();
-	_file = SD.open(_filename, _mode);
-	if (isOpen()) {
-		_error = errorNoError;
-		return true;
-	}
-	else {
-		_error = errorFileNotFound;
-		return false;
-	}
-}
-
 void IniFile::close(void)
 {
+	_memoryOpen = false;
 	if (_file)
 		_file.close();
 }
 
 bool IniFile::isOpen(void) const
 {
+	if (isMemory())
+		return _memoryOpen;
 	return (_file == true);
 }
 
@@ -197,24 +473,125 @@ const char* IniFile::getFilename(void) const
 	return _filename;
 }
 
+bool IniFile::isMemory(void) const
+{
+	return _data != nullptr;
+}
+
+const char* IniFile::getData(void) const
+{
+	return _data;
+}
+
+uint32_t IniFile::getDataLen(void) const
+{
+	return _dataLen;
+}
+
+IniInflate* IniFile::getInflate(void) const
+{
+	return _inflate;
+}
+
+IniIndex* IniFile::getIndex(void) const
+{
+	return _index;
+}
+
+void IniFile::setSortedSections(bool sorted)
+{
+	_sortedSections = sorted;
+}
+
+bool IniFile::getSortedSections(void) const
+{
+	return _sortedSections;
+}
+
+IniSparseIndex* IniFile::getSparseIndex(void) const
+{
+	return _sparseIndex;
+}
+
+IniBlockCache* IniFile::getCache(void) const
+{
+	return _cache;
+}
+
+uint8_t IniFile::getSyntax(void) const
+{
+	return _syntax;
+}
+
+IniInterpolation* IniFile::getInterpolation(void) const
+{
+	return _interpolation;
+}
+
+void IniFile::setTrace(IniTrace* trace)
+{
+	_trace = trace;
+}
+
+IniTrace* IniFile::getTrace(void) const
+{
+	return _trace;
+}
+
+uint32_t IniFile::getGeneration(void) const
+{
+	return _generation;
+}
+
 
 
 class IniFileState {
 public:
 	IniFileState();
 
+	// Line number (the first line is 1) and position of the last line
+	// read, which is the matching key or section when successful or
+	// the line where the search failed. Zero if not known.
+	inline uint32_t getLineNumber(void) const;
+	inline uint32_t getPosition(void) const;
+
 private:
 	enum {funcUnset = 0,
 		  funcFindSection,
 		  funcFindKey,
+		  funcBrowseKeys,
+		  funcBrowseIndex,
+		  funcBrowseEnd,
 	};
 
 	uint32_t readLinePosition;
+	uint32_t linePosition;
+	uint32_t lineNumber;
+	// Lengths of the section and key wanted, found once per lookup
+	uint16_t sectionLength;
+	uint16_t keyLength;
 	uint8_t getValueState;
+	// IniFile::decodeValue() state of the last line read, for skipping
+	// continuation lines
+	uint8_t valueState;
+	// Sparse index checkpoint being searched for the section
+	uint16_t checkpoint;
+	// False when the search did not start from the beginning
+	bool countLines;
 
 	friend class IniFile;
 };
 
+uint32_t IniFileState::getLineNumber(void) const
+{
+	return lineNumber;
+}
+
+uint32_t IniFileState::getPosition(void) const
+{
+	return linePosition;
+}
+
 
 #endif
 
@@ -0,0 +1,819 @@
+#include "IniImage.h"
+#include "IniTokenizer.h"
+#include "IniWriter.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Layout of the image, all numbers little-endian:
+//
+// Header (headerLen bytes)
+//   0  "INIC"
+//   4  uint8  version
+//   5  uint8  flags, bit 0 set if case sensitive
+//   8  uint32 source length
+//   12 uint32 source checksum
+//   16 uint32 number of slots (entries)
+//   20 uint32 number of buckets
+//   24 uint32 offset of the strings
+//   28 uint32 image length
+// Seeds, one uint32 per bucket
+// Entries (entryLen bytes each)
+//   0  uint32 hash
+//   4  uint32 offset of the strings for the entry
+//   8  uint16 section length, or noSection
+//   10 uint16 key length, or noKey for a section entry
+//   12 uint16 value length
+//   14 uint8  value flags
+//   16 int32  value as a long
+//   20 uint32 value as an unsigned long
+//   24 float  value as a float
+// Strings: for each entry, the section name (if any), key (if any)
+// and value, each terminated by a null character
+//
+// Each section which IniFile can find has an entry so that lookups
+// can tell errorSectionNotFound from errorKeyNotFound.
+
+static const char magic[4] = {'I', 'N', 'I', 'C'};
+static const uint16_t noKey = 0xFFFF;
+
+enum {
+	flagLong = 0x01,
+	flagULong = 0x02,
+	flagFloat = 0x04,
+	flagBool = 0x08,
+	flagTrue = 0x10,
+};
+
+// Compile work flag for slots which are in use
+static const uint8_t slotUsed = 0x01;
+
+static uint32_t get16(const uint8_t* p)
+{
+	return p[0] | (uint16_t(p[1]) << 8);
+}
+
+static uint32_t get32(const uint8_t* p)
+{
+	return p[0] | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) |
+		(uint32_t(p[3]) << 24);
+}
+
+static void put16(uint8_t* p, uint16_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static void put32(uint8_t* p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+// The IniTokenizer hash, folding case unless case sensitive
+static uint32_t hashBytes(uint32_t h, const char* str, size_t len, bool cs)
+{
+	while (len--) {
+		char c = *str++;
+		h = (cs ? IniTokenizer::hashUpdateExact(h, c)
+			 : IniTokenizer::hashUpdate(h, c));
+	}
+	return h;
+}
+
+static uint32_t mix(uint32_t h)
+{
+	h ^= h >> 16;
+	h *= 0x85EBCA6BUL;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35UL;
+	h ^= h >> 16;
+	return h;
+}
+
+static uint16_t bucketFor(uint32_t h, uint32_t numBuckets)
+{
+	return mix(h + 0x9E3779B9UL) % numBuckets;
+}
+
+// Seeds below numSlots displace the slot, so that a bucket with a
+// single key can be put in any free slot. Larger seeds choose a
+// different hash function.
+static uint16_t slotFor(uint32_t h, uint32_t seed, uint32_t numSlots)
+{
+	if (seed < numSlots)
+		return (h % numSlots + seed) % numSlots;
+	return mix(h ^ (seed * 0x9E3779B9UL)) % numSlots;
+}
+
+static bool sameName(const char* a, const char* b, size_t len, bool cs)
+{
+	return (cs ? strncmp(a, b, len) : strncasecmp(a, b, len)) == 0;
+}
+
+// Length of str without trailing whitespace
+static size_t trimmedLen(const char* str, size_t len)
+{
+	while (len && isspace(str[len-1]))
+		--len;
+	return len;
+}
+
+static IniFile::error_t checksum(const IniFile &ini, char* buffer,
+								 size_t len, uint32_t &sum,
+								 uint32_t &sourceLen)
+{
+	sum = IniTokenizer::hashInit;
+	sourceLen = 0;
+	while (true) {
+		size_t bytesRead;
+		IniFile::error_t err = ini.read(sourceLen, buffer, len, bytesRead);
+		if (err == IniFile::errorEndOfFile)
+			return IniFile::errorNoError;
+		if (err != IniFile::errorNoError)
+			return err;
+		for (size_t i = 0; i < bytesRead; ++i)
+			sum = IniTokenizer::hashUpdateExact(sum, buffer[i]);
+		sourceLen += bytesRead;
+	}
+}
+
+// Read the line at pos and find the section name in it
+static IniFile::error_t readSection(const IniFile &ini, uint32_t pos,
+									char* buffer, size_t len, char** name)
+{
+	IniFile::error_t err = ini.readLine(buffer, len, pos);
+	if (err != IniFile::errorNoError && err != IniFile::errorEndOfFile)
+		return err;
+	*name = IniFile::parseSection(IniFile::skipWhiteSpace(buffer));
+	return (*name ? IniFile::errorNoError : IniFile::errorImageError);
+}
+
+// Read the line at pos and split it into key and value
+static IniFile::error_t readKey(const IniFile &ini, uint32_t pos,
+								char* buffer, size_t len, char** key,
+								char** value)
+{
+	IniFile::error_t err = ini.readLine(buffer, len, pos);
+	if (err != IniFile::errorNoError && err != IniFile::errorEndOfFile)
+		return err;
+	*key = IniFile::parseKey(IniFile::skipWhiteSpace(buffer), value);
+	if (*key == NULL)
+		return IniFile::errorImageError;
+	*value = IniFile::skipWhiteSpace(*value);
+	IniFile::removeTrailingWhiteSpace(*value);
+	return IniFile::errorNoError;
+}
+
+// Read enough of the line at pos to get a name of nameLen characters,
+// which may be cut off after it
+static IniFile::error_t readName(const IniFile &ini, uint32_t pos,
+								 char* buffer, size_t len, bool section,
+								 size_t nameLen, char** name)
+{
+	if (len < 3)
+		return IniFile::errorBufferTooSmall;
+	IniFile::error_t err = ini.readLine(buffer, len, pos);
+	if (err != IniFile::errorNoError && err != IniFile::errorEndOfFile &&
+		err != IniFile::errorBufferTooSmall)
+		return err;
+	char* cp = IniFile::skipWhiteSpace(buffer);
+	if (section)
+		cp = IniFile::skipWhiteSpace(cp + 1);
+	if (strlen(cp) < nameLen)
+		return IniFile::errorBufferTooSmall;
+	*name = cp;
+	return IniFile::errorNoError;
+}
+
+// Add a key unless it is already present. Lines of keys with the same
+// hash are read into buffer to compare them.
+static IniFile::error_t addKey(const IniFile &ini, IniImageKey* keys,
+							   uint16_t &numKeys, uint16_t maxKeys,
+							   const IniImageKey &k, const char* key,
+							   char* buffer, size_t len)
+{
+	bool cs = ini.getCaseSensitive();
+	for (uint16_t i = 0; i < numKeys; ++i) {
+		const IniImageKey &e = keys[i];
+		if (e.hash != k.hash || e.keyLen == noKey)
+			continue;
+		// Either the same key again or two with the same hash, which
+		// no perfect hash can separate
+		if (e.keyLen != k.keyLen || e.sectionLen != k.sectionLen ||
+			(k.sectionLen != IniImage::noSection &&
+			 e.sectionPos != k.sectionPos))
+			return IniFile::errorImageError;
+		char* name;
+		IniFile::error_t err = readName(ini, e.keyPos, buffer, len, false,
+										k.keyLen, &name);
+		if (err != IniFile::errorNoError)
+			return err;
+		if (!sameName(name, key, k.keyLen, cs))
+			return IniFile::errorImageError;
+		return IniFile::errorNoError; // Only the first can be found
+	}
+	if (numKeys >= maxKeys)
+		return IniFile::errorBufferTooSmall;
+	keys[numKeys++] = k;
+	return IniFile::errorNoError;
+}
+
+static int compareBuckets(const void* a, const void* b)
+{
+	const IniImageKey* ka = (const IniImageKey*)a;
+	const IniImageKey* kb = (const IniImageKey*)b;
+	if (ka->bucketSize != kb->bucketSize)
+		return (ka->bucketSize > kb->bucketSize ? -1 : 1);
+	return int(ka->bucket) - int(kb->bucket);
+}
+
+// Find a seed for each bucket which puts all of its keys in free
+// slots, largest buckets first. numSlots equals numKeys.
+static IniFile::error_t findSeeds(IniImageKey* keys, uint16_t numKeys,
+								  uint16_t numBuckets)
+{
+	uint32_t m = numKeys;
+	for (uint16_t i = 0; i < numBuckets; ++i)
+		keys[i].seed = 0;
+	for (uint16_t i = 0; i < numKeys; ++i) {
+		keys[i].bucket = bucketFor(keys[i].hash, numBuckets);
+		++keys[keys[i].bucket].seed;
+		keys[i].flags = 0;
+	}
+	for (uint16_t i = 0; i < numKeys; ++i)
+		keys[i].bucketSize = keys[keys[i].bucket].seed;
+	qsort(keys, numKeys, sizeof(IniImageKey), compareBuckets);
+	for (uint16_t i = 0; i < numBuckets; ++i)
+		keys[i].seed = 0;
+
+	uint16_t nextFree = 0;
+	for (uint16_t start = 0; start < numKeys; ) {
+		uint16_t end = start + 1;
+		while (end < numKeys && keys[end].bucket == keys[start].bucket)
+			++end;
+
+		uint32_t seed = 0;
+		if (end - start == 1) {
+			// A single key can go straight into the next free slot
+			while (keys[nextFree].flags & slotUsed)
+				++nextFree;
+			seed = (nextFree + m - keys[start].hash % m) % m;
+			keys[start].slot = nextFree;
+		}
+		else {
+			const uint32_t maxSeed = m + 0xFFFFFFUL;
+			for (seed = m; seed < maxSeed; ++seed) {
+				uint16_t i = start;
+				for (; i < end; ++i) {
+					uint16_t slot = slotFor(keys[i].hash, seed, m);
+					if (keys[slot].flags & slotUsed)
+						break;
+					uint16_t j = start;
+					while (j < i && keys[j].slot != slot)
+						++j;
+					if (j < i)
+						break;
+					keys[i].slot = slot;
+				}
+				if (i == end)
+					break;
+			}
+			if (seed == maxSeed)
+				return IniFile::errorImageError;
+		}
+
+		for (uint16_t i = start; i < end; ++i)
+			keys[keys[i].slot].flags |= slotUsed;
+		keys[keys[start].bucket].seed = seed;
+		start = end;
+	}
+
+	// Put the keys in slot order. The seeds belong to the bucket
+	// numbers, not the keys, so stay where they are.
+	for (uint16_t i = 0; i < numKeys; ++i)
+		while (keys[i].slot != i) {
+			IniImageKey &other = keys[keys[i].slot];
+			IniImageKey tmp = keys[i];
+			keys[i] = other;
+			other = tmp;
+			uint32_t seed = keys[i].seed;
+			keys[i].seed = other.seed;
+			other.seed = seed;
+		}
+	return IniFile::errorNoError;
+}
+
+static uint32_t stringsLen(const IniImageKey &k)
+{
+	uint32_t n = 0;
+	if (k.sectionLen != IniImage::noSection)
+		n += k.sectionLen + 1;
+	if (k.keyLen != noKey)
+		n += k.keyLen + k.valueLen + 2;
+	return n;
+}
+
+IniImage::IniImage(const IniFile &image) : _image(image)
+{
+	_open = false;
+	_caseSensitive = false;
+	_sourceLen = 0;
+	_sourceChecksum = 0;
+	_numSlots = 0;
+	_numBuckets = 0;
+	_error = IniFile::errorNoError;
+}
+
+bool IniImage::open(void)
+{
+	uint8_t header[headerLen];
+	_open = false;
+	_error = readBytes(0, header, headerLen);
+	if (_error != IniFile::errorNoError)
+		return false;
+	if (memcmp(header, magic, sizeof(magic)) != 0 || header[4] != version) {
+		_error = IniFile::errorImageError;
+		return false;
+	}
+	_caseSensitive = header[5] & 1;
+	_sourceLen = get32(header + 8);
+	_sourceChecksum = get32(header + 12);
+	_numSlots = get32(header + 16);
+	_numBuckets = get32(header + 20);
+	_open = true;
+	_error = IniFile::errorNoError;
+	return true;
+}
+
+bool IniImage::isCurrent(const IniFile &source, char* buffer,
+						 size_t len) const
+{
+	if (!_open)
+		return false;
+	uint32_t sum, sourceLen;
+	_error = checksum(source, buffer, len, sum, sourceLen);
+	return _error == IniFile::errorNoError && sourceLen == _sourceLen &&
+		sum == _sourceChecksum;
+}
+
+IniFile::error_t IniImage::compile(const IniFile &source, IniWriter &writer,
+								   char* buffer, size_t len,
+								   IniImageKey* keys, uint16_t maxKeys)
+{
+	if (source.getSyntax())
+		return IniFile::errorImageError;
+	bool cs = source.getCaseSensitive();
+	uint32_t sum, sourceLen;
+	IniFile::error_t err = checksum(source, buffer, len, sum, sourceLen);
+	if (err != IniFile::errorNoError)
+		return err;
+	if (maxKeys == 0xFFFF)
+		--maxKeys; // Slot numbers must fit in a uint16_t
+
+	// Find every section and key that IniFile::getValue() could find,
+	// with the same rules as IniFile::findSection() and findKey()
+	uint16_t numKeys = 0;
+	bool inSection = false;
+	IniImageKey section;
+	uint32_t sectionHash = 0;
+	uint32_t pos = 0;
+	bool atEnd = false;
+	while (!atEnd) {
+		uint32_t linePos = pos;
+		err = source.readLine(buffer, len, pos);
+		if (err != IniFile::errorNoError && err != IniFile::errorEndOfFile)
+			return err;
+		atEnd = (err == IniFile::errorEndOfFile);
+
+		// Lines already found are compared in the rest of the buffer
+		size_t used = strlen(buffer) + 1;
+		char* spare = buffer + used;
+		size_t spareLen = len - used;
+		if (used > noKey)
+			return IniFile::errorBufferTooSmall;
+
+		char* cp = IniFile::skipWhiteSpace(buffer);
+		if (IniFile::isCommentChar(*cp))
+			continue;
+
+		char* ep = strchr(cp, '=');
+		size_t keyLen = (ep ? trimmedLen(cp, ep - cp) : 0);
+		if (keyLen) {
+			IniImageKey k;
+			char* vp = IniFile::skipWhiteSpace(ep + 1);
+			k.keyPos = linePos;
+			k.keyLen = keyLen;
+			k.valueLen = trimmedLen(vp, strlen(vp));
+			// Any key can be found when no section is given
+			k.hash = hashBytes(IniTokenizer::hashUpdateExact(
+						   IniTokenizer::hashInit, 1), cp, keyLen, cs);
+			k.sectionPos = 0;
+			k.sectionLen = noSection;
+			err = addKey(source, keys, numKeys, maxKeys, k, cp,
+						 spare, spareLen);
+			if (err != IniFile::errorNoError)
+				return err;
+			if (inSection && *cp != '[') {
+				k.hash = hashBytes(sectionHash, cp, keyLen, cs);
+				k.sectionPos = section.sectionPos;
+				k.sectionLen = section.sectionLen;
+				err = addKey(source, keys, numKeys, maxKeys, k, cp,
+							 spare, spareLen);
+				if (err != IniFile::errorNoError)
+					return err;
+			}
+		}
+
+		if (*cp != '[')
+			continue;
+		// Any line starting with '[' ends the section, but only the
+		// first section of each name can be found
+		inSection = false;
+		char* np = IniFile::skipWhiteSpace(cp + 1);
+		ep = strchr(np, ']');
+		if (ep == NULL)
+			continue;
+		section.sectionPos = linePos;
+		section.sectionLen = trimmedLen(np, ep - np);
+		section.keyPos = 0;
+		section.keyLen = noKey;
+		section.valueLen = 0;
+		sectionHash = hashBytes(IniTokenizer::hashInit, np,
+					section.sectionLen, cs);
+		sectionHash = IniTokenizer::hashUpdateExact(sectionHash, 0);
+		section.hash = IniTokenizer::hashUpdateExact(sectionHash, 2);
+		bool first = true;
+		for (uint16_t i = 0; first && i < numKeys; ++i) {
+			const IniImageKey &e = keys[i];
+			if (e.hash != section.hash || e.keyLen != noKey)
+				continue;
+			if (e.sectionLen != section.sectionLen)
+				return IniFile::errorImageError;
+			char* name;
+			err = readName(source, e.sectionPos, spare, spareLen, true,
+						   e.sectionLen, &name);
+			if (err != IniFile::errorNoError)
+				return err;
+			if (!sameName(name, np, section.sectionLen, cs))
+				return IniFile::errorImageError;
+			first = false;
+		}
+		if (first) {
+			if (numKeys >= maxKeys)
+				return IniFile::errorBufferTooSmall;
+			keys[numKeys++] = section;
+			inSection = true;
+		}
+	}
+
+	uint16_t numBuckets = (numKeys + 3) / 4;
+	if (numKeys) {
+		err = findSeeds(keys, numKeys, numBuckets);
+		if (err != IniFile::errorNoError)
+			return err;
+	}
+
+	uint8_t header[headerLen];
+	memset(header, 0, headerLen);
+	memcpy(header, magic, sizeof(magic));
+	header[4] = version;
+	header[5] = (cs ? 1 : 0);
+	put32(header + 8, sourceLen);
+	put32(header + 12, sum);
+	put32(header + 16, numKeys);
+	put32(header + 20, numBuckets);
+	uint32_t offset = headerLen + 4UL * numBuckets +
+		uint32_t(entryLen) * numKeys;
+	put32(header + 24, offset);
+	uint32_t imageLen = offset;
+	for (uint16_t i = 0; i < numKeys; ++i)
+		imageLen += stringsLen(keys[i]);
+	put32(header + 28, imageLen);
+	writer.write((const char*)header, headerLen);
+
+	for (uint16_t i = 0; i < numBuckets; ++i) {
+		uint8_t seed[4];
+		put32(seed, keys[i].seed);
+		writer.write((const char*)seed, 4);
+	}
+
+	for (uint16_t i = 0; i < numKeys; ++i) {
+		const IniImageKey &k = keys[i];
+		uint8_t entry[entryLen];
+		memset(entry, 0, entryLen);
+		put32(entry, k.hash);
+		put32(entry + 4, offset);
+		put16(entry + 8, k.sectionLen);
+		put16(entry + 10, k.keyLen);
+		put16(entry + 12, k.valueLen);
+		offset += stringsLen(k);
+
+		if (k.keyLen != noKey) {
+			// Convert the value now so lookups need not
+			char* kp;
+			char* vp;
+			err = readKey(source, k.keyPos, buffer, len, &kp, &vp);
+			if (err != IniFile::errorNoError)
+				return err;
+			uint8_t flags = 0;
+			long l = atol(vp);
+			if (l >= -2147483647L - 1 && l <= 2147483647L) {
+				flags |= flagLong;
+				put32(entry + 16, uint32_t(l));
+			}
+			unsigned long ul;
+			if (IniFile::parseUnsignedLong(vp, ul) && ul <= 0xFFFFFFFFUL) {
+				flags |= flagULong;
+				put32(entry + 20, ul);
+			}
+			float f;
+			if (IniFile::parseFloat(vp, f)) {
+				uint32_t bits;
+				memcpy(&bits, &f, 4);
+				flags |= flagFloat;
+				put32(entry + 24, bits);
+			}
+			bool b;
+			if (IniFile::parseBool(vp, b))
+				flags |= flagBool | (b ? flagTrue : 0);
+			entry[14] = flags;
+		}
+		writer.write((const char*)entry, entryLen);
+	}
+
+	for (uint16_t i = 0; i < numKeys; ++i) {
+		const IniImageKey &k = keys[i];
+		if (k.sectionLen != noSection) {
+			char* name;
+			err = readSection(source, k.sectionPos, buffer, len, &name);
+			if (err != IniFile::errorNoError)
+				return err;
+			writer.write(name, k.sectionLen + 1);
+		}
+		if (k.keyLen != noKey) {
+			char* kp;
+			char* vp;
+			err = readKey(source, k.keyPos, buffer, len, &kp, &vp);
+			if (err != IniFile::errorNoError)
+				return err;
+			writer.write(kp, k.keyLen + 1);
+			writer.write(vp, k.valueLen + 1);
+		}
+	}
+
+	writer.flush();
+	return writer.getError();
+}
+
+uint32_t IniImage::hash(const char* section, const char* key,
+						bool caseSensitive)
+{
+	uint32_t h = IniTokenizer::hashInit;
+	if (section)
+		h = IniTokenizer::hashUpdateExact(
+			hashBytes(h, section, strlen(section), caseSensitive), 0);
+	else
+		h = IniTokenizer::hashUpdateExact(h, 1);
+	if (key)
+		h = hashBytes(h, key, strlen(key), caseSensitive);
+	else
+		h = IniTokenizer::hashUpdateExact(h, 2);
+	return h;
+}
+
+IniFile::error_t IniImage::readBytes(uint32_t pos, void* buffer,
+									 size_t len) const
+{
+	char* cp = (char*)buffer;
+	while (len) {
+		size_t bytesRead;
+		IniFile::error_t err = _image.read(pos, cp, len, bytesRead);
+		if (err == IniFile::errorEndOfFile)
+			return IniFile::errorImageError; // Truncated
+		if (err != IniFile::errorNoError)
+			return err;
+		pos += bytesRead;
+		cp += bytesRead;
+		len -= bytesRead;
+	}
+	return IniFile::errorNoError;
+}
+
+// Find the entry for section and key, where key may be NULL to find a
+// section. On success buffer holds the value.
+IniFile::error_t IniImage::lookup(const char* section, const char* key,
+								  char* buffer, size_t len,
+								  uint8_t* entry) const
+{
+	if (!_open)
+		return IniFile::errorFileNotOpen;
+	if (_numSlots == 0)
+		return IniFile::errorKeyNotFound;
+
+	uint32_t h = hash(section, key, _caseSensitive);
+	uint8_t seed[4];
+	IniFile::error_t err = readBytes(headerLen + 4UL * bucketFor(h, _numBuckets),
+									 seed, 4);
+	if (err != IniFile::errorNoError)
+		return err;
+	uint16_t slot = slotFor(h, get32(seed), _numSlots);
+	err = readBytes(headerLen + 4UL * _numBuckets + uint32_t(entryLen) * slot,
+					entry, entryLen);
+	if (err != IniFile::errorNoError)
+		return err;
+	uint16_t sectionLen = get16(entry + 8);
+	uint16_t keyLen = get16(entry + 10);
+	uint16_t valueLen = get16(entry + 12);
+	if (get32(entry) != h || (section == NULL) != (sectionLen == noSection) ||
+		(key == NULL) != (keyLen == noKey))
+		return IniFile::errorKeyNotFound;
+
+	// Check the names, since any other name could have the same hash
+	IniImageKey k;
+	k.sectionLen = sectionLen;
+	k.keyLen = keyLen;
+	k.valueLen = valueLen;
+	uint32_t n = stringsLen(k);
+	if (n > len)
+		return IniFile::errorBufferTooSmall;
+	err = readBytes(get32(entry + 4), buffer, n);
+	if (err != IniFile::errorNoError)
+		return err;
+	char* cp = buffer;
+	if (section) {
+		if ((_caseSensitive ? strcmp(cp, section)
+			 : strcasecmp(cp, section)) != 0)
+			return IniFile::errorKeyNotFound;
+		cp += sectionLen + 1;
+	}
+	if (key) {
+		if ((_caseSensitive ? strcmp(cp, key) : strcasecmp(cp, key)) != 0)
+			return IniFile::errorKeyNotFound;
+		cp += keyLen + 1;
+		memmove(buffer, cp, valueLen + 1);
+	}
+	return IniFile::errorNoError;
+}
+
+// As lookup() but with the errors IniFile would give
+bool IniImage::find(const char* section, const char* key,
+					char* buffer, size_t len, uint8_t* entry) const
+{
+	IniFile::error_t err = IniFile::errorKeyNotFound;
+	if (key != NULL && *key != '\0')
+		err = lookup(section, key, buffer, len, entry);
+	if (err == IniFile::errorKeyNotFound && section != NULL &&
+		lookup(section, NULL, buffer, len, entry) == IniFile::errorKeyNotFound)
+		err = IniFile::errorSectionNotFound;
+	_error = err;
+	return err == IniFile::errorNoError;
+}
+
+bool IniImage::getValue(const char* section, const char* key,
+						char* buffer, size_t len) const
+{
+	uint8_t entry[entryLen];
+	return find(section, key, buffer, len, entry);
+}
+
+bool IniImage::getValue(const char* section, const char* key,
+						char* buffer, size_t len,
+						char *value, size_t vlen) const
+{
+	if (!getValue(section, key, buffer, len))
+		return false; // error
+	if (strlen(buffer) >= vlen)
+		return false;
+	strcpy(value, buffer);
+	return true;
+}
+
+bool IniImage::getValue(const char* section, const char* key,
+						char* buffer, size_t len, bool& val) const
+{
+	uint8_t entry[entryLen];
+	if (!find(section, key, buffer, len, entry) || !(entry[14] & flagBool))
+		return false;
+	val = entry[14] & flagTrue;
+	return true;
+}
+
+bool IniImage::getValue(const char* section, const char* key,
+						char* buffer, size_t len, int& val) const
+{
+	uint8_t entry[entryLen];
+	if (!find(section, key, buffer, len, entry))
+		return false;
+	val = (entry[14] & flagLong ? int(int32_t(get32(entry + 16)))
+		   : atoi(buffer));
+	return true;
+}
+
+bool IniImage::getValue(const char* section, const char* key,
+						char* buffer, size_t len, double& val) const
+{
+	// Only a float is stored, which would lose precision
+	if (!getValue(section, key, buffer, len))
+		return false;
+	val = atof(buffer);
+	return true;
+}
+
+bool IniImage::getValue(const char* section, const char* key,
+						char* buffer, size_t len, uint8_t& val) const
+{
+	uint8_t entry[entryLen];
+	long longval;
+	if (!find(section, key, buffer, len, entry) ||
+		!IniFile::parseLong(buffer, longval) || longval < 0 ||
+		longval > 0xFF)
+		return false;
+	val = uint8_t(longval);
+	return true;
+}
+
+bool IniImage::getValue(const char* section, const char* key,
+						char* buffer, size_t len, uint16_t& val) const
+{
+	uint8_t entry[entryLen];
+	long longval;
+	if (!find(section, key, buffer, len, entry) ||
+		!IniFile::parseLong(buffer, longval) || longval < 0 ||
+		longval > 0xFFFF)
+		return false;
+	val = uint16_t(longval);
+	return true;
+}
+
+bool IniImage::getValue(const char* section, const char* key,
+						char* buffer, size_t len, long& val) const
+{
+	uint8_t entry[entryLen];
+	if (!find(section, key, buffer, len, entry))
+		return false;
+	val = (entry[14] & flagLong ? long(int32_t(get32(entry + 16)))
+		   : atol(buffer));
+	return true;
+}
+
+bool IniImage::getValue(const char* section, const char* key,
+						char* buffer, size_t len, unsigned long& val) const
+{
+	uint8_t entry[entryLen];
+	if (!find(section, key, buffer, len, entry))
+		return false;
+	if (!(entry[14] & flagULong))
+		return IniFile::parseUnsignedLong(buffer, val);
+	val = get32(entry + 20);
+	return true;
+}
+
+bool IniImage::getValue(const char* section, const char* key,
+						char* buffer, size_t len, float& val) const
+{
+	uint8_t entry[entryLen];
+	if (!find(section, key, buffer, len, entry) || !(entry[14] & flagFloat))
+		return false;
+	uint32_t bits = get32(entry + 24);
+	memcpy(&val, &bits, 4);
+	return true;
+}
+
+bool IniImage::getIPAddress(const char* section, const char* key,
+							char* buffer, size_t len, uint8_t* ip) const
+{
+	// Need 16 chars minimum: 4 * 3 digits, 3 dots and a null character
+	if (len < 16)
+		return false;
+	if (!getValue(section, key, buffer, len))
+		return false;
+	return IniFile::parseIPAddress(buffer, ip);
+}
+
+#if defined(ARDUINO) && ARDUINO >= 100
+bool IniImage::getIPAddress(const char* section, const char* key,
+							char* buffer, size_t len, IPAddress& ip) const
+{
+	uint8_t a[4];
+	bool r = getIPAddress(section, key, buffer, len, a);
+	if (r)
+		ip = IPAddress(a[0], a[1], a[2], a[3]);
+	return r;
+}
+#endif
+
+bool IniImage::getMACAddress(const char* section, const char* key,
+							 char* buffer, size_t len, uint8_t mac[6]) const
+{
+	// Need 18 chars: 6 * 2 hex digits, 5 : or - and a null char
+	if (len < 18)
+		return false;
+	if (!getValue(section, key, buffer, len))
+		return false;
+	return IniFile::parseMACAddress(buffer, mac);
+}
@@ -0,0 +1,151 @@
+#ifndef _INIIMAGE_H
+#define _INIIMAGE_H
+
+#include "IniFile.h"
+
+class IniWriter;
+
+// Working space for IniImage::compile(), one per section and key
+// line of the source file. The contents are only of use to compile().
+struct IniImageKey {
+	uint32_t hash;
+	uint32_t keyPos;     // Start of the key line in the source
+	uint32_t sectionPos; // Start of the section line in the source
+	uint32_t seed;       // Seed of the bucket with the same number
+	uint16_t slot;
+	uint16_t bucket;
+	uint16_t bucketSize;
+	uint16_t sectionLen; // IniImage::noSection if found with no section
+	uint16_t keyLen;
+	uint16_t valueLen;
+	uint8_t flags;
+};
+
+// A compiled form of an ini file, for devices which read their
+// configuration far more often than it changes. Every value which can
+// be found by IniFile::getValue() is stored in a table addressed by a
+// perfect hash of its section and key, along with its value already
+// converted to long, unsigned long, float and bool where possible. A
+// lookup reads three small pieces of the image, wherever the key is,
+// and does not parse any text. The image records the length and a
+// checksum of the source so that it can be compiled again when the
+// source changes. The image is read through an IniFile, so it may be a
+// file or held in memory (including PROGMEM).
+class IniImage {
+public:
+	// Section length of a key which is found with a NULL section
+	static const uint16_t noSection = 0xFFFF;
+
+	IniImage(const IniFile &image);
+
+	// Read and check the header of the image. Returns false with
+	// errorImageError if it is not a valid image.
+	bool open(void);
+	inline bool isOpen(void) const;
+
+	// True if the image was compiled from source as it is now. The
+	// source is read in blocks of len bytes.
+	bool isCurrent(const IniFile &source, char* buffer, size_t len) const;
+
+	// Compile source into an image written with writer, which is
+	// flushed at the end. buffer must hold any line of the source and,
+	// where a name is repeated, the earlier name as well. keys needs
+	// one element for every section and key line. Returns
+	// errorBufferTooSmall if there are too many, or errorImageError in
+	// the very unlikely case that no perfect hash can be found. Images
+	// hold values as written, so a source with a syntax set by
+	// IniFile::setSyntax() also gives errorImageError.
+	static IniFile::error_t compile(const IniFile &source, IniWriter &writer,
+									char* buffer, size_t len,
+									IniImageKey* keys, uint16_t maxKeys);
+
+	inline IniFile::error_t getError(void) const;
+	inline void clearError(void) const;
+	inline bool getCaseSensitive(void) const;
+	// Number of values in the image
+	inline uint16_t getNumEntries(void) const;
+
+	// As the IniFile functions of the same names. buffer must hold the
+	// section name, key and value.
+	bool getValue(const char* section, const char* key,
+				  char* buffer, size_t len) const;
+	bool getValue(const char* section, const char* key,
+				  char* buffer, size_t len, char *value, size_t vlen) const;
+	bool getValue(const char* section, const char* key,
+				  char* buffer, size_t len, bool& b) const;
+	bool getValue(const char* section, const char* key,
+				  char* buffer, size_t len, int& val) const;
+	bool getValue(const char* section, const char* key,
+				  char* buffer, size_t len, double& val) const;
+	bool getValue(const char* section, const char* key,
+				  char* buffer, size_t len, uint8_t& val) const;
+	bool getValue(const char* section, const char* key,
+				  char* buffer, size_t len, uint16_t& val) const;
+	bool getValue(const char* section, const char* key,
+				  char* buffer, size_t len, long& val) const;
+	bool getValue(const char* section, const char* key,
+				  char* buffer, size_t len, unsigned long& val) const;
+	bool getValue(const char* section, const char* key,
+				  char* buffer, size_t len, float& val) const;
+	bool getIPAddress(const char* section, const char* key,
+					  char* buffer, size_t len, uint8_t* ip) const;
+#if defined(ARDUINO) && ARDUINO >= 100
+	bool getIPAddress(const char* section, const char* key,
+					  char* buffer, size_t len, IPAddress& ip) const;
+#endif
+	bool getMACAddress(const char* section, const char* key,
+					   char* buffer, size_t len, uint8_t mac[6]) const;
+
+	// Hash of a section (which may be NULL) and key
+	static uint32_t hash(const char* section, const char* key,
+						 bool caseSensitive);
+
+private:
+	enum {
+		headerLen = 32,
+		entryLen = 28,
+		version = 1,
+	};
+
+	bool find(const char* section, const char* key,
+			  char* buffer, size_t len, uint8_t* entry) const;
+	IniFile::error_t lookup(const char* section, const char* key,
+							char* buffer, size_t len, uint8_t* entry) const;
+	IniFile::error_t readBytes(uint32_t pos, void* buffer, size_t len) const;
+
+	const IniFile &_image;
+	bool _open;
+	bool _caseSensitive;
+	uint32_t _sourceLen;
+	uint32_t _sourceChecksum;
+	uint32_t _numSlots;
+	uint32_t _numBuckets;
+	mutable IniFile::error_t _error;
+};
+
+bool IniImage::isOpen(void) const
+{
+	return _open;
+}
+
+IniFile::error_t IniImage::getError(void) const
+{
+	return _error;
+}
+
+void IniImage::clearError(void) const
+{
+	_error = IniFile::errorNoError;
+}
+
+bool IniImage::getCaseSensitive(void) const
+{
+	return _caseSensitive;
+}
+
+uint16_t IniImage::getNumEntries(void) const
+{
+	return _numSlots;
+}
+
+#endif
@@ -0,0 +1,665 @@
+#include "IniIndex.h"
+
+#include <string.h>
+
+#if defined(INIFILE_HOST)
+#include <thread>
+#include <vector>
+#endif
+
+IniIndex::IniIndex(IniIndexEntry* entries, entry_t maxEntries)
+{
+	_entries = entries;
+	_maxEntries = (entries == nullptr ? 0 : maxEntries);
+	// Entry numbers must stay below noSection
+	if (_maxEntries == noSection)
+		--_maxEntries;
+	clear();
+}
+
+IniFile::error_t IniIndex::build(const IniFile &ini, char* buffer, size_t len)
+{
+	clear();
+	IniTokenizer tokenizer;
+	tokenizer.setSyntax(ini.getSyntax());
+	entry_t section = noSection;
+	uint32_t pos = 0;
+	while (true) {
+		size_t bytesRead;
+		IniFile::error_t err = ini.read(pos, buffer, len, bytesRead);
+		if (err == IniFile::errorEndOfFile)
+			break;
+		if (err != IniFile::errorNoError)
+			return err;
+		pos += bytesRead;
+
+		const char* cp = buffer;
+		while (bytesRead) {
+			size_t used = tokenizer.scan(cp, bytesRead);
+			cp += used;
+			bytesRead -= used;
+			if (tokenizer.lineReady() && !add(tokenizer.getLine(), section))
+				return IniFile::errorBufferTooSmall;
+		}
+	}
+	tokenizer.finish();
+	if (tokenizer.lineReady() && !add(tokenizer.getLine(), section))
+		return IniFile::errorBufferTooSmall;
+
+	_valid = true;
+	return IniFile::errorNoError;
+}
+
+void IniIndex::clear(void)
+{
+	_numEntries = 0;
+	_valid = false;
+	_order = nullptr;
+	_sortedCaseSensitive = false;
+	_slots = nullptr;
+	_numSlots = 0;
+}
+
+IniFile::error_t IniIndex::sort(const IniFile &ini, char* buffer, size_t len,
+								entry_t* order)
+{
+	_order = nullptr;
+	for (entry_t i = 0; i < _numEntries; ++i)
+		order[i] = i;
+
+	// Heap sort each run of keys, since it needs no extra memory.
+	// Sections stay where they are.
+	entry_t start = 0;
+	while (start < _numEntries) {
+		if (_entries[start].type != IniLine::typeKey) {
+			++start;
+			continue;
+		}
+		entry_t end = start;
+		while (end < _numEntries && _entries[end].type == IniLine::typeKey)
+			++end;
+
+		entry_t* heap = order + start;
+		entry_t n = end - start;
+		IniFile::error_t err;
+		for (entry_t i = n / 2; i > 0; --i) {
+			err = siftDown(ini, heap, i - 1, n, buffer, len);
+			if (err != IniFile::errorNoError)
+				return err;
+		}
+		for (entry_t i = n - 1; i > 0; --i) {
+			entry_t tmp = heap[0];
+			heap[0] = heap[i];
+			heap[i] = tmp;
+			err = siftDown(ini, heap, 0, i, buffer, len);
+			if (err != IniFile::errorNoError)
+				return err;
+		}
+		start = end;
+	}
+	_order = order;
+	_sortedCaseSensitive = ini.getCaseSensitive();
+	return IniFile::errorNoError;
+}
+
+IniFile::error_t IniIndex::findKey(const IniFile &ini, const char* section,
+								   const char* key, char* buffer, size_t len,
+								   entry_t &entry, char** value) const
+{
+	entry_t n = 0;
+	if (section != NULL) {
+		IniFile::error_t err = findSection(ini, section, buffer, len, n);
+		if (err != IniFile::errorNoError)
+			return err;
+		++n;
+	}
+
+	if (key == NULL)
+		return IniFile::errorKeyNotFound;
+	return findKeyFrom(ini, n, section != NULL, IniKey(key), buffer, len,
+					   entry, value, NULL);
+}
+
+IniFile::error_t IniIndex::findKey(const IniFile &ini, entry_t section,
+								   const char* key, char* buffer, size_t len,
+								   entry_t &entry, char** value) const
+{
+	entry_t n = (section == noSection ? 0 : section + 1);
+	if (key == NULL)
+		return IniFile::errorKeyNotFound;
+	return findKeyFrom(ini, n, true, IniKey(key), buffer, len, entry, value,
+					   NULL);
+}
+
+// Search from entry n, to the end of the section if inSection or else
+// to the end of the file. If next is not NULL it is set to the position
+// of the line after the key.
+IniFile::error_t IniIndex::findKeyFrom(const IniFile &ini, entry_t n,
+									   bool inSection, const IniKey &key,
+									   char* buffer, size_t len,
+									   entry_t &entry, char** value,
+									   uint32_t* next) const
+{
+	if (key.getLength() == 0)
+		return IniFile::errorKeyNotFound;
+	for (; n < _numEntries; ++n) {
+		const IniIndexEntry &e = _entries[n];
+		if (e.type != IniLine::typeKey) {
+			if (inSection)
+				break; // End of the section
+			continue;
+		}
+		if (e.hash != key.getHash())
+			continue;
+
+		IniFile::error_t err;
+		if (matchKey(ini, n, key, buffer, len, value, next, err)) {
+			entry = n;
+			return IniFile::errorNoError;
+		}
+		if (err != IniFile::errorNoError)
+			return err;
+	}
+	return IniFile::errorKeyNotFound;
+}
+
+// Look for key in section through the hash table. Candidates with the
+// same hashes are found in entry order, as by findKeyFrom().
+IniFile::error_t IniIndex::probe(const IniFile &ini, const IniKey &section,
+								 const IniKey &key, char* buffer, size_t len,
+								 entry_t &entry, char** value,
+								 uint32_t* next) const
+{
+	IniFile::error_t err;
+	entry_t i = slotHash(section.getHash(), key.getHash()) % _numSlots;
+	for (; _slots[i] != noSection; i = (i + 1) % _numSlots) {
+		entry_t n = _slots[i];
+		const IniIndexEntry &e = _entries[n];
+		if (e.hash != key.getHash() ||
+			_entries[e.section].hash != section.getHash())
+			continue;
+		if (!matchSection(ini, e.section, section.getName(),
+						  section.getLength(), buffer, len, err)) {
+			if (err != IniFile::errorNoError)
+				return err;
+			continue;
+		}
+		if (matchKey(ini, n, key, buffer, len, value, next, err)) {
+			entry = n;
+			return IniFile::errorNoError;
+		}
+		if (err != IniFile::errorNoError)
+			return err;
+	}
+
+	// Not in the table, so find out which of the names is missing
+	entry_t s;
+	err = findSection(ini, section, buffer, len, s);
+	return (err == IniFile::errorNoError ? IniFile::errorKeyNotFound : err);
+}
+
+IniFile::error_t IniIndex::findSection(const IniFile &ini, const char* section,
+									   char* buffer, size_t len,
+									   entry_t &entry) const
+{
+	return findSection(ini, IniKey(section), buffer, len, entry);
+}
+
+IniFile::error_t IniIndex::findSection(const IniFile &ini,
+									   const IniKey &section,
+									   char* buffer, size_t len,
+									   entry_t &entry) const
+{
+	// Only the first section with a matching name is used
+	IniFile::error_t err = IniFile::errorNoError;
+	for (entry_t n = 0; n < _numEntries; ++n) {
+		const IniIndexEntry &e = _entries[n];
+		if (e.type == IniLine::typeSection && e.hash == section.getHash() &&
+			matchSection(ini, n, section.getName(), section.getLength(),
+						 buffer, len, err)) {
+			entry = n;
+			return IniFile::errorNoError;
+		}
+		if (err != IniFile::errorNoError)
+			return err;
+	}
+	return IniFile::errorSectionNotFound;
+}
+
+IniFile::error_t IniIndex::buildHashTable(const IniFile &ini, char* buffer,
+										  size_t len, entry_t* slots,
+										  entry_t numSlots)
+{
+	_slots = nullptr;
+	entry_t numKeys = 0;
+	for (entry_t n = 0; n < _numEntries; ++n)
+		if (_entries[n].type == IniLine::typeKey)
+			++numKeys;
+	// There must always be an empty slot to end a probe
+	if (numKeys >= numSlots)
+		return IniFile::errorBufferTooSmall;
+	for (entry_t i = 0; i < numSlots; ++i)
+		slots[i] = noSection;
+
+	len /= 2;
+	char* other = buffer + len;
+	bool reachable = false; // Whether keys of this section can be found
+	for (entry_t n = 0; n < _numEntries; ++n) {
+		const IniIndexEntry &e = _entries[n];
+		if (e.type == IniLine::typeBadSection) {
+			reachable = false;
+			continue;
+		}
+		if (e.type == IniLine::typeSection) {
+			// Only the first section of each name can be found. Names
+			// are only read when an earlier section has the same hash.
+			reachable = true;
+			char* name = NULL;
+			for (entry_t m = 0; m < n && reachable; ++m) {
+				if (_entries[m].type != IniLine::typeSection ||
+					_entries[m].hash != e.hash)
+					continue;
+				IniFile::error_t err;
+				if (name == NULL) {
+					uint32_t pos = e.position;
+					err = ini.readLine(buffer, len, pos);
+					if (err != IniFile::errorNoError &&
+						err != IniFile::errorEndOfFile)
+						return err;
+					name = IniFile::parseSection(
+						IniFile::skipWhiteSpace(buffer));
+					if (name == NULL)
+						return IniFile::errorUnknownError;
+				}
+				if (matchSection(ini, m, name, strlen(name), other, len, err))
+					reachable = false;
+				else if (err != IniFile::errorNoError)
+					return err;
+			}
+			continue;
+		}
+		if (e.type != IniLine::typeKey || !reachable)
+			continue;
+		entry_t i = slotHash(_entries[e.section].hash, e.hash) % numSlots;
+		while (slots[i] != noSection)
+			i = (i + 1) % numSlots;
+		slots[i] = n;
+	}
+	_slots = slots;
+	_numSlots = numSlots;
+	return IniFile::errorNoError;
+}
+
+IniFile::error_t IniIndex::findPrefix(const IniFile &ini, const char* section,
+									  const char* prefix, size_t prefixLen,
+									  char* buffer, size_t len,
+									  entry_t &n) const
+{
+	entry_t first = 0;
+	if (section != NULL) {
+		IniFile::error_t err = findSection(ini, section, buffer, len, first);
+		if (err != IniFile::errorNoError)
+			return err;
+		++first;
+	}
+	entry_t last = first;
+	while (last < _numEntries && _entries[last].type == IniLine::typeKey)
+		++last;
+
+	// Binary search for the first key not less than prefix
+	bool cs = ini.getCaseSensitive();
+	while (first < last) {
+		entry_t mid = first + (last - first) / 2;
+		char* key;
+		IniFile::error_t err = readKey(ini, _order[mid], buffer, len, &key);
+		if (err != IniFile::errorNoError)
+			return err;
+		if ((cs ? strncmp(key, prefix, prefixLen)
+			 : strncasecmp(key, prefix, prefixLen)) < 0)
+			first = mid + 1;
+		else
+			last = mid;
+	}
+	n = first;
+	return IniFile::errorNoError;
+}
+
+IniFile::error_t IniIndex::getValue(const IniFile &ini, const char* section,
+									const char* key, char* buffer, size_t len,
+									entry_t* entry) const
+{
+	// As findKey(), also finding where any continuation lines start
+	entry_t first = 0;
+	if (section != NULL) {
+		IniFile::error_t err = findSection(ini, section, buffer, len, first);
+		if (err != IniFile::errorNoError)
+			return err;
+		++first;
+	}
+	entry_t n;
+	char* cp;
+	uint32_t next;
+	if (key == NULL)
+		return IniFile::errorKeyNotFound;
+	IniFile::error_t err = findKeyFrom(ini, first, section != NULL,
+									   IniKey(key), buffer, len, n, &cp,
+									   &next);
+	if (err != IniFile::errorNoError)
+		return err;
+	if (entry)
+		*entry = n;
+	return finishValue(ini, buffer, len, cp, next);
+}
+
+IniFile::error_t IniIndex::getValue(const IniFile &ini, const IniKey &section,
+									const IniKey &key, char* buffer,
+									size_t len, entry_t* entry) const
+{
+	entry_t n;
+	char* cp;
+	uint32_t next;
+	IniFile::error_t err;
+	if (_slots)
+		err = probe(ini, section, key, buffer, len, n, &cp, &next);
+	else {
+		err = findSection(ini, section, buffer, len, n);
+		if (err != IniFile::errorNoError)
+			return err;
+		err = findKeyFrom(ini, n + 1, true, key, buffer, len, n, &cp, &next);
+	}
+	if (err != IniFile::errorNoError)
+		return err;
+	if (entry)
+		*entry = n;
+	return finishValue(ini, buffer, len, cp, next);
+}
+
+IniFile::error_t IniIndex::readValue(const IniFile &ini, entry_t entry,
+									 char* buffer, size_t len) const
+{
+	uint32_t pos = _entries[entry].position;
+	IniFile::error_t err = ini.readLine(buffer, len, pos);
+	if (err != IniFile::errorNoError && err != IniFile::errorEndOfFile)
+		return err;
+	if (err == IniFile::errorEndOfFile)
+		pos = _entries[entry].position + strlen(buffer);
+	char* cp;
+	if (IniFile::parseKey(IniFile::skipWhiteSpace(buffer), &cp) == NULL)
+		return IniFile::errorKeyNotFound;
+	return finishValue(ini, buffer, len, cp, pos);
+}
+
+// Move the value at cp, from the key line in buffer, to the start of
+// buffer. next is the position of the line after the key.
+IniFile::error_t IniIndex::finishValue(const IniFile &ini, char* buffer,
+									   size_t len, char* cp,
+									   uint32_t next) const
+{
+	if (ini.getSyntax()) {
+		IniFile::error_t err = ini.readValue(buffer, len, cp, next);
+		memmove(buffer, cp, strlen(cp) + 1);
+		return err;
+	}
+	cp = IniFile::skipWhiteSpace(cp);
+	IniFile::removeTrailingWhiteSpace(cp);
+	// Copy from cp to buffer, but the strings overlap so strcpy is out
+	while (*cp != '\0')
+		*buffer++ = *cp++;
+	*buffer = '\0';
+	return IniFile::errorNoError;
+}
+
+bool IniIndex::add(const IniLine &line, entry_t &section)
+{
+	switch (line.type) {
+	case IniLine::typeSection:
+	case IniLine::typeBadSection:
+		// A bad section cannot be found but still ends the previous one
+		section = _numEntries;
+		break;
+
+	case IniLine::typeKey:
+		if (line.nameLength == 0)
+			return true; // Can never match
+		break;
+
+	default:
+		return true;
+	}
+
+	if (_numEntries >= _maxEntries)
+		return false;
+	IniIndexEntry &e = _entries[_numEntries++];
+	e.position = line.position;
+	e.line = line.number;
+	e.hash = line.nameHash;
+	e.section = section;
+	e.type = line.type;
+	return true;
+}
+
+bool IniIndex::matchSection(const IniFile &ini, entry_t n,
+							const char* section, size_t sectionLen,
+							char* buffer, size_t len,
+							IniFile::error_t &err) const
+{
+	uint32_t pos = _entries[n].position;
+	err = ini.readLine(buffer, len, pos);
+	if (err == IniFile::errorEndOfFile)
+		err = IniFile::errorNoError;
+	if (err != IniFile::errorNoError)
+		return false;
+	char* cp = IniFile::parseSection(IniFile::skipWhiteSpace(buffer));
+	return cp != NULL && ini.matchName(cp, section, sectionLen);
+}
+
+// Whether the line of key entry n is for key. On success buffer holds
+// the line split by IniFile::parseKey() and next, if not NULL, is set
+// to the position of the following line.
+bool IniIndex::matchKey(const IniFile &ini, entry_t n, const IniKey &key,
+						char* buffer, size_t len, char** value,
+						uint32_t* next, IniFile::error_t &err) const
+{
+	uint32_t pos = _entries[n].position;
+	err = ini.readLine(buffer, len, pos);
+	if (err == IniFile::errorEndOfFile) {
+		pos = _entries[n].position + strlen(buffer);
+		err = IniFile::errorNoError;
+	}
+	if (err != IniFile::errorNoError)
+		return false;
+	char* cp = IniFile::parseKey(IniFile::skipWhiteSpace(buffer), value);
+	if (cp == NULL || !ini.matchName(cp, key.getName(), key.getLength()))
+		return false;
+	if (next)
+		*next = pos;
+	return true;
+}
+
+IniFile::error_t IniIndex::readKey(const IniFile &ini, entry_t n,
+								   char* buffer, size_t len, char** key) const
+{
+	uint32_t pos = _entries[n].position;
+	IniFile::error_t err = ini.readLine(buffer, len, pos);
+	if (err != IniFile::errorNoError && err != IniFile::errorEndOfFile)
+		return err;
+	char* value;
+	*key = IniFile::parseKey(IniFile::skipWhiteSpace(buffer), &value);
+	// The index does not match the file if there is no key
+	return (*key ? IniFile::errorNoError : IniFile::errorUnknownError);
+}
+
+// Compare the keys of two entries, which are in file order if the
+// keys are the same
+IniFile::error_t IniIndex::compareKeys(const IniFile &ini, entry_t a,
+									   entry_t b, char* buffer, size_t len,
+									   int &result) const
+{
+	size_t half = len / 2;
+	char* keyA;
+	char* keyB;
+	IniFile::error_t err = readKey(ini, a, buffer, half, &keyA);
+	if (err == IniFile::errorNoError)
+		err = readKey(ini, b, buffer + half, len - half, &keyB);
+	if (err != IniFile::errorNoError)
+		return err;
+	result = (ini.getCaseSensitive() ? strcmp(keyA, keyB)
+			  : strcasecmp(keyA, keyB));
+	if (result == 0)
+		result = int(a) - int(b);
+	return IniFile::errorNoError;
+}
+
+IniFile::error_t IniIndex::siftDown(const IniFile &ini, entry_t* heap,
+									entry_t root, entry_t end,
+									char* buffer, size_t len) const
+{
+	while (uint32_t(root) * 2 + 1 < end) {
+		entry_t child = root * 2 + 1;
+		int cmp;
+		IniFile::error_t err;
+		if (child + 1 < end) {
+			err = compareKeys(ini, heap[child], heap[child + 1], buffer, len,
+							  cmp);
+			if (err != IniFile::errorNoError)
+				return err;
+			if (cmp < 0)
+				++child;
+		}
+		err = compareKeys(ini, heap[root], heap[child], buffer, len, cmp);
+		if (err != IniFile::errorNoError)
+			return err;
+		if (cmp >= 0)
+			break;
+		entry_t tmp = heap[root];
+		heap[root] = heap[child];
+		heap[child] = tmp;
+		root = child;
+	}
+	return IniFile::errorNoError;
+}
+
+#if defined(INIFILE_HOST)
+// Find the start of the first line which begins at or after pos. A
+// newline preceded by something other than a newline must end a
+// line, whereas a "\r" or "\n" in a run of newlines could be the
+// second half of a two character newline.
+static uint32_t findLineStart(const char* data, uint32_t dataLen,
+							  uint32_t pos)
+{
+	for (uint32_t i = (pos ? pos : 1); i < dataLen; ++i) {
+		char c = data[i];
+		if ((c != '\n' && c != '\r') ||
+			data[i-1] == '\n' || data[i-1] == '\r')
+			continue;
+		char other = (c == '\n' ? '\r' : '\n');
+		if (i + 1 < dataLen && data[i+1] == other)
+			++i;
+		return i + 1;
+	}
+	return dataLen;
+}
+
+// Index one chunk, returning the number of lines. Section and line
+// numbers are relative to the start of the chunk; keys before the
+// first section in the chunk belong to the section which was open at
+// the end of the previous chunk.
+static uint32_t indexChunk(const char* data, uint32_t start, uint32_t end,
+						   std::vector<IniIndexEntry> &entries)
+{
+	IniTokenizer tokenizer(start);
+	IniIndex::entry_t section = IniIndex::noSection;
+	uint32_t pos = start;
+	while (true) {
+		if (pos < end) {
+			pos += tokenizer.scan(data + pos, end - pos);
+			if (!tokenizer.lineReady())
+				continue;
+		}
+		else {
+			tokenizer.finish();
+			if (!tokenizer.lineReady())
+				break;
+		}
+
+		const IniLine &line = tokenizer.getLine();
+		if (line.type == IniLine::typeSection ||
+			line.type == IniLine::typeBadSection)
+			section = entries.size();
+		else if (line.type != IniLine::typeKey || line.nameLength == 0)
+			continue;
+		IniIndexEntry e;
+		e.position = line.position;
+		e.line = line.number;
+		e.hash = line.nameHash;
+		e.section = section;
+		e.type = line.type;
+		entries.push_back(e);
+	}
+	return tokenizer.getLineNumber() - 1;
+}
+
+IniFile::error_t IniIndex::buildParallel(const IniFile &ini, char* buffer,
+										 size_t len, unsigned threads,
+										 uint32_t minChunkLen)
+{
+	const char* data = ini.getData();
+	uint32_t dataLen = ini.getDataLen();
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+	if (minChunkLen && threads > dataLen / minChunkLen)
+		threads = dataLen / minChunkLen;
+	// Chunks cannot start in the middle of a value which continues
+	if (data == nullptr || !ini.isOpen() || threads <= 1 ||
+		(ini.getSyntax() & IniFile::syntaxContinuation))
+		return build(ini, buffer, len);
+
+	clear();
+	std::vector<uint32_t> starts(threads + 1);
+	starts[0] = 0;
+	for (unsigned i = 1; i < threads; ++i) {
+		uint32_t target = uint64_t(dataLen) * i / threads;
+		if (target < starts[i-1])
+			target = starts[i-1];
+		starts[i] = findLineStart(data, dataLen, target);
+	}
+	starts[threads] = dataLen;
+
+	std::vector<std::vector<IniIndexEntry> > chunks(threads);
+	std::vector<uint32_t> lines(threads);
+	std::vector<std::thread> workers;
+	for (unsigned i = 1; i < threads; ++i)
+		workers.push_back(std::thread([&, i]() {
+			lines[i] = indexChunk(data, starts[i], starts[i+1], chunks[i]);
+		}));
+	lines[0] = indexChunk(data, starts[0], starts[1], chunks[0]);
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+
+	// Join the chunks, converting to absolute section and line numbers
+	entry_t section = noSection;
+	uint32_t lineOffset = 0;
+	for (unsigned i = 0; i < threads; ++i) {
+		const std::vector<IniIndexEntry> &chunk = chunks[i];
+		if (chunk.size() > size_t(_maxEntries - _numEntries)) {
+			clear();
+			return IniFile::errorBufferTooSmall;
+		}
+		entry_t offset = _numEntries;
+		bool inherit = true;
+		for (size_t j = 0; j < chunk.size(); ++j) {
+			IniIndexEntry e = chunk[j];
+			if (e.type != IniLine::typeKey)
+				inherit = false;
+			e.section = (inherit ? section : e.section + offset);
+			e.line += lineOffset;
+			_entries[_numEntries++] = e;
+		}
+		if (!inherit)
+			section = _entries[_numEntries - 1].section;
+		lineOffset += lines[i];
+	}
+	_valid = true;
+	return IniFile::errorNoError;
+}
+#endif
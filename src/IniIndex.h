@@ -0,0 +1,209 @@
+#ifndef _ININDEX_H
+#define _ININDEX_H
+
+#include "IniFile.h"
+#include "IniKey.h"
+#include "IniTokenizer.h"
+
+// One section or key line recorded in an IniIndex
+struct IniIndexEntry {
+	uint32_t position; // Start of the line
+	uint32_t line;     // Line number, the first line is 1
+	uint32_t hash;     // IniTokenizer::hash() of the section name or key
+	// Entry number of the section the line is in
+	IniFile::entry_t section;
+	uint8_t type;      // IniLine::typeSection, typeBadSection or typeKey
+};
+
+// Index of the sections and keys of an ini file, held in an array of
+// entries supplied by the user. Each entry stores only the position
+// and hash of a line so the file is still read to check for a match
+// and to get the value, but without reading any of the lines in
+// between. The index must be built again if the file changes;
+// IniFile::open() marks an attached index as invalid. Entry numbers
+// are 16 bits on a board, so an index holds at most 65534 lines, and
+// 32 bits on a host, for large generated files.
+class IniIndex {
+public:
+	typedef IniFile::entry_t entry_t;
+
+	// Section number for keys which come before the first section
+	static const entry_t noSection = entry_t(-1);
+
+	IniIndex(IniIndexEntry* entries, entry_t maxEntries);
+
+	// Read the entire file once, in blocks of len bytes, to build the
+	// index. Returns errorBufferTooSmall if there are too many entries.
+	IniFile::error_t build(const IniFile &ini, char* buffer, size_t len);
+
+#if defined(INIFILE_HOST)
+	// As build() but the data is split into chunks which are indexed
+	// in parallel, then joined. Only an IniFile held in memory can be
+	// read concurrently; for a file, whose one handle cannot be shared
+	// between threads, this calls build(), so load a large file into
+	// memory first (eg with IniDocument) to index it in parallel. A
+	// threads value of zero uses one thread per core. Fewer threads are
+	// used if the chunks would be smaller than minChunkLen, since
+	// splitting small files costs more than it saves.
+	IniFile::error_t buildParallel(const IniFile &ini, char* buffer,
+								   size_t len, unsigned threads = 0,
+								   uint32_t minChunkLen = 65536);
+#endif
+
+	inline bool isValid(void) const;
+	void clear(void);
+
+	// Sort the keys of each section by name, so that IniFile can find
+	// keys by prefix with a binary search. order must have room for
+	// getMaxEntries() elements and stay valid while in use. Lines are
+	// compared two at a time, each using half of buffer. Keys are
+	// ordered by the case rule of ini, so the order is not used while
+	// ini's case sensitivity differs; sort again after changing it. The
+	// order is forgotten when the index is built again.
+	IniFile::error_t sort(const IniFile &ini, char* buffer, size_t len,
+						  entry_t* order);
+	// Whether the keys are sorted by the case rule ini now has
+	inline bool isSorted(const IniFile &ini) const;
+	// Entry number at position n of the sorted order
+	inline entry_t getSorted(entry_t n) const;
+
+	// Build a hash table of the keys which can be found in a section,
+	// so that getValue() with IniKey names goes straight to the
+	// candidate lines instead of searching the entries. slots must
+	// have more elements than there are keys and stay valid while in
+	// use. Half of buffer is used to compare sections which share a
+	// hash. The table is forgotten when the index is built again.
+	IniFile::error_t buildHashTable(const IniFile &ini, char* buffer,
+									size_t len, entry_t* slots,
+									entry_t numSlots);
+	inline bool hasHashTable(void) const;
+
+	inline entry_t getNumEntries(void) const;
+	inline entry_t getMaxEntries(void) const;
+	inline const IniIndexEntry& getEntry(entry_t n) const;
+
+	// Find the entry number of the line for key. If section is NULL
+	// the first matching key in the file is used. buffer is used to
+	// read the candidate lines, on success it holds the key line with
+	// the key and value split by IniFile::parseKey().
+	IniFile::error_t findKey(const IniFile &ini, const char* section,
+							 const char* key, char* buffer, size_t len,
+							 entry_t &entry, char** value) const;
+
+	// As above, for the keys of the section with entry number section,
+	// or those before the first section if it is noSection
+	IniFile::error_t findKey(const IniFile &ini, entry_t section,
+							 const char* key, char* buffer, size_t len,
+							 entry_t &entry, char** value) const;
+
+	// Find the entry number of the first section named section
+	IniFile::error_t findSection(const IniFile &ini, const char* section,
+								 char* buffer, size_t len,
+								 entry_t &entry) const;
+
+	// Find the first key in section which starts with the first
+	// prefixLen characters of prefix. n is set to its position in the
+	// sorted order, or to the end of the section if there is none. If
+	// section is NULL the keys before the first section are searched.
+	// The index must be sorted.
+	IniFile::error_t findPrefix(const IniFile &ini, const char* section,
+								const char* prefix, size_t prefixLen,
+								char* buffer, size_t len, entry_t &n) const;
+
+	// Look up the value for key, as IniFile::getValue(). If entry is
+	// not NULL it is set to the entry number of the key.
+	IniFile::error_t getValue(const IniFile &ini, const char* section,
+							  const char* key, char* buffer, size_t len,
+							  entry_t* entry = NULL) const;
+	// As above, using the hash table if there is one
+	IniFile::error_t getValue(const IniFile &ini, const IniKey &section,
+							  const IniKey &key, char* buffer, size_t len,
+							  entry_t* entry = NULL) const;
+
+	// Read the value of the key with entry number entry into buffer, as
+	// getValue()
+	IniFile::error_t readValue(const IniFile &ini, entry_t entry,
+							   char* buffer, size_t len) const;
+
+private:
+	bool add(const IniLine &line, entry_t &section);
+	IniFile::error_t findSection(const IniFile &ini, const IniKey &section,
+								 char* buffer, size_t len,
+								 entry_t &entry) const;
+	IniFile::error_t findKeyFrom(const IniFile &ini, entry_t n,
+								 bool inSection, const IniKey &key,
+								 char* buffer, size_t len, entry_t &entry,
+								 char** value, uint32_t* next) const;
+	IniFile::error_t probe(const IniFile &ini, const IniKey &section,
+						   const IniKey &key, char* buffer, size_t len,
+						   entry_t &entry, char** value,
+						   uint32_t* next) const;
+	static inline uint32_t slotHash(uint32_t section, uint32_t key);
+	bool matchKey(const IniFile &ini, entry_t n, const IniKey &key,
+				  char* buffer, size_t len, char** value, uint32_t* next,
+				  IniFile::error_t &err) const;
+	IniFile::error_t finishValue(const IniFile &ini, char* buffer,
+								 size_t len, char* cp, uint32_t next) const;
+	bool matchSection(const IniFile &ini, entry_t n, const char* section,
+					  size_t sectionLen, char* buffer, size_t len,
+					  IniFile::error_t &err) const;
+	IniFile::error_t readKey(const IniFile &ini, entry_t n, char* buffer,
+							 size_t len, char** key) const;
+	IniFile::error_t compareKeys(const IniFile &ini, entry_t a, entry_t b,
+								 char* buffer, size_t len, int &result) const;
+	IniFile::error_t siftDown(const IniFile &ini, entry_t* heap,
+							  entry_t root, entry_t end,
+							  char* buffer, size_t len) const;
+
+	IniIndexEntry* _entries;
+	entry_t _maxEntries;
+	entry_t _numEntries;
+	bool _valid;
+	entry_t* _order;
+	bool _sortedCaseSensitive; // Case rule of _order
+	entry_t* _slots; // Entry numbers, noSection where empty
+	entry_t _numSlots;
+};
+
+bool IniIndex::isValid(void) const
+{
+	return _valid;
+}
+
+bool IniIndex::isSorted(const IniFile &ini) const
+{
+	return _valid && _order != nullptr &&
+		_sortedCaseSensitive == ini.getCaseSensitive();
+}
+
+IniIndex::entry_t IniIndex::getSorted(entry_t n) const
+{
+	return _order[n];
+}
+
+bool IniIndex::hasHashTable(void) const
+{
+	return _valid && _slots != nullptr;
+}
+
+uint32_t IniIndex::slotHash(uint32_t section, uint32_t key)
+{
+	return section ^ (key * 0x9E3779B1UL);
+}
+
+IniIndex::entry_t IniIndex::getNumEntries(void) const
+{
+	return _numEntries;
+}
+
+IniIndex::entry_t IniIndex::getMaxEntries(void) const
+{
+	return _maxEntries;
+}
+
+const IniIndexEntry& IniIndex::getEntry(entry_t n) const
+{
+	return _entries[n];
+}
+
+#endif
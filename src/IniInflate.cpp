@@ -0,0 +1,494 @@
+#include "IniInflate.h"
+
+#include <string.h>
+
+IniInflate::IniInflate(uint8_t* window, size_t windowLen, format_t format)
+{
+	// Round down to a power of two so positions can be masked
+	size_t wl = 1;
+	while (wl * 2 <= windowLen)
+		wl *= 2;
+	_window = window;
+	_windowLen = (window == nullptr ? 0 : wl);
+	_format = format;
+	_checkpoints = nullptr;
+	_windowCopies = nullptr;
+	_maxCheckpoints = 0;
+	_interval = 0;
+	reset();
+}
+
+void IniInflate::setCheckpoints(IniInflateCheckpoint* checkpoints,
+								uint8_t* windowCopies, uint8_t maxCheckpoints,
+								uint32_t interval)
+{
+	_checkpoints = checkpoints;
+	_windowCopies = windowCopies;
+	_maxCheckpoints = (checkpoints && windowCopies ? maxCheckpoints : 0);
+	_interval = interval;
+	_numCheckpoints = 0;
+}
+
+void IniInflate::reset(void)
+{
+	_numCheckpoints = 0;
+	restart();
+}
+
+size_t IniInflate::read(File &file, uint32_t pos, char* buffer, size_t n)
+{
+	if (_windowLen == 0)
+		return 0;
+
+	// Bytes before windowStart have been discarded
+	uint32_t windowStart = (_outPos > _windowLen ? _outPos - _windowLen : 0);
+	if (pos < windowStart || pos > _outPos) {
+		if (!restore(pos) && pos < windowStart)
+			restart();
+	}
+	if (_state == stateError)
+		return 0;
+
+	size_t copied = 0;
+	while (copied < n) {
+		uint32_t p = pos + copied;
+		if (p < _outPos) {
+			buffer[copied++] = _window[p & (_windowLen - 1)];
+			continue;
+		}
+		if (nextByte(file) < 0)
+			break;
+	}
+	return copied;
+}
+
+void IniInflate::restart(void)
+{
+	_outPos = 0;
+	_state = stateHeader;
+	_final = false;
+	_remaining = 0;
+	_distance = 0;
+	_inIndex = 0;
+	_inCount = 0;
+	_inPos = 0;
+	_bitBuffer = 0;
+	_bitCount = 0;
+}
+
+// Resume from the last checkpoint before pos, if it is ahead of the
+// current position or pos is no longer in the window
+bool IniInflate::restore(uint32_t pos)
+{
+	IniInflateCheckpoint* cp = nullptr;
+	for (uint8_t i = 0; i < _numCheckpoints; ++i) {
+		if (_checkpoints[i].outPos > pos)
+			break;
+		cp = &_checkpoints[i];
+	}
+	if (cp == nullptr)
+		return false;
+	uint32_t windowStart = (_outPos > _windowLen ? _outPos - _windowLen : 0);
+	if (_state != stateError && pos >= windowStart && cp->outPos <= _outPos)
+		return false; // Current position is at least as good
+
+	memcpy(_window, _windowCopies + (cp - _checkpoints) * _windowLen,
+		   _windowLen);
+	_outPos = cp->outPos;
+	_inPos = cp->inPos;
+	_inIndex = 0;
+	_inCount = 0;
+	_bitBuffer = cp->bitBuffer;
+	_bitCount = cp->bitCount;
+	_state = stateBlockHeader;
+	_final = false;
+	return true;
+}
+
+void IniInflate::saveCheckpoint(void)
+{
+	uint32_t last = (_numCheckpoints ?
+					 _checkpoints[_numCheckpoints - 1].outPos : 0);
+	if (_numCheckpoints >= _maxCheckpoints || _outPos <= last ||
+		_outPos < last + _interval)
+		return;
+
+	IniInflateCheckpoint &cp = _checkpoints[_numCheckpoints];
+	cp.outPos = _outPos;
+	cp.inPos = _inPos - (_inCount - _inIndex);
+	cp.bitBuffer = _bitBuffer;
+	cp.bitCount = _bitCount;
+	memcpy(_windowCopies + _numCheckpoints * _windowLen, _window,
+		   _windowLen);
+	++_numCheckpoints;
+}
+
+// Decompress the next byte into the window. Returns the byte, or -1
+// at the end of the data or on error.
+int IniInflate::nextByte(File &file)
+{
+	while (true) {
+		switch (_state) {
+		case stateHeader:
+			if (!readHeader(file))
+				_state = stateError;
+			else
+				_state = stateBlockHeader;
+			break;
+
+		case stateBlockHeader:
+			{
+				if (_final) {
+					_state = stateDone;
+					break;
+				}
+				saveCheckpoint();
+				_final = getBits(file, 1);
+				uint8_t type = getBits(file, 2);
+				if (_state == stateError)
+					break;
+				if (type == 0) {
+					// Stored block, starts on a byte boundary
+					_bitCount = 0;
+					int len = getByte(file);
+					len |= getByte(file) << 8;
+					int nlen = getByte(file);
+					nlen |= getByte(file) << 8;
+					if (len < 0 || nlen < 0 ||
+						uint16_t(len) != uint16_t(~nlen)) {
+						_state = stateError;
+						break;
+					}
+					_remaining = len;
+					_state = stateStored;
+				}
+				else if (type == 1) {
+					buildFixedTrees();
+					_state = stateCodes;
+				}
+				else if (type == 2 && readDynamicTrees(file))
+					_state = stateCodes;
+				else
+					_state = stateError;
+			}
+			break;
+
+		case stateStored:
+			{
+				if (_remaining == 0) {
+					_state = stateBlockHeader;
+					break;
+				}
+				int c = getByte(file);
+				if (c < 0) {
+					_state = stateError;
+					break;
+				}
+				--_remaining;
+				emit(c);
+				return c;
+			}
+
+		case stateCodes:
+			{
+				int sym = decodeSymbol(file, _literals);
+				if (sym < 0 || sym > 285) {
+					_state = stateError;
+					break;
+				}
+				if (sym < 256) {
+					emit(sym);
+					return sym;
+				}
+				if (sym == 256) {
+					_state = stateBlockHeader;
+					break;
+				}
+
+				// Length and distance base values follow a pattern, so
+				// calculate them instead of storing tables
+				uint8_t i = sym - 257;
+				uint16_t length;
+				if (i < 8)
+					length = 3 + i;
+				else if (i == 28)
+					length = 258;
+				else {
+					uint8_t extra = (i >> 2) - 1;
+					length = ((4 + (i & 3)) << extra) + 3 + getBits(file, extra);
+				}
+
+				int dsym = decodeSymbol(file, _distances);
+				if (dsym < 0 || dsym > 29) {
+					_state = stateError;
+					break;
+				}
+				uint16_t distance;
+				if (dsym < 4)
+					distance = 1 + dsym;
+				else {
+					uint8_t extra = (dsym >> 1) - 1;
+					distance = ((2 + (dsym & 1)) << extra) + 1
+						+ getBits(file, extra);
+				}
+				if (distance > _windowLen || distance > _outPos) {
+					// Corrupt data or window too small
+					_state = stateError;
+					break;
+				}
+				_remaining = length;
+				_distance = distance;
+				if (_state != stateError)
+					_state = stateCopy;
+			}
+			break;
+
+		case stateCopy:
+			{
+				uint8_t c = _window[(_outPos - _distance) & (_windowLen - 1)];
+				if (--_remaining == 0)
+					_state = stateCodes;
+				emit(c);
+				return c;
+			}
+
+		default:
+			// Done or error
+			return -1;
+		}
+	}
+}
+
+bool IniInflate::readHeader(File &file)
+{
+	format_t format = _format;
+	int b0 = getByte(file);
+	int b1 = getByte(file);
+	if (b0 < 0 || b1 < 0)
+		return false;
+
+	if (format == formatAuto) {
+		if (b0 == 0x1f && b1 == 0x8b)
+			format = formatGzip;
+		else if ((b0 & 0x0f) == 8 && ((b0 << 8) | b1) % 31 == 0)
+			format = formatZlib;
+		else {
+			// Raw deflate, start again from the first byte
+			_inPos = 0;
+			_inIndex = 0;
+			_inCount = 0;
+			return true;
+		}
+	}
+
+	switch (format) {
+	case formatRaw:
+		_inPos = 0;
+		_inIndex = 0;
+		_inCount = 0;
+		return true;
+
+	case formatZlib:
+		// Reject preset dictionaries and windows larger than ours
+		if ((b0 & 0x0f) != 8 || (b1 & 0x20) ||
+			(uint32_t(1) << ((b0 >> 4) + 8)) > _windowLen)
+			return false;
+		return true;
+
+	case formatGzip:
+		{
+			if (b0 != 0x1f || b1 != 0x8b || getByte(file) != 8)
+				return false;
+			int flags = getByte(file);
+			for (uint8_t i = 0; i < 6; ++i)
+				getByte(file); // mtime, extra flags, OS
+			if (flags & 0x04) {
+				// Extra field
+				int xlen = getByte(file);
+				xlen |= getByte(file) << 8;
+				while (xlen-- > 0)
+					getByte(file);
+			}
+			if (flags & 0x08)
+				while (getByte(file) > 0)
+					; // Filename
+			if (flags & 0x10)
+				while (getByte(file) > 0)
+					; // Comment
+			if (flags & 0x02) {
+				getByte(file); // Header CRC
+				getByte(file);
+			}
+			return _state != stateError;
+		}
+
+	default:
+		return false;
+	}
+}
+
+bool IniInflate::readDynamicTrees(File &file)
+{
+	static const uint8_t order[19] = {
+		16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+	uint8_t lengths[288 + 32];
+
+	uint16_t hlit = getBits(file, 5) + 257;
+	uint8_t hdist = getBits(file, 5) + 1;
+	uint8_t hclen = getBits(file, 4) + 4;
+	if (hlit > 286 || hdist > 30)
+		return false;
+
+	// Code length codes, temporarily using the distance tree
+	memset(lengths, 0, 19);
+	for (uint8_t i = 0; i < hclen; ++i)
+		lengths[order[i]] = getBits(file, 3);
+	buildTree(_distances, lengths, 19);
+
+	uint16_t num = 0;
+	while (num < hlit + hdist) {
+		int sym = decodeSymbol(file, _distances);
+		if (sym < 0 || _state == stateError)
+			return false;
+		if (sym < 16) {
+			lengths[num++] = sym;
+			continue;
+		}
+		uint8_t prev = 0;
+		uint8_t repeat;
+		if (sym == 16) {
+			if (num == 0)
+				return false;
+			prev = lengths[num - 1];
+			repeat = 3 + getBits(file, 2);
+		}
+		else if (sym == 17)
+			repeat = 3 + getBits(file, 3);
+		else
+			repeat = 11 + getBits(file, 7);
+		if (num + repeat > hlit + hdist)
+			return false;
+		while (repeat--)
+			lengths[num++] = prev;
+	}
+	if (lengths[256] == 0 || _state == stateError)
+		return false;
+
+	buildTree(_literals, lengths, hlit);
+	buildTree(_distances, lengths + hlit, hdist);
+	return true;
+}
+
+void IniInflate::buildFixedTrees(void)
+{
+	// Literal/length codes: 256-279 have 7 bits, 0-143 and 280-287
+	// have 8 bits, 144-255 have 9 bits
+	memset(_literals.counts, 0, sizeof(_literals.counts));
+	_literals.counts[7] = 24;
+	_literals.counts[8] = 152;
+	_literals.counts[9] = 112;
+	uint16_t n = 0;
+	for (uint16_t i = 256; i < 280; ++i)
+		_literals.symbols[n++] = i;
+	for (uint16_t i = 0; i < 144; ++i)
+		_literals.symbols[n++] = i;
+	for (uint16_t i = 280; i < 288; ++i)
+		_literals.symbols[n++] = i;
+	for (uint16_t i = 144; i < 256; ++i)
+		_literals.symbols[n++] = i;
+
+	// Distance codes all have 5 bits
+	memset(_distances.counts, 0, sizeof(_distances.counts));
+	_distances.counts[5] = 30;
+	for (uint16_t i = 0; i < 30; ++i)
+		_distances.symbols[i] = i;
+}
+
+void IniInflate::buildTree(Tree &t, const uint8_t* lengths, uint16_t num)
+{
+	uint16_t offsets[16];
+	memset(t.counts, 0, sizeof(t.counts));
+	for (uint16_t i = 0; i < num; ++i)
+		++t.counts[lengths[i]];
+	t.counts[0] = 0;
+
+	uint16_t sum = 0;
+	for (uint8_t i = 0; i < 16; ++i) {
+		offsets[i] = sum;
+		sum += t.counts[i];
+	}
+	for (uint16_t i = 0; i < num; ++i)
+		if (lengths[i])
+			t.symbols[offsets[lengths[i]]++] = i;
+}
+
+// Canonical Huffman decoding, one bit at a time to keep the tables small
+int IniInflate::decodeSymbol(File &file, const Tree &t)
+{
+	int code = 0;
+	int first = 0;
+	int index = 0;
+	for (uint8_t len = 1; len < 16; ++len) {
+		code |= getBits(file, 1);
+		if (_state == stateError)
+			return -1;
+		int count = t.counts[len];
+		if (code - first < count)
+			return t.symbols[index + code - first];
+		index += count;
+		first += count;
+		first <<= 1;
+		code <<= 1;
+	}
+	return -1;
+}
+
+int IniInflate::getByte(File &file)
+{
+	if (_inIndex == _inCount) {
+		if (!file.seek(_inPos)) {
+			_state = stateError;
+			return -1;
+		}
+#if defined(ARDUINO_ARCH_ESP32) && !defined(PREFER_SDFAT_LIBRARY)
+		size_t bytesRead = file.readBytes((char*)_in, sizeof(_in));
+#else
+		size_t bytesRead = file.read((char*)_in, sizeof(_in));
+#endif
+		if (bytesRead == 0) {
+			// Compressed data ended before the final block
+			_state = stateError;
+			return -1;
+		}
+		_inPos += bytesRead;
+		_inIndex = 0;
+		_inCount = bytesRead;
+	}
+	return _in[_inIndex++];
+}
+
+// Read n (at most 15) bits, least significant first. Sets the error
+// state if the data runs out.
+int IniInflate::getBits(File &file, uint8_t n)
+{
+	int val = 0;
+	for (uint8_t i = 0; i < n; ++i) {
+		if (_bitCount == 0) {
+			int c = getByte(file);
+			if (c < 0)
+				return 0;
+			_bitBuffer = c;
+			_bitCount = 8;
+		}
+		val |= (_bitBuffer & 1) << i;
+		_bitBuffer >>= 1;
+		--_bitCount;
+	}
+	return val;
+}
+
+void IniInflate::emit(uint8_t c)
+{
+	_window[_outPos & (_windowLen - 1)] = c;
+	++_outPos;
+}
@@ -0,0 +1,123 @@
+#ifndef _INIINFLATE_H
+#define _INIINFLATE_H
+
+#include "IniFile.h"
+
+// Size of the buffer used to read compressed data from the file
+#define INI_INFLATE_INPUT_LEN 32
+
+// Information needed to resume decompression from a deflate block
+// boundary. Stored by IniInflate in a caller-supplied array.
+struct IniInflateCheckpoint {
+	uint32_t outPos;   // Uncompressed position
+	uint32_t inPos;    // Position in the file of the next compressed byte
+	uint8_t bitBuffer; // Bits not yet consumed from the previous byte
+	uint8_t bitCount;
+};
+
+// Streaming decompressor for deflate (raw, zlib or gzip) data, used
+// by IniFile to read compressed ini files. Only a window of the most
+// recent output is kept, in a buffer supplied by the user; it must be
+// a power of two and at least as large as the window used by the
+// compressor (eg 1024 bytes for zlib windowBits=10). Earlier data is
+// found by restarting from the nearest checkpoint, or from the start
+// of the file if there are none. The gzip and zlib checksums are not
+// verified.
+class IniInflate {
+public:
+	enum format_t {
+		formatAuto = 0, // gzip or zlib header, otherwise raw deflate
+		formatRaw,
+		formatZlib,
+		formatGzip,
+	};
+
+	IniInflate(uint8_t* window, size_t windowLen,
+			   format_t format = formatAuto);
+
+	// Record a checkpoint at the first block boundary after every
+	// 'interval' bytes of output. windowCopies must hold maxCheckpoints
+	// copies of the window.
+	void setCheckpoints(IniInflateCheckpoint* checkpoints,
+						uint8_t* windowCopies, uint8_t maxCheckpoints,
+						uint32_t interval);
+	inline uint8_t getNumCheckpoints(void) const;
+
+	// Forget all decompression state, including any checkpoints. Must
+	// be called if the file changes.
+	void reset(void);
+
+	// Copy up to n bytes of uncompressed data starting at pos. Returns
+	// the number of bytes copied, less than n only at the end of the
+	// data or on error.
+	size_t read(File &file, uint32_t pos, char* buffer, size_t n);
+
+	// True if the compressed data is corrupt, or needs a larger window
+	inline bool getError(void) const;
+
+private:
+	enum {
+		stateHeader = 0,
+		stateBlockHeader,
+		stateStored,
+		stateCodes,
+		stateCopy,
+		stateDone,
+		stateError,
+	};
+
+	struct Tree {
+		uint16_t counts[16];
+		uint16_t symbols[288];
+	};
+
+	void restart(void);
+	bool restore(uint32_t pos);
+	void saveCheckpoint(void);
+	int nextByte(File &file);
+	bool readHeader(File &file);
+	bool readDynamicTrees(File &file);
+	void buildFixedTrees(void);
+	static void buildTree(Tree &t, const uint8_t* lengths, uint16_t num);
+	int decodeSymbol(File &file, const Tree &t);
+	int getByte(File &file);
+	int getBits(File &file, uint8_t n);
+	void emit(uint8_t c);
+
+	uint8_t* _window;
+	size_t _windowLen;
+	format_t _format;
+	uint32_t _outPos;
+
+	IniInflateCheckpoint* _checkpoints;
+	uint8_t* _windowCopies;
+	uint8_t _maxCheckpoints;
+	uint8_t _numCheckpoints;
+	uint32_t _interval;
+
+	uint8_t _state;
+	bool _final;
+	uint16_t _remaining; // Bytes left in a stored block or match
+	uint16_t _distance;
+	Tree _literals;
+	Tree _distances;
+
+	uint8_t _in[INI_INFLATE_INPUT_LEN];
+	uint8_t _inIndex;
+	uint8_t _inCount;
+	uint32_t _inPos; // File position after the last byte in _in
+	uint8_t _bitBuffer;
+	uint8_t _bitCount;
+};
+
+uint8_t IniInflate::getNumCheckpoints(void) const
+{
+	return _numCheckpoints;
+}
+
+bool IniInflate::getError(void) const
+{
+	return _state == stateError;
+}
+
+#endif
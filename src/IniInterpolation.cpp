@@ -0,0 +1,253 @@
+#include "IniInterpolation.h"
+#include "IniIndex.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(INIFILE_HOST)
+static const char* hostEnvironment(const char* name)
+{
+	return getenv(name);
+}
+#endif
+
+IniInterpolation::IniInterpolation(char* arena, size_t arenaLen,
+								   IniResolvedValue* values,
+								   uint16_t maxValues)
+{
+	_arena = arena;
+	_arenaLen = arenaLen;
+	_used = 0;
+	_values = values;
+	_maxValues = maxValues;
+	_numValues = 0;
+#if defined(INIFILE_HOST)
+	_environment = hostEnvironment;
+#else
+	_environment = nullptr;
+#endif
+	_index = nullptr;
+	_generation = 0;
+	_valid = false;
+	_errorLine = 0;
+}
+
+IniFile::error_t IniInterpolation::resolve(const IniFile &ini, char* buffer,
+										   size_t len)
+{
+	_valid = false;
+	_used = 0;
+	_numValues = 0;
+	_errorLine = 0;
+	const IniIndex* index = ini.getIndex();
+	if (!ini.isOpen())
+		return IniFile::errorFileNotOpen;
+	if (index == nullptr || !index->isValid())
+		return IniFile::errorUnknownError;
+	// Lines are read in two halves, the value being resolved and the
+	// value it refers to
+	len /= 2;
+	if (len < 3)
+		return IniFile::errorBufferTooSmall;
+	char* line = buffer;
+	char* other = buffer + len;
+
+	// Find the values with references, in entry order
+	for (IniFile::entry_t n = 0; n < index->getNumEntries(); ++n) {
+		const IniIndexEntry &e = index->getEntry(n);
+		if (e.type != IniLine::typeKey)
+			continue;
+		IniFile::error_t err = index->readValue(ini, n, line, len);
+		if (err != IniFile::errorNoError) {
+			_errorLine = e.line;
+			return err;
+		}
+		if (strstr(line, "${") == NULL && strstr(line, "$$") == NULL)
+			continue;
+		if (_numValues >= _maxValues) {
+			_errorLine = e.line;
+			return IniFile::errorBufferTooSmall;
+		}
+		_values[_numValues].entry = n;
+		_values[_numValues].offset = unresolved;
+		++_numValues;
+	}
+
+	// Resolve values whose references are all resolved, until none are
+	// left. If a pass makes no progress the rest refer to each other.
+	uint16_t waiting = _numValues;
+	bool progress = true;
+	while (waiting && progress) {
+		progress = false;
+		for (uint16_t i = 0; i < _numValues; ++i) {
+			IniResolvedValue &v = _values[i];
+			if (v.offset != unresolved)
+				continue;
+			IniFile::error_t err;
+			switch (resolveValue(ini, *index, v, line, other, len, err)) {
+			case resultResolved:
+				progress = true;
+				--waiting;
+				break;
+			case resultWaiting:
+				break;
+			case resultError:
+				_errorLine = index->getEntry(v.entry).line;
+				return err;
+			}
+		}
+	}
+	if (waiting) {
+		for (uint16_t i = 0; i < _numValues; ++i)
+			if (_values[i].offset == unresolved) {
+				_errorLine = index->getEntry(_values[i].entry).line;
+				break;
+			}
+		return IniFile::errorInterpolationError;
+	}
+
+	_index = index;
+	_generation = ini.getGeneration();
+	_valid = true;
+	return IniFile::errorNoError;
+}
+
+bool IniInterpolation::isValid(const IniFile &ini) const
+{
+	return _valid && ini.getIndex() == _index && _index->isValid() &&
+		ini.getGeneration() == _generation;
+}
+
+const char* IniInterpolation::getValue(IniFile::entry_t entry) const
+{
+	IniResolvedValue* v = find(entry);
+	if (v == nullptr || v->offset == unresolved)
+		return nullptr;
+	return _arena + v->offset;
+}
+
+IniInterpolation::result_t IniInterpolation::resolveValue(
+	const IniFile &ini, const IniIndex &index, IniResolvedValue &v,
+	char* line, char* other, size_t len, IniFile::error_t &err)
+{
+	const IniIndexEntry &e = index.getEntry(v.entry);
+	err = index.readValue(ini, v.entry, line, len);
+	if (err != IniFile::errorNoError)
+		return resultError;
+	char* cp = line;
+
+	// Build the value at the end of the arena, only keeping it if
+	// everything it refers to is resolved
+	size_t start = _used;
+	err = IniFile::errorBufferTooSmall;
+	bool ok = true;
+	while (ok && *cp) {
+		char* dollar = strchr(cp, '$');
+		if (dollar == NULL || (dollar[1] != '{' && dollar[1] != '$')) {
+			size_t n = (dollar == NULL ? strlen(cp) : dollar + 1 - cp);
+			ok = append(cp, n);
+			cp += n;
+			continue;
+		}
+		ok = append(cp, dollar - cp);
+		if (!ok)
+			break;
+		if (dollar[1] == '$') {
+			ok = append("$", 1);
+			cp = dollar + 2;
+			continue;
+		}
+
+		char* name = dollar + 2;
+		char* end = strchr(name, '}');
+		if (end == NULL) {
+			err = IniFile::errorInterpolationError;
+			ok = false;
+			break;
+		}
+		*end = '\0';
+		cp = end + 1;
+		char* section = NULL;
+		char* colon = strrchr(name, ':');
+		if (colon) {
+			*colon = '\0';
+			section = name;
+			name = colon + 1;
+		}
+
+		const char* str;
+		if (section && strcmp(section, "ENV") == 0) {
+			str = (_environment ? _environment(name) : NULL);
+			if (str == NULL) {
+				err = IniFile::errorInterpolationError;
+				ok = false;
+				break;
+			}
+		}
+		else {
+			IniFile::entry_t n;
+			char* value;
+			IniFile::error_t e2 =
+				(section ? index.findKey(ini, section, name, other, len, n,
+										 &value)
+				 : index.findKey(ini, e.section, name, other, len, n, &value));
+			if (e2 != IniFile::errorNoError) {
+				err = (e2 == IniFile::errorSectionNotFound ||
+					   e2 == IniFile::errorKeyNotFound
+					   ? IniFile::errorInterpolationError : e2);
+				ok = false;
+				break;
+			}
+			IniResolvedValue* r = find(n);
+			if (r && r->offset == unresolved) {
+				_used = start;
+				return resultWaiting;
+			}
+			if (r)
+				str = _arena + r->offset;
+			else {
+				e2 = index.readValue(ini, n, other, len);
+				if (e2 != IniFile::errorNoError) {
+					err = e2;
+					ok = false;
+					break;
+				}
+				str = other;
+			}
+		}
+		ok = append(str, strlen(str));
+	}
+	if (!ok || !append("", 1)) {
+		_used = start;
+		return resultError;
+	}
+	v.offset = start;
+	err = IniFile::errorNoError;
+	return resultResolved;
+}
+
+// Values are in entry order
+IniResolvedValue* IniInterpolation::find(IniFile::entry_t entry) const
+{
+	uint16_t first = 0;
+	uint16_t last = _numValues;
+	while (first < last) {
+		uint16_t mid = first + (last - first) / 2;
+		if (_values[mid].entry < entry)
+			first = mid + 1;
+		else
+			last = mid;
+	}
+	if (first < _numValues && _values[first].entry == entry)
+		return &_values[first];
+	return nullptr;
+}
+
+bool IniInterpolation::append(const char* str, size_t n)
+{
+	if (_used + n > _arenaLen)
+		return false;
+	memcpy(_arena + _used, str, n);
+	_used += n;
+	return true;
+}
@@ -0,0 +1,104 @@
+#ifndef _ININTERPOLATION_H
+#define _ININTERPOLATION_H
+
+#include "IniFile.h"
+
+// A value whose references have been resolved by IniInterpolation
+struct IniResolvedValue {
+	IniFile::entry_t entry; // Index entry number of the key line
+	uint32_t offset;        // Start of the resolved value in the arena
+};
+
+// Resolves references in values once, when the file is loaded, so that
+// looking up a value with references costs no more than any other
+// value. In a value "${key}" is replaced by the value of key in the
+// same section, "${section:key}" by a key in another section (split at
+// the last ':'), "${ENV:name}" by an environment variable, and "$$" by
+// '$'. Referenced values may contain references too.
+//
+// The file must be indexed. The resolved values are stored in the
+// arena, and one IniResolvedValue is needed for each value containing
+// a reference. Attach with IniFile::setInterpolation(); values are then
+// returned resolved by getValue() and all the typed getters. Values are
+// forgotten when the file is opened again, and resolve() must be
+// called again if the index is rebuilt.
+class IniInterpolation {
+public:
+	// Return the value of an environment variable, or NULL
+	typedef const char* (*environment_t)(const char* name);
+
+	static const uint32_t unresolved = 0xFFFFFFFF;
+
+	IniInterpolation(char* arena, size_t arenaLen,
+					 IniResolvedValue* values, uint16_t maxValues);
+
+	// Where "${ENV:name}" is found. On a host operating system the
+	// default is getenv(), elsewhere there is no environment.
+	inline void setEnvironment(environment_t environment);
+
+	// Resolve every value of ini which contains a reference, using
+	// buffer to read lines; each line read must fit in half of it.
+	// Returns errorInterpolationError if a key or variable is not found,
+	// a reference is not closed, or references form a cycle, and
+	// errorBufferTooSmall if the arena or values are too small. In
+	// both cases getErrorLine() gives the line of the value.
+	IniFile::error_t resolve(const IniFile &ini, char* buffer, size_t len);
+
+	// True if resolve() succeeded for ini as it is now
+	bool isValid(const IniFile &ini) const;
+
+	// The resolved value for an index entry, or NULL if the value has
+	// no references
+	const char* getValue(IniFile::entry_t entry) const;
+
+	inline uint16_t getNumValues(void) const;
+	inline size_t getArenaUsed(void) const;
+	inline uint32_t getErrorLine(void) const;
+
+private:
+	enum result_t {
+		resultResolved,
+		resultWaiting, // Needs a value which is not resolved yet
+		resultError,
+	};
+
+	result_t resolveValue(const IniFile &ini, const IniIndex &index,
+						  IniResolvedValue &v, char* line, char* other,
+						  size_t len, IniFile::error_t &err);
+	IniResolvedValue* find(IniFile::entry_t entry) const;
+	bool append(const char* str, size_t n);
+
+	char* _arena;
+	size_t _arenaLen;
+	size_t _used;
+	IniResolvedValue* _values;
+	uint16_t _maxValues;
+	uint16_t _numValues;
+	environment_t _environment;
+	const IniIndex* _index;
+	uint32_t _generation;
+	bool _valid;
+	uint32_t _errorLine;
+};
+
+void IniInterpolation::setEnvironment(environment_t environment)
+{
+	_environment = environment;
+}
+
+uint16_t IniInterpolation::getNumValues(void) const
+{
+	return _numValues;
+}
+
+size_t IniInterpolation::getArenaUsed(void) const
+{
+	return _used;
+}
+
+uint32_t IniInterpolation::getErrorLine(void) const
+{
+	return _errorLine;
+}
+
+#endif
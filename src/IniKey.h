@@ -0,0 +1,47 @@
+#ifndef _INIKEY_H
+#define _INIKEY_H
+
+#include "IniTokenizer.h"
+
+// A section name or key with its length and IniTokenizer::hash()
+// worked out once. Declared constexpr from a string literal the
+// compiler does the work, so a lookup through an index with a hash
+// table (see IniIndex::buildHashTable()) starts with a single probe
+// and no hashing at all:
+//
+//   static constexpr IniKey network("network"), mac("mac");
+//   ini.getValue(network, mac, buffer, len);
+//
+// The string must stay valid while the IniKey is in use.
+class IniKey {
+public:
+	constexpr IniKey(const char* name)
+		: _name(name), _length(length(name, 0)),
+		  _hash(hash(name, IniTokenizer::hashInit)) {
+	}
+
+	constexpr const char* getName(void) const {
+		return _name;
+	}
+	constexpr uint16_t getLength(void) const {
+		return _length;
+	}
+	constexpr uint32_t getHash(void) const {
+		return _hash;
+	}
+
+private:
+	// Recursive, since C++11 constexpr functions cannot loop
+	static constexpr uint16_t length(const char* str, uint16_t n) {
+		return *str ? length(str + 1, n + 1) : n;
+	}
+	static constexpr uint32_t hash(const char* str, uint32_t h) {
+		return *str ? hash(str + 1, IniTokenizer::hashUpdate(h, *str)) : h;
+	}
+
+	const char* _name;
+	uint16_t _length;
+	uint32_t _hash;
+};
+
+#endif
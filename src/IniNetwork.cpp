@@ -0,0 +1,188 @@
+#include "IniNetwork.h"
+
+#include <string.h>
+
+const char* IniNetwork::parseIPv4(const char* str, uint8_t ip[4])
+{
+	const char* cp = str;
+	for (int i = 0; i < 4; ++i) {
+		if (i && *cp++ != '.')
+			return NULL;
+		uint16_t val = 0;
+		int digits = 0;
+		while (*cp >= '0' && *cp <= '9') {
+			val = val * 10 + (*cp++ - '0');
+			if (++digits > 3)
+				return NULL;
+		}
+		if (digits == 0 || val > 255)
+			return NULL;
+		ip[i] = val;
+	}
+	return cp;
+}
+
+const char* IniNetwork::parseIPv6(const char* str, uint8_t ip[16])
+{
+	uint16_t words[8];
+	int n = 0;
+	int gap = -1; // Number of groups before "::"
+	const char* cp = str;
+
+	bool more = true;
+	if (*cp == ':') {
+		if (cp[1] != ':')
+			return NULL;
+		gap = 0;
+		cp += 2;
+		more = (hexValue(*cp) >= 0);
+	}
+	while (more) {
+		const char* group = cp;
+		uint16_t val = 0;
+		int digits = 0;
+		int h;
+		while ((h = hexValue(*cp)) >= 0) {
+			val = val * 16 + h;
+			++cp;
+			if (++digits > 4)
+				break;
+		}
+		if (*cp == '.') {
+			// The last 32 bits as an IPv4 address
+			if (n > 6)
+				return NULL;
+			uint8_t v4[4];
+			cp = parseIPv4(group, v4);
+			if (cp == NULL)
+				return NULL;
+			words[n++] = (v4[0] << 8) | v4[1];
+			words[n++] = (v4[2] << 8) | v4[3];
+			break;
+		}
+		if (digits == 0 || digits > 4 || n == 8)
+			return NULL;
+		words[n++] = val;
+		if (*cp != ':')
+			break;
+		++cp;
+		if (*cp == ':') {
+			if (gap >= 0)
+				return NULL; // Only one "::" allowed
+			gap = n;
+			++cp;
+			more = (hexValue(*cp) >= 0);
+		}
+		else if (hexValue(*cp) < 0)
+			return NULL; // A single ':' must be followed by a group
+	}
+	if (gap < 0 ? n != 8 : n > 7)
+		return NULL;
+
+	// Groups after "::" go at the end
+	memset(ip, 0, 16);
+	int head = (gap < 0 ? n : gap);
+	for (int i = 0; i < n; ++i) {
+		int j = (i < head ? i : 8 - n + i);
+		ip[2 * j] = words[i] >> 8;
+		ip[2 * j + 1] = words[i] & 0xFF;
+	}
+	return cp;
+}
+
+bool IniNetwork::parseAddress(const char* str, IniNetAddress &addr)
+{
+	// Both parsers stop at the first character which cannot be part of
+	// the address, so an IPv6 address fails as IPv4 within a few
+	// characters
+	const char* cp = parseIPv4(str, addr.addr);
+	uint8_t maxPrefix = 32;
+	addr.family = IniNetAddress::familyIPv4;
+	if (cp == NULL) {
+		cp = parseIPv6(str, addr.addr);
+		if (cp == NULL)
+			return false;
+		maxPrefix = 128;
+		addr.family = IniNetAddress::familyIPv6;
+	}
+	else
+		memset(addr.addr + 4, 0, 12);
+
+	addr.prefix = maxPrefix;
+	if (*cp == '/') {
+		++cp;
+		uint16_t val = 0;
+		int digits = 0;
+		while (*cp >= '0' && *cp <= '9') {
+			val = val * 10 + (*cp++ - '0');
+			if (++digits > 3)
+				return false;
+		}
+		if (digits == 0 || val > maxPrefix)
+			return false;
+		addr.prefix = val;
+	}
+	return *cp == '\0';
+}
+
+char* IniNetwork::parseHostPort(char* str, uint16_t &port)
+{
+	char* host = str;
+	char* cp;
+	if (*str == '[') {
+		host = str + 1;
+		cp = strchr(host, ']');
+		if (cp == NULL)
+			return NULL;
+		*cp++ = '\0';
+		if (*cp != ':' && *cp != '\0')
+			return NULL;
+	}
+	else {
+		cp = strchr(str, ':');
+		if (cp != NULL && strchr(cp + 1, ':') != NULL)
+			cp = NULL; // IPv6 address
+	}
+	if (*host == '\0')
+		return NULL;
+	if (cp == NULL || *cp == '\0')
+		return host;
+
+	*cp++ = '\0';
+	uint32_t val = 0;
+	int digits = 0;
+	while (*cp >= '0' && *cp <= '9') {
+		val = val * 10 + (*cp++ - '0');
+		if (++digits > 5)
+			return NULL;
+	}
+	if (digits == 0 || val > 0xFFFF || *cp != '\0')
+		return NULL;
+	port = val;
+	return host;
+}
+
+bool IniNetwork::contains(const IniNetAddress &net, const IniNetAddress &addr)
+{
+	if (net.family != addr.family)
+		return false;
+	uint8_t bytes = net.prefix / 8;
+	if (memcmp(net.addr, addr.addr, bytes) != 0)
+		return false;
+	uint8_t bits = net.prefix % 8;
+	if (bits == 0)
+		return true;
+	uint8_t mask = 0xFF << (8 - bits);
+	return ((net.addr[bytes] ^ addr.addr[bytes]) & mask) == 0;
+}
+
+int IniNetwork::hexValue(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
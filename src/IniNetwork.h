@@ -0,0 +1,50 @@
+#ifndef _ININETWORK_H
+#define _ININETWORK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// An IPv4 or IPv6 address, with the prefix length of a network
+struct IniNetAddress {
+	enum family_t {
+		familyIPv4 = 4,
+		familyIPv6 = 6,
+	};
+
+	uint8_t family;
+	uint8_t prefix;    // 32 or 128 when no prefix was given
+	uint8_t addr[16];  // Network byte order, IPv4 uses the first 4 bytes
+};
+
+// Parsers for network values, which check the value as they convert
+// it in a single pass, without copying. Each returns NULL if the value
+// is not valid.
+class IniNetwork {
+public:
+	// Dotted IPv4 address, exactly 4 decimal parts of 0 to 255.
+	// Returns a pointer to the character after the address.
+	static const char* parseIPv4(const char* str, uint8_t ip[4]);
+
+	// IPv6 address of 8 hex groups, where one run of zero groups may be
+	// written as "::" and the last 2 groups may be an IPv4 address.
+	// Returns a pointer to the character after the address.
+	static const char* parseIPv6(const char* str, uint8_t ip[16]);
+
+	// An IPv4 or IPv6 address with an optional "/prefix" which must be
+	// the whole of str
+	static bool parseAddress(const char* str, IniNetAddress &addr);
+
+	// Split "host:port", "[IPv6 address]:port" or just a host in place.
+	// Returns the host, or NULL if it is empty or the port is not
+	// valid. port is unchanged if there is none, so it can be set to a
+	// default first. An IPv6 address without brackets has no port.
+	static char* parseHostPort(char* str, uint16_t &port);
+
+	// True if addr is of the same family as net and within its prefix
+	static bool contains(const IniNetAddress &net, const IniNetAddress &addr);
+
+private:
+	static int hexValue(char c);
+};
+
+#endif
@@ -0,0 +1,460 @@
+#include "IniPatch.h"
+
+#include <string.h>
+
+#if defined(INIFILE_HOST)
+#include <string>
+#include <utility>
+#include <vector>
+#endif
+
+static const uint32_t noPosition = 0xFFFFFFFF;
+
+IniPatch::IniPatch(const IniFile &patch) : _patch(patch)
+{
+	_ini = nullptr;
+	_out = nullptr;
+	_error = IniFile::errorNoError;
+}
+
+IniFile::error_t IniPatch::apply(const IniFile &ini, IniWriter &out,
+								 char* buffer, size_t len)
+{
+	_ini = &ini;
+	_out = &out;
+	_third = len / 3;
+	_line = buffer;
+	_section = buffer + _third;
+	_patchLine = buffer + 2 * _third;
+	_error = IniFile::errorNoError;
+	_inSection = false;
+	_keysStart = 0;
+	_unterminated = noPosition;
+	_needNewline = false;
+	if (_third < 3)
+		return IniFile::errorBufferTooSmall;
+	if ((ini.getSyntax() | _patch.getSyntax()) & IniFile::syntaxContinuation)
+		return IniFile::errorPatchError;
+
+	// What happens to the current section, and where the lines which
+	// follow its last key start. Those are copied once it is known
+	// whether keys are to be added before them.
+	uint8_t change = scanSection(NULL);
+	uint32_t pending = noPosition;
+	uint32_t pos = 0;
+	while (change != lineError) {
+		uint32_t start = pos;
+		IniFile::error_t err = ini.readLine(_line, _third, pos);
+		bool atEnd = (err == IniFile::errorEndOfFile);
+		if (atEnd) {
+			if (_line[0] == '\0')
+				break;
+			pos = start + strlen(_line);
+			_unterminated = pos;
+		}
+		else if (err != IniFile::errorNoError)
+			return err;
+
+		char* cp = IniFile::skipWhiteSpace(_line);
+		char* key;
+		char* value;
+		if (*cp == '[') {
+			// Finish the section before, which needs the line buffer
+			if (change == lineSet && !addKeys(start))
+				return getError();
+			if (change != lineRemoveSection && pending != noPosition &&
+				!copy(pending, start))
+				return getError();
+			pending = noPosition;
+			pos = start;
+			ini.readLine(_line, _third, pos);
+			if (atEnd)
+				pos = start + strlen(_line);
+
+			char* name = IniFile::parseSection(IniFile::skipWhiteSpace(_line));
+			_inSection = true;
+			_keysStart = pos;
+			// Keys after a bad section line cannot be found
+			change = lineNone;
+			if (name) {
+				strcpy(_section, name);
+				change = scanSection(_section);
+			}
+			if (change != lineRemoveSection && !copy(start, pos))
+				return getError();
+		}
+		else if (change == lineRemoveSection)
+			; // Dropped with its section
+		else if (change == lineNone) {
+			if (!copy(start, pos))
+				return getError();
+		}
+		else if (*cp == '\0' || IniFile::isCommentChar(*cp) ||
+				 (key = IniFile::parseKey(cp, &value)) == NULL) {
+			if (pending == noPosition)
+				pending = start;
+		}
+		else {
+			if (pending != noPosition && !copy(pending, start))
+				return getError();
+			pending = noPosition;
+			uint8_t op = find(_inSection ? _section : NULL, key, &value);
+			if (op == lineError)
+				return _error;
+			if (op == lineSet &&
+				!(startLine() && out.writeValue(key, value)))
+				return getError();
+			if (op == lineNone && !copy(start, pos))
+				return getError();
+		}
+		if (atEnd)
+			break;
+	}
+	if (change == lineError)
+		return _error;
+
+	if (change == lineSet && !addKeys(pos))
+		return getError();
+	if (change != lineRemoveSection && pending != noPosition &&
+		!copy(pending, pos))
+		return getError();
+	addSections();
+	return getError();
+}
+
+uint8_t IniPatch::parseLine(char* line, bool trim, char** name,
+						   char** value)
+{
+	char* cp = IniFile::skipWhiteSpace(line);
+	if (*cp == '\0' || IniFile::isCommentChar(*cp))
+		return lineNone;
+	if (*cp == '-' && strchr(cp, '=') == NULL) {
+		cp = IniFile::skipWhiteSpace(cp + 1);
+		if (*cp == '[') {
+			*name = IniFile::parseSection(cp);
+			return (*name ? lineRemoveSection : lineError);
+		}
+		IniFile::removeTrailingWhiteSpace(cp);
+		*name = cp;
+		return (*cp ? lineRemove : lineError);
+	}
+	if (*cp == '[') {
+		*name = IniFile::parseSection(cp);
+		return (*name ? lineSection : lineBadSection);
+	}
+	*name = IniFile::parseKey(cp, value);
+	if (*name == NULL)
+		return lineError;
+	*value = IniFile::skipWhiteSpace(*value);
+	if (trim)
+		IniFile::removeTrailingWhiteSpace(*value);
+	return lineSet;
+}
+
+uint8_t IniPatch::nextLine(uint32_t &pos, char** name, char** value)
+{
+	uint32_t start = pos;
+	IniFile::error_t err = _patch.readLine(_patchLine, _third, pos);
+	if (err == IniFile::errorEndOfFile) {
+		if (_patchLine[0] == '\0')
+			return lineEnd;
+		pos = start + strlen(_patchLine);
+	}
+	else if (err != IniFile::errorNoError) {
+		_error = err;
+		return lineError;
+	}
+	uint8_t type = parseLine(_patchLine,
+							 !(_patch.getSyntax() & IniFile::syntaxQuotes),
+							 name, value);
+	if (type == lineError || type == lineBadSection) {
+		_error = IniFile::errorPatchError;
+		return lineError;
+	}
+	return type;
+}
+
+uint8_t IniPatch::find(const char* section, const char* key, char** value)
+{
+	bool inSection = (section == NULL);
+	uint32_t pos = 0;
+	while (true) {
+		char* name;
+		uint8_t type = nextLine(pos, &name, value);
+		switch (type) {
+		case lineEnd:
+			return lineNone;
+		case lineError:
+			return lineError;
+		case lineSection:
+			inSection = (section && _ini->matchName(name, section));
+			break;
+		case lineSet:
+		case lineRemove:
+			if (inSection && _ini->matchName(name, key))
+				return type;
+			break;
+		}
+	}
+}
+
+uint8_t IniPatch::scanSection(const char* section)
+{
+	bool inSection = (section == NULL);
+	uint8_t change = lineNone;
+	uint32_t pos = 0;
+	while (true) {
+		char* name;
+		char* value;
+		uint8_t type = nextLine(pos, &name, &value);
+		switch (type) {
+		case lineEnd:
+			return change;
+		case lineError:
+			return lineError;
+		case lineSection:
+			inSection = (section && _ini->matchName(name, section));
+			break;
+		case lineRemoveSection:
+			if (section && _ini->matchName(name, section))
+				return lineRemoveSection;
+			break;
+		case lineSet:
+		case lineRemove:
+			if (inSection)
+				change = lineSet;
+			break;
+		}
+	}
+}
+
+bool IniPatch::addKeys(uint32_t end)
+{
+	bool inSection = !_inSection;
+	uint32_t patchPos = 0;
+	while (true) {
+		char* name;
+		char* value;
+		uint8_t type = nextLine(patchPos, &name, &value);
+		if (type == lineEnd)
+			return true;
+		if (type == lineError)
+			return false;
+		if (type == lineSection)
+			inSection = (_inSection && _ini->matchName(name, _section));
+		if (type != lineSet || !inSection)
+			continue;
+
+		// Keys already in the section were changed where they are
+		bool found = false;
+		uint32_t pos = _keysStart;
+		while (!found && pos < end) {
+			IniFile::error_t err = _ini->readLine(_line, _third, pos);
+			if (err != IniFile::errorNoError &&
+				err != IniFile::errorEndOfFile) {
+				_error = err;
+				return false;
+			}
+			char* lineValue;
+			char* key = IniFile::parseKey(IniFile::skipWhiteSpace(_line),
+										  &lineValue);
+			found = (key && _ini->matchName(key, name));
+			if (err == IniFile::errorEndOfFile)
+				break;
+		}
+		if (!found && !(startLine() && _out->writeValue(name, value)))
+			return false;
+	}
+}
+
+bool IniPatch::addSections(void)
+{
+	bool adding = false;
+	uint32_t patchPos = 0;
+	while (true) {
+		uint32_t start = patchPos;
+		char* name;
+		char* value;
+		uint8_t type = nextLine(patchPos, &name, &value);
+		if (type == lineEnd)
+			return true;
+		if (type == lineError)
+			return false;
+		if (type == lineSection) {
+			// Only the first section of each name in the patch is used
+			strcpy(_section, name);
+			adding = (!hasSection(*_ini, noPosition, _section, _line) &&
+					  !hasSection(_patch, start, _section, _line));
+			if (_error != IniFile::errorNoError)
+				return false;
+			if (adding && !(startLine() &&
+							(_out->getPosition() == 0 ||
+							 _out->writeBlankLine()) &&
+							_out->writeSection(_section)))
+				return false;
+		}
+		else if (type == lineSet && adding &&
+				 !_out->writeValue(name, value))
+			return false;
+	}
+}
+
+bool IniPatch::hasSection(const IniFile &file, uint32_t end,
+						  const char* section, char* buffer)
+{
+	uint32_t pos = 0;
+	while (pos < end) {
+		IniFile::error_t err = file.readLine(buffer, _third, pos);
+		if (err != IniFile::errorNoError && err != IniFile::errorEndOfFile) {
+			_error = err;
+			return false;
+		}
+		char* cp = IniFile::skipWhiteSpace(buffer);
+		if (*cp == '[' && (cp = IniFile::parseSection(cp)) != NULL &&
+			_ini->matchName(cp, section))
+			return true;
+		if (err == IniFile::errorEndOfFile)
+			break;
+	}
+	return false;
+}
+
+bool IniPatch::copy(uint32_t start, uint32_t end)
+{
+	if (start == end)
+		return true;
+	_needNewline = (end == _unterminated);
+	return _out->copy(*_ini, start, end);
+}
+
+bool IniPatch::startLine(void)
+{
+	if (!_needNewline)
+		return true;
+	_needNewline = false;
+	return _out->write("\n");
+}
+
+IniFile::error_t IniPatch::getError(void) const
+{
+	return (_error != IniFile::errorNoError ? _error : _out->getError());
+}
+
+#if defined(INIFILE_HOST)
+// A section as lookups see it: only the first section of each name and
+// the first of each key in it are found
+struct IniPatchSection {
+	std::string name;
+	std::vector<std::pair<std::string, std::string> > keys;
+};
+
+static int findSection(const IniFile &ini,
+					   const std::vector<IniPatchSection> &sections,
+					   const char* name)
+{
+	// The first entry holds the keys before any section
+	for (size_t i = 1; i < sections.size(); ++i)
+		if (ini.matchName(sections[i].name.c_str(), name))
+			return i;
+	return -1;
+}
+
+static int findKey(const IniFile &ini, const IniPatchSection &section,
+				   const char* key)
+{
+	for (size_t i = 0; i < section.keys.size(); ++i)
+		if (ini.matchName(section.keys[i].first.c_str(), key))
+			return i;
+	return -1;
+}
+
+static IniFile::error_t readSections(const IniFile &ini, char* buffer,
+									 size_t len,
+									 std::vector<IniPatchSection> &sections)
+{
+	sections.assign(1, IniPatchSection());
+	int current = 0;
+	uint32_t pos = 0;
+	while (true) {
+		IniFile::error_t err = ini.readLine(buffer, len, pos);
+		if (err != IniFile::errorNoError && err != IniFile::errorEndOfFile)
+			return err;
+		char* cp = IniFile::skipWhiteSpace(buffer);
+		char* value;
+		if (*cp == '[') {
+			// Keys after a bad section or a later section of the same
+			// name cannot be found
+			char* name = IniFile::parseSection(cp);
+			current = -1;
+			if (name && findSection(ini, sections, name) < 0) {
+				sections.push_back(IniPatchSection());
+				sections.back().name = name;
+				current = sections.size() - 1;
+			}
+		}
+		else if (current >= 0 && !IniFile::isCommentChar(*cp) &&
+				 (cp = IniFile::parseKey(cp, &value)) != NULL && *cp &&
+				 findKey(ini, sections[current], cp) < 0) {
+			// Whitespace at the end is part of an unclosed quote
+			value = IniFile::skipWhiteSpace(value);
+			if (!(ini.getSyntax() & IniFile::syntaxQuotes))
+				IniFile::removeTrailingWhiteSpace(value);
+			sections[current].keys.push_back(std::make_pair(cp, value));
+		}
+		if (err == IniFile::errorEndOfFile)
+			return IniFile::errorNoError;
+	}
+}
+
+IniFile::error_t IniPatch::diff(const IniFile &from, const IniFile &to,
+								IniWriter &out, char* buffer, size_t len)
+{
+	if ((from.getSyntax() | to.getSyntax()) & IniFile::syntaxContinuation)
+		return IniFile::errorPatchError;
+	std::vector<IniPatchSection> a, b;
+	IniFile::error_t err = readSections(from, buffer, len, a);
+	if (err == IniFile::errorNoError)
+		err = readSections(to, buffer, len, b);
+	if (err != IniFile::errorNoError)
+		return err;
+
+	// Keys before any section come first, with no section line
+	for (size_t i = 0; i < b.size(); ++i) {
+		const IniPatchSection &s = b[i];
+		int j = (i ? findSection(from, a, s.name.c_str()) : 0);
+		bool started = (i == 0);
+		if (j < 0) {
+			out.writeSection(s.name.c_str());
+			for (size_t k = 0; k < s.keys.size(); ++k)
+				out.writeValue(s.keys[k].first.c_str(),
+							   s.keys[k].second.c_str());
+			continue;
+		}
+		const IniPatchSection &old = a[j];
+		for (size_t k = 0; k < s.keys.size(); ++k) {
+			int n = findKey(from, old, s.keys[k].first.c_str());
+			if (n >= 0 && old.keys[n].second == s.keys[k].second)
+				continue;
+			if (!started)
+				started = out.writeSection(s.name.c_str());
+			out.writeValue(s.keys[k].first.c_str(), s.keys[k].second.c_str());
+		}
+		for (size_t k = 0; k < old.keys.size(); ++k) {
+			if (findKey(from, s, old.keys[k].first.c_str()) >= 0)
+				continue;
+			if (!started)
+				started = out.writeSection(s.name.c_str());
+			out.write("-");
+			out.write(old.keys[k].first.c_str());
+			out.write("\n");
+		}
+	}
+	for (size_t i = 1; i < a.size(); ++i)
+		if (findSection(from, b, a[i].name.c_str()) < 0) {
+			out.write("-[");
+			out.write(a[i].name.c_str());
+			out.write("]\n");
+		}
+	return out.getError();
+}
+#endif
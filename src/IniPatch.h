@@ -0,0 +1,98 @@
+#ifndef _INIPATCH_H
+#define _INIPATCH_H
+
+#include "IniFile.h"
+#include "IniWriter.h"
+
+// The changes from one version of an ini file to another, by section
+// and key. A patch is itself an ini file, so it is sent and stored
+// like one. Keys before any section line change keys before the first
+// section. A key with a value is added or changed, a key after '-' is
+// removed and a section after '-' is removed with all of its keys:
+//
+//   version = 3
+//   [network]
+//   ip = 192.168.1.3
+//   -gateway
+//   -[old section]
+//
+// Applying a patch copies the file once, in order. Only the lines of
+// keys which change are rewritten; comments, blank lines and
+// everything else are copied as they are. Keys added to a section go
+// after its last key and new sections at the end of the file.
+// Afterwards every lookup with a section, and of keys before the first
+// section, gives the same result as the new version of the file.
+// The patch is read with the same syntax as the file, and files using
+// syntaxContinuation cannot be patched.
+class IniPatch {
+public:
+	explicit IniPatch(const IniFile &patch);
+
+	// Copy ini to out with the patch applied. buffer is split in three,
+	// for lines of ini, a section name and lines of the patch, and each
+	// third must hold the longest line. Returns errorPatchError if a
+	// line of the patch is not understood.
+	IniFile::error_t apply(const IniFile &ini, IniWriter &out, char* buffer,
+						   size_t len);
+
+#if defined(INIFILE_HOST)
+	// Write the patch which changes from into to. Values are compared
+	// as written, so a value written differently counts as changed.
+	// Each line must fit in buffer.
+	static IniFile::error_t diff(const IniFile &from, const IniFile &to,
+								 IniWriter &out, char* buffer, size_t len);
+#endif
+
+private:
+	enum {
+		lineNone = 0, // Blank or comment
+		lineSection,
+		lineBadSection,
+		lineRemoveSection,
+		lineSet,
+		lineRemove,
+		lineError,
+		lineEnd,
+	};
+
+	// Classify a line of the patch, splitting it in place. Whitespace
+	// after a value is removed if trim is true.
+	static uint8_t parseLine(char* line, bool trim, char** name,
+							 char** value);
+	// Read and classify the line of the patch at pos, moving pos on.
+	// Returns lineError, with _error set, if it cannot be used.
+	uint8_t nextLine(uint32_t &pos, char** name, char** value);
+	// The change to key in section (NULL before the first section):
+	// lineSet, lineRemove or lineNone
+	uint8_t find(const char* section, const char* key, char** value);
+	// lineRemoveSection if section is removed, lineSet if any of its
+	// keys change, otherwise lineNone
+	uint8_t scanSection(const char* section);
+	// Write the keys set in the current section which are not in the
+	// file between _keysStart and end
+	bool addKeys(uint32_t end);
+	// Write the sections of the patch which the file does not have
+	bool addSections(void);
+	// Whether file has section before end, reading lines into buffer
+	bool hasSection(const IniFile &file, uint32_t end, const char* section,
+					char* buffer);
+	bool copy(uint32_t start, uint32_t end);
+	// Make sure that a line written now starts a line of its own
+	bool startLine(void);
+	IniFile::error_t getError(void) const;
+
+	const IniFile &_patch;
+	const IniFile* _ini;
+	IniWriter* _out;
+	char* _line;
+	char* _section;
+	char* _patchLine;
+	size_t _third;
+	IniFile::error_t _error;
+	bool _inSection;        // False before the first section line
+	uint32_t _keysStart;    // Line after the current section line
+	uint32_t _unterminated; // End of a last line with no newline
+	bool _needNewline;
+};
+
+#endif
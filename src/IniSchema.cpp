@@ -0,0 +1,175 @@
+#include "IniSchema.h"
+#include "IniTokenizer.h"
+
+#include <string.h>
+
+IniSchema::IniSchema(const IniSchemaKey* keys, IniSchemaValue* values,
+					 uint16_t numKeys)
+	: _keys(keys), _values(values), _numKeys(numKeys)
+{
+	begin();
+}
+
+void IniSchema::begin(void)
+{
+	memset(_values, 0, _numKeys * sizeof(IniSchemaValue));
+	for (uint16_t n = 0; n < _numKeys; ++n)
+		_values[n].keyHash = IniTokenizer::hash(_keys[n].key);
+	_numMissing = 0;
+	_numInvalid = 0;
+}
+
+void IniSchema::startSection(const IniFile &ini, const char* name)
+{
+	// Only the first section of a name is searched, as by getValue()
+	for (uint16_t n = 0; n < _numKeys; ++n) {
+		IniSchemaValue &v = _values[n];
+		if (_keys[n].section == NULL)
+			continue;
+		if (v.sectionState == sectionCurrent)
+			v.sectionState = sectionDone;
+		else if (v.sectionState == sectionWaiting && name &&
+				 ini.matchName(name, _keys[n].section))
+			v.sectionState = sectionCurrent;
+	}
+}
+
+uint16_t IniSchema::findKey(const IniFile &ini, const char* key,
+							uint32_t hash, uint16_t n) const
+{
+	for (; n < _numKeys; ++n) {
+		const IniSchemaValue &v = _values[n];
+		if (v.status == statusMissing && v.keyHash == hash &&
+			(_keys[n].section == NULL || v.sectionState == sectionCurrent) &&
+			ini.matchName(key, _keys[n].key))
+			break;
+	}
+	return n;
+}
+
+void IniSchema::setValue(const IniFile &ini, uint16_t n, const char* str,
+						 uint32_t line, uint32_t position)
+{
+	IniSchemaValue &v = _values[n];
+	v.status = statusInvalid;
+	if (str)
+		v.status = convert(ini, _keys[n], str, v);
+	v.line = line;
+	if (_keys[n].type == typeString)
+		v.value.position = position;
+}
+
+void IniSchema::finish(const IniFile &ini)
+{
+	for (uint16_t n = 0; n < _numKeys; ++n) {
+		const IniSchemaKey &k = _keys[n];
+		IniSchemaValue &v = _values[n];
+		if (v.status == statusMissing) {
+			if (k.flags & flagRequired)
+				++_numMissing;
+			else if (k.defaultValue) {
+				v.status = convert(ini, k, k.defaultValue, v);
+				if (v.status == statusValid)
+					v.status = statusDefault;
+			}
+		}
+		if (v.status == statusInvalid || v.status == statusOutOfRange)
+			++_numInvalid;
+	}
+}
+
+uint8_t IniSchema::convert(const IniFile &ini, const IniSchemaKey &k,
+						   const char* str, IniSchemaValue &v) const
+{
+	bool inRange = true;
+	switch (k.type) {
+	case typeString: {
+		long n = strlen(str);
+		inRange = (n >= k.min && n <= k.max);
+		break;
+	}
+
+	case typeBool:
+		if (!IniFile::parseBool(str, v.value.b))
+			return statusInvalid;
+		break;
+
+	case typeLong:
+		if (!IniFile::parseLong(str, v.value.l))
+			return statusInvalid;
+		inRange = (v.value.l >= k.min && v.value.l <= k.max);
+		break;
+
+	case typeDouble:
+		if (!IniFile::parseDouble(str, v.value.d))
+			return statusInvalid;
+		inRange = (v.value.d >= k.min && v.value.d <= k.max);
+		break;
+
+	case typeChoice: {
+		const char* cp = k.choices;
+		for (uint16_t i = 0; cp; ++i) {
+			const char* end = strchr(cp, '|');
+			size_t n = (end ? size_t(end - cp) : strlen(cp));
+			if (ini.matchName(str, cp, n)) {
+				v.value.choice = i;
+				return statusValid;
+			}
+			cp = (end ? end + 1 : NULL);
+		}
+		return statusInvalid;
+	}
+
+	case typeIPAddress:
+		if (!IniFile::parseIPAddress(str, v.value.bytes))
+			return statusInvalid;
+		break;
+
+	case typeMACAddress:
+		if (!IniFile::parseMACAddress(str, v.value.bytes))
+			return statusInvalid;
+		break;
+
+	default:
+		return statusInvalid;
+	}
+	if ((k.flags & flagRange) && !inRange)
+		return statusOutOfRange;
+	return statusValid;
+}
+
+bool IniSchema::getString(const IniFile &ini, uint16_t n, char* buffer,
+						  size_t len) const
+{
+	const IniSchemaValue &v = _values[n];
+	if (_keys[n].type != typeString || v.status == statusMissing ||
+		v.status == statusInvalid)
+		return false;
+	if (v.status == statusDefault) {
+		if (strlen(_keys[n].defaultValue) >= len)
+			return false;
+		strcpy(buffer, _keys[n].defaultValue);
+		return true;
+	}
+
+	// Read the key line again and take the value as getValue() would
+	uint32_t pos = v.value.position;
+	IniFile::error_t err = ini.readLine(buffer, len, pos);
+	if (err == IniFile::errorEndOfFile)
+		pos = v.value.position + strlen(buffer);
+	else if (err != IniFile::errorNoError)
+		return false;
+	char* value;
+	if (IniFile::parseKey(IniFile::skipWhiteSpace(buffer), &value) == NULL)
+		return false;
+	if (ini.getSyntax()) {
+		if (ini.readValue(buffer, len, value, pos) != IniFile::errorNoError)
+			return false;
+	}
+	else {
+		value = IniFile::skipWhiteSpace(value);
+		IniFile::removeTrailingWhiteSpace(value);
+	}
+	memmove(buffer, value, strlen(value) + 1);
+	return true;
+}
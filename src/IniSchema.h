@@ -0,0 +1,146 @@
+#ifndef _INISCHEMA_H
+#define _INISCHEMA_H
+
+#include "IniFile.h"
+
+// One key expected by an IniSchema, usually one of a const array
+struct IniSchemaKey {
+	const char* section; // NULL for the first key anywhere, as getValue()
+	const char* key;
+	uint8_t type;        // IniSchema::typeString, typeBool, ...
+	uint8_t flags;       // IniSchema::flagRequired and flagRange
+	// With flagRange, the lowest and highest typeLong or typeDouble
+	// value, or the shortest and longest typeString value
+	long min;
+	long max;
+	const char* choices; // For typeChoice the values allowed, eg "off|on"
+	// Converted for a missing key which is not required, or NULL
+	const char* defaultValue;
+};
+
+// What IniSchema found for one key
+struct IniSchemaValue {
+	uint8_t status; // IniSchema::statusMissing, statusValid, ...
+	uint32_t line;  // Line number of the key, zero if not in the file
+	union {
+		bool b;
+		long l;
+		double d;
+		uint16_t choice;   // Which of the choices, from 0
+		uint8_t bytes[6];  // IP or MAC address
+		uint32_t position; // Start of the key line, for typeString
+	} value;
+
+	// Used while checking the file
+	uint32_t keyHash;
+	uint8_t sectionState;
+};
+
+// Checks every key an application uses in one pass over the file,
+// instead of a lookup for each, and converts the values into a table
+// of results supplied by the user, one for each key of the schema.
+// Afterwards the results give the type, whether each key was found, is
+// missing or has a value which is not valid, with its line number.
+// Keys are found as IniFile::getValue() finds them: in the first
+// section of the name, and the first of the name in that section.
+// Values are converted strictly, so "12abc" is not a number. Values of
+// typeString are not copied; getString() reads them again, directly
+// from their line.
+class IniSchema {
+public:
+	enum {
+		typeString = 0,
+		typeBool,
+		typeLong,
+		typeDouble,
+		typeChoice,
+		typeIPAddress,
+		typeMACAddress,
+	};
+	enum {
+		statusMissing = 0,
+		statusDefault,    // Missing, so the default was used
+		statusValid,
+		statusInvalid,    // Could not be converted, or not a choice
+		statusOutOfRange,
+	};
+	static const uint8_t flagRequired = 1;
+	static const uint8_t flagRange = 2;
+
+	IniSchema(const IniSchemaKey* keys, IniSchemaValue* values,
+			  uint16_t numKeys);
+
+	inline uint16_t getNumKeys(void) const;
+	inline const IniSchemaKey& getKey(uint16_t n) const;
+	inline const IniSchemaValue& getValue(uint16_t n) const;
+
+	// Keys which are required but missing, and keys whose value (or
+	// default) is invalid or out of range
+	inline uint16_t getNumMissing(void) const;
+	inline uint16_t getNumInvalid(void) const;
+	inline bool isValid(void) const;
+
+	// Read the value of typeString key n, or its default, into buffer
+	bool getString(const IniFile &ini, uint16_t n, char* buffer,
+				   size_t len) const;
+
+private:
+	enum {
+		sectionWaiting = 0,
+		sectionCurrent,
+		sectionDone,
+	};
+
+	void begin(void);
+	// Called for each section line, with NULL for a bad one
+	void startSection(const IniFile &ini, const char* name);
+	// The next key from n which is waiting for key in the current
+	// section, or getNumKeys()
+	uint16_t findKey(const IniFile &ini, const char* key, uint32_t hash,
+					 uint16_t n) const;
+	void setValue(const IniFile &ini, uint16_t n, const char* str,
+				  uint32_t line, uint32_t position);
+	void finish(const IniFile &ini);
+	uint8_t convert(const IniFile &ini, const IniSchemaKey &k,
+					const char* str, IniSchemaValue &v) const;
+
+	const IniSchemaKey* _keys;
+	IniSchemaValue* _values;
+	uint16_t _numKeys;
+	uint16_t _numMissing;
+	uint16_t _numInvalid;
+
+	friend class IniFile;
+};
+
+uint16_t IniSchema::getNumKeys(void) const
+{
+	return _numKeys;
+}
+
+const IniSchemaKey& IniSchema::getKey(uint16_t n) const
+{
+	return _keys[n];
+}
+
+const IniSchemaValue& IniSchema::getValue(uint16_t n) const
+{
+	return _values[n];
+}
+
+uint16_t IniSchema::getNumMissing(void) const
+{
+	return _numMissing;
+}
+
+uint16_t IniSchema::getNumInvalid(void) const
+{
+	return _numInvalid;
+}
+
+bool IniSchema::isValid(void) const
+{
+	return _numMissing == 0 && _numInvalid == 0;
+}
+
+#endif
@@ -0,0 +1,105 @@
+#include "IniSparseIndex.h"
+
+IniSparseIndex::IniSparseIndex(IniCheckpoint* checkpoints,
+							   uint16_t maxCheckpoints,
+							   uint16_t sectionsPerCheckpoint)
+{
+	_checkpoints = checkpoints;
+	_maxCheckpoints = (checkpoints == nullptr ? 0 : maxCheckpoints);
+	_initialPerCheckpoint = (sectionsPerCheckpoint ? sectionsPerCheckpoint
+							 : 1);
+	clear();
+}
+
+IniFile::error_t IniSparseIndex::build(const IniFile &ini, char* buffer,
+									   size_t len)
+{
+	clear();
+	if (_maxCheckpoints == 0)
+		return IniFile::errorBufferTooSmall;
+	IniTokenizer tokenizer;
+	tokenizer.setSyntax(ini.getSyntax());
+	uint32_t pos = 0;
+	while (true) {
+		size_t bytesRead;
+		IniFile::error_t err = ini.read(pos, buffer, len, bytesRead);
+		if (err == IniFile::errorEndOfFile)
+			break;
+		if (err != IniFile::errorNoError)
+			return err;
+		pos += bytesRead;
+
+		const char* cp = buffer;
+		while (bytesRead) {
+			size_t used = tokenizer.scan(cp, bytesRead);
+			cp += used;
+			bytesRead -= used;
+			if (tokenizer.lineReady())
+				add(tokenizer.getLine());
+		}
+	}
+	tokenizer.finish();
+	if (tokenizer.lineReady())
+		add(tokenizer.getLine());
+
+	_end = pos;
+	_valid = true;
+	return IniFile::errorNoError;
+}
+
+void IniSparseIndex::clear(void)
+{
+	_numCheckpoints = 0;
+	_sectionsPerCheckpoint = _initialPerCheckpoint;
+	_sectionsInLast = 0;
+	_end = 0;
+	_valid = false;
+}
+
+uint16_t IniSparseIndex::find(uint32_t hash, uint16_t n) const
+{
+	uint16_t bits = filterBits(hash);
+	for (; n < _numCheckpoints; ++n)
+		if ((_checkpoints[n].sections & bits) == bits)
+			return n;
+	return noCheckpoint;
+}
+
+uint32_t IniSparseIndex::getEnd(uint16_t n) const
+{
+	return (n + 1 < _numCheckpoints ? _checkpoints[n + 1].position : _end);
+}
+
+void IniSparseIndex::add(const IniLine &line)
+{
+	// Bad sections cannot be found, the lines are only read past
+	if (line.type != IniLine::typeSection)
+		return;
+	if (_numCheckpoints && _sectionsInLast < _sectionsPerCheckpoint) {
+		_checkpoints[_numCheckpoints - 1].sections |=
+			filterBits(line.nameHash);
+		++_sectionsInLast;
+		return;
+	}
+	if (_numCheckpoints == _maxCheckpoints) {
+		// Out of room, so join pairs of runs into runs twice as long.
+		// The last run may now be part full.
+		uint16_t n = 0;
+		for (uint16_t i = 0; i < _numCheckpoints; i += 2, ++n) {
+			_checkpoints[n] = _checkpoints[i];
+			if (i + 1 < _numCheckpoints)
+				_checkpoints[n].sections |= _checkpoints[i + 1].sections;
+		}
+		_sectionsInLast += ((_numCheckpoints & 1) ? 0 :
+							_sectionsPerCheckpoint);
+		_numCheckpoints = n;
+		_sectionsPerCheckpoint *= 2;
+		add(line);
+		return;
+	}
+	IniCheckpoint &c = _checkpoints[_numCheckpoints++];
+	c.position = line.position;
+	c.line = line.number;
+	c.sections = filterBits(line.nameHash);
+	_sectionsInLast = 1;
+}
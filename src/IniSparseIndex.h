@@ -0,0 +1,98 @@
+#ifndef _INISPARSEINDEX_H
+#define _INISPARSEINDEX_H
+
+#include "IniFile.h"
+#include "IniTokenizer.h"
+
+// The start of a run of sections recorded in an IniSparseIndex
+struct IniCheckpoint {
+	uint32_t position; // Start of the first section line of the run
+	uint32_t line;     // Its line number, the first line is 1
+	uint16_t sections; // Filter of the section name hashes in the run
+};
+
+// A small index for boards which have no room for an IniIndex. Only
+// the positions of section lines are recorded, and when there are
+// more sections than checkpoints each checkpoint covers a run of
+// sections, with a 16 bit filter of their names. A lookup with a
+// section skips straight to the first run which may hold it and reads
+// the lines from there, moving on to the next possible run if it is
+// not found, then searches for the key as usual. The memory used is
+// fixed by the array supplied; fewer checkpoints mean longer runs.
+// Lookups with no section search from the start of the file. The
+// index must be built again if the file changes; IniFile::open()
+// marks an attached index as invalid.
+class IniSparseIndex {
+public:
+	static const uint16_t noCheckpoint = 0xFFFF;
+
+	// Each checkpoint starts with at most sectionsPerCheckpoint
+	// sections, doubled as many times as needed to fit
+	IniSparseIndex(IniCheckpoint* checkpoints, uint16_t maxCheckpoints,
+				   uint16_t sectionsPerCheckpoint = 1);
+
+	// Read the entire file once, in blocks of len bytes, to build the
+	// index. There is always room, by making the runs longer.
+	IniFile::error_t build(const IniFile &ini, char* buffer, size_t len);
+
+	inline bool isValid(void) const;
+	void clear(void);
+
+	// The first checkpoint from n whose run may hold a section with
+	// name hash (from IniTokenizer::hash()), or noCheckpoint
+	uint16_t find(uint32_t hash, uint16_t n) const;
+	// Position just after the run of checkpoint n
+	uint32_t getEnd(uint16_t n) const;
+
+	inline uint16_t getNumCheckpoints(void) const;
+	inline uint16_t getMaxCheckpoints(void) const;
+	inline const IniCheckpoint& getCheckpoint(uint16_t n) const;
+	// Sections in each run, after any doubling by build()
+	inline uint32_t getSectionsPerCheckpoint(void) const;
+
+private:
+	void add(const IniLine &line);
+	static inline uint16_t filterBits(uint32_t hash);
+
+	IniCheckpoint* _checkpoints;
+	uint16_t _maxCheckpoints;
+	uint16_t _numCheckpoints;
+	uint16_t _initialPerCheckpoint;
+	uint32_t _sectionsPerCheckpoint;
+	uint32_t _sectionsInLast; // Sections in the run of the last checkpoint
+	uint32_t _end; // Size of the file
+	bool _valid;
+};
+
+bool IniSparseIndex::isValid(void) const
+{
+	return _valid;
+}
+
+uint16_t IniSparseIndex::getNumCheckpoints(void) const
+{
+	return _numCheckpoints;
+}
+
+uint16_t IniSparseIndex::getMaxCheckpoints(void) const
+{
+	return _maxCheckpoints;
+}
+
+const IniCheckpoint& IniSparseIndex::getCheckpoint(uint16_t n) const
+{
+	return _checkpoints[n];
+}
+
+uint32_t IniSparseIndex::getSectionsPerCheckpoint(void) const
+{
+	return _sectionsPerCheckpoint;
+}
+
+uint16_t IniSparseIndex::filterBits(uint32_t hash)
+{
+	// Two bits from different parts of the hash
+	return (1U << (hash & 15)) | (1U << ((hash >> 8) & 15));
+}
+
+#endif
@@ -0,0 +1,232 @@
+#ifndef _INISTATIC_H
+#define _INISTATIC_H
+
+#include "IniFile.h"
+#include "IniAsync.h"
+#include "IniIndex.h"
+#include "IniInterpolation.h"
+#include "IniSparseIndex.h"
+#include "IniValueCache.h"
+
+// Versions of the index, caches and lookups which hold their storage
+// themselves, with capacities fixed at compile time. They can be
+// declared static or globally so that the memory they use is known at
+// link time. None of them, nor any lookup through them, uses malloc
+// or new, and nothing in the library throws; running out of room is
+// reported as errorBufferTooSmall as for the classes they wrap.
+
+// An IniIndex with room for maxEntries section and key lines. If
+// sortable is true there is room to sort() it, and if numSlots is not
+// zero for a hash table of that size.
+template <IniIndex::entry_t maxEntries, bool sortable = false,
+		  IniIndex::entry_t numSlots = 0>
+class IniStaticIndex : public IniIndex {
+public:
+	static_assert(maxEntries > 0 && maxEntries < IniIndex::noSection,
+				  "maxEntries must be from 1 to IniIndex::noSection - 1");
+	static_assert(numSlots == 0 || numSlots > maxEntries,
+				  "numSlots must be more than maxEntries");
+
+	IniStaticIndex() : IniIndex(_entryStorage, maxEntries) {}
+
+	using IniIndex::sort;
+	using IniIndex::buildHashTable;
+	inline IniFile::error_t sort(const IniFile &ini, char* buffer,
+								 size_t len);
+	inline IniFile::error_t buildHashTable(const IniFile &ini, char* buffer,
+										   size_t len);
+
+private:
+	IniIndexEntry _entryStorage[maxEntries];
+	// A single element when unused, since arrays cannot be empty
+	IniIndex::entry_t _orderStorage[sortable ? maxEntries : 1];
+	IniIndex::entry_t _slotStorage[numSlots ? numSlots : 1];
+};
+
+// An IniSparseIndex of maxCheckpoints checkpoints
+template <uint16_t maxCheckpoints, uint16_t sectionsPerCheckpoint = 1>
+class IniStaticSparseIndex : public IniSparseIndex {
+public:
+	static_assert(maxCheckpoints > 0 &&
+				  maxCheckpoints < IniSparseIndex::noCheckpoint,
+				  "maxCheckpoints must be from 1 to 65534");
+	static_assert(sectionsPerCheckpoint > 0,
+				  "sectionsPerCheckpoint must not be zero");
+
+	IniStaticSparseIndex()
+		: IniSparseIndex(_storage, maxCheckpoints,
+						 sectionsPerCheckpoint) {}
+
+private:
+	IniCheckpoint _storage[maxCheckpoints];
+};
+
+// An IniValueCache of maxValues values
+template <uint8_t maxValues>
+class IniStaticValueCache : public IniValueCache {
+public:
+	static_assert(maxValues > 0, "maxValues must not be zero");
+
+	explicit IniStaticValueCache(const IniFile &ini)
+		: IniValueCache(ini, _storage, maxValues) {}
+
+private:
+	IniCachedValue _storage[maxValues];
+};
+
+// An IniInterpolation with an arena of arenaBytes for up to maxValues
+// values which contain references
+template <size_t arenaBytes, uint16_t maxValues>
+class IniStaticInterpolation : public IniInterpolation {
+public:
+	static_assert(arenaBytes > 0, "arenaBytes must not be zero");
+	static_assert(maxValues > 0, "maxValues must not be zero");
+
+	IniStaticInterpolation()
+		: IniInterpolation(_arena, arenaBytes, _values,
+						   maxValues) {}
+
+private:
+	char _arena[arenaBytes];
+	IniResolvedValue _values[maxValues];
+};
+
+// An IniAsyncLookup with its own buffer for lines of up to
+// bufferLen - 1 characters
+template <size_t bufferLen>
+class IniStaticLookup : public IniAsyncLookup {
+public:
+	static_assert(bufferLen >= 2, "bufferLen must be at least 2");
+
+	IniStaticLookup(const IniFile &ini, IniAsyncIO &io)
+		: IniAsyncLookup(ini, io) {}
+
+	using IniAsyncLookup::begin;
+	inline bool begin(const char* section, const char* key,
+					  callback_t callback = NULL, void* context = NULL);
+
+private:
+	char _buffer[bufferLen];
+};
+
+// An ini file of up to maxBytes read into memory and indexed with up
+// to maxEntries section and key lines, for when the file is small
+// enough to keep in RAM but too slow to read on every lookup (eg on an
+// SD card). Once loaded, lookups through getFile() never touch the
+// original file.
+template <size_t maxBytes, IniIndex::entry_t maxEntries>
+class IniStaticDocument {
+public:
+	static_assert(maxBytes > 0, "maxBytes must not be zero");
+
+	explicit IniStaticDocument(bool caseSensitive = false)
+		: _ini(_data, 0, IniFile::memoryRAM, caseSensitive) {}
+
+	// Read the whole of source, which may be a file or compressed, and
+	// index it, reading in blocks of len bytes. Returns
+	// errorBufferTooSmall if the file or its index does not fit, when
+	// the document is left empty.
+	IniFile::error_t load(const IniFile &source, char* buffer, size_t len);
+
+	// The file in memory with the index attached, for all of the
+	// IniFile getters
+	inline IniFile& getFile(void);
+	inline const IniFile& getFile(void) const;
+	inline uint32_t getSize(void) const;
+	inline const IniStaticIndex<maxEntries>& getIndex(void) const;
+
+private:
+	IniStaticDocument(const IniStaticDocument &) = delete;
+	IniStaticDocument& operator=(const IniStaticDocument &) = delete;
+
+	char _data[maxBytes];
+	IniStaticIndex<maxEntries> _index;
+	IniFile _ini;
+};
+
+template <IniIndex::entry_t maxEntries, bool sortable,
+		  IniIndex::entry_t numSlots>
+IniFile::error_t IniStaticIndex<maxEntries, sortable, numSlots>::sort(
+	const IniFile &ini, char* buffer, size_t len)
+{
+	static_assert(sortable, "the index was not declared sortable");
+	return IniIndex::sort(ini, buffer, len, _orderStorage);
+}
+
+template <IniIndex::entry_t maxEntries, bool sortable,
+		  IniIndex::entry_t numSlots>
+IniFile::error_t IniStaticIndex<maxEntries, sortable, numSlots>::
+buildHashTable(const IniFile &ini, char* buffer, size_t len)
+{
+	static_assert(numSlots > 0, "the index was declared without slots");
+	return IniIndex::buildHashTable(ini, buffer, len, _slotStorage,
+									numSlots);
+}
+
+template <size_t bufferLen>
+bool IniStaticLookup<bufferLen>::begin(const char* section, const char* key,
+									   callback_t callback, void* context)
+{
+	return IniAsyncLookup::begin(section, key, _buffer, bufferLen,
+								 callback, context);
+}
+
+template <size_t maxBytes, IniIndex::entry_t maxEntries>
+IniFile::error_t IniStaticDocument<maxBytes, maxEntries>::load(
+	const IniFile &source, char* buffer, size_t len)
+{
+	bool caseSensitive = _ini.getCaseSensitive();
+	_ini = IniFile(_data, 0, IniFile::memoryRAM, caseSensitive);
+
+	// Read straight into the data, then check that nothing is left
+	size_t n = 0, bytesRead;
+	IniFile::error_t err = IniFile::errorNoError;
+	while (n < maxBytes &&
+		   (err = source.read(n, _data + n, maxBytes - n, bytesRead))
+		   == IniFile::errorNoError)
+		n += bytesRead;
+	if (n == maxBytes) {
+		char c;
+		err = source.read(n, &c, 1, bytesRead);
+		if (err == IniFile::errorNoError)
+			return IniFile::errorBufferTooSmall;
+	}
+	if (err != IniFile::errorEndOfFile)
+		return err;
+
+	IniFile ini(_data, n, IniFile::memoryRAM, caseSensitive);
+	ini.setSyntax(source.getSyntax());
+	err = _index.build(ini, buffer, len);
+	if (err != IniFile::errorNoError)
+		return err;
+	_ini = ini;
+	_ini.setIndex(&_index);
+	return IniFile::errorNoError;
+}
+
+template <size_t maxBytes, IniIndex::entry_t maxEntries>
+IniFile& IniStaticDocument<maxBytes, maxEntries>::getFile(void)
+{
+	return _ini;
+}
+
+template <size_t maxBytes, IniIndex::entry_t maxEntries>
+const IniFile& IniStaticDocument<maxBytes, maxEntries>::getFile(void) const
+{
+	return _ini;
+}
+
+template <size_t maxBytes, IniIndex::entry_t maxEntries>
+uint32_t IniStaticDocument<maxBytes, maxEntries>::getSize(void) const
+{
+	return _ini.getDataLen();
+}
+
+template <size_t maxBytes, IniIndex::entry_t maxEntries>
+const IniStaticIndex<maxEntries>&
+IniStaticDocument<maxBytes, maxEntries>::getIndex(void) const
+{
+	return _index;
+}
+
+#endif
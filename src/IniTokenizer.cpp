@@ -0,0 +1,234 @@
+#include "IniTokenizer.h"
+#include "IniFile.h"
+
+#include <ctype.h>
+
+IniTokenizer::IniTokenizer(uint32_t position, uint32_t number)
+{
+	_syntax = 0;
+	reset(position, number);
+}
+
+void IniTokenizer::reset(uint32_t position, uint32_t number)
+{
+	_position = position;
+	_number = number;
+	_skipNewline = '\0';
+	_quoted = false;
+	_continues = false;
+	startLine();
+}
+
+void IniTokenizer::setSyntax(uint8_t syntax)
+{
+	_syntax = syntax;
+}
+
+size_t IniTokenizer::scan(const char* data, size_t len)
+{
+	size_t i = 0;
+	if (_skipNewline != '\0' && len) {
+		// Discard the second character of a "\r\n" or "\n\r" pair
+		if (data[0] == _skipNewline) {
+			++i;
+			++_position;
+		}
+		_skipNewline = '\0';
+	}
+	if (_ready)
+		startLine();
+
+	for (; i < len; ++i) {
+		char c = data[i];
+		uint32_t pos = _position++;
+		if (c == '\n' || c == '\r') {
+			_skipNewline = (c == '\n' ? '\r' : '\n');
+			_line.length = pos - _line.position;
+			endLine();
+			return i + 1;
+		}
+
+		switch (_state) {
+		case stateStart:
+			if (isspace(c))
+				break;
+			if (c == '\0') {
+				_state = stateIgnore;
+				break;
+			}
+			if (c == ';' || c == '#') {
+				_line.type = IniLine::typeComment;
+				_state = stateIgnore;
+				break;
+			}
+			if (c == '[') {
+				_line.type = IniLine::typeBadSection;
+				_state = stateSectionLead;
+				break;
+			}
+			_line.type = IniLine::typeOther;
+			_state = stateKey;
+			_nameStart = _nameEnd = pos;
+			// fall through
+
+		case stateKey:
+			if (c == '=') {
+				_line.type = IniLine::typeKey;
+				_line.valueStart = _valueEnd = pos + 1;
+				_state = stateValueLead;
+			}
+			else if (c == '\0')
+				_state = stateIgnore;
+			else {
+				_hash = hashUpdate(_hash, c);
+				if (!isspace(c)) {
+					_line.nameHash = _hash;
+					_nameEnd = pos + 1;
+				}
+			}
+			break;
+
+		case stateSectionLead:
+			if (isspace(c))
+				break;
+			_nameStart = _nameEnd = pos;
+			_state = stateSectionName;
+			// fall through
+
+		case stateSectionName:
+			if (c == ']') {
+				_line.type = IniLine::typeSection;
+				_state = stateIgnore;
+			}
+			else if (c == '\0')
+				_state = stateIgnore;
+			else {
+				_hash = hashUpdate(_hash, c);
+				if (!isspace(c)) {
+					_line.nameHash = _hash;
+					_nameEnd = pos + 1;
+				}
+			}
+			break;
+
+		case stateValueLead:
+			if (isspace(c))
+				break;
+			if (c == '\0') {
+				_state = stateIgnore;
+				break;
+			}
+			_line.valueStart = pos;
+			_state = stateValue;
+			// fall through
+
+		case stateValue:
+			if (c == '\0')
+				_state = stateIgnore;
+			else {
+				if (!isspace(c))
+					_valueEnd = pos + 1;
+				if (_syntax & IniFile::syntaxContinuation)
+					scanValue(c);
+			}
+			break;
+
+		default:
+			// Ignoring the rest of the line
+			break;
+		}
+	}
+	return i;
+}
+
+void IniTokenizer::finish(void)
+{
+	if (_ready)
+		startLine();
+	if (_position > _line.position) {
+		_line.length = _position - _line.position;
+		endLine();
+	}
+}
+
+uint32_t IniTokenizer::hash(const char* str)
+{
+	uint32_t h = hashInit;
+	while (*str)
+		h = hashUpdate(h, *str++);
+	return h;
+}
+
+// Follow the value closely enough to know whether it continues on the
+// next line; the rules are those of IniFile::decodeValue()
+void IniTokenizer::scanValue(char c)
+{
+	if (_quoted) {
+		if (_escape)
+			_escape = false;
+		else if (c == '"')
+			_quoted = false;
+		else if (c == '\\')
+			_escape = true;
+		_space = false;
+		return;
+	}
+	if (c == '"' && (_syntax & IniFile::syntaxQuotes)) {
+		_quoted = true;
+		_backslash = false;
+		_space = false;
+		return;
+	}
+	if ((c == ';' || c == '#') && _space &&
+		(_syntax & IniFile::syntaxInlineComments)) {
+		_backslash = false;
+		_state = stateIgnore;
+		return;
+	}
+	_space = isspace(c);
+	if (c == '\\')
+		_backslash = true;
+	else if (!_space)
+		_backslash = false;
+}
+
+void IniTokenizer::startLine(void)
+{
+	_ready = false;
+	_state = stateStart;
+	_line.type = IniLine::typeBlank;
+	_line.number = _number;
+	_line.position = _position;
+	_line.length = 0;
+	_line.nameHash = hashInit;
+	_line.nameStart = _position;
+	_line.nameLength = 0;
+	_line.valueStart = _position;
+	_line.valueLength = 0;
+	_hash = hashInit;
+	_nameStart = _nameEnd = _position;
+	_valueEnd = _position;
+	_escape = false;
+	_backslash = false;
+	_space = true;
+	if (_continues) {
+		_line.type = IniLine::typeContinuation;
+		_state = stateValueLead;
+	}
+	else
+		_quoted = false;
+}
+
+void IniTokenizer::endLine(void)
+{
+	_line.nameStart = _nameStart;
+	_line.nameLength = _nameEnd - _nameStart;
+	bool value = (_line.type == IniLine::typeKey ||
+				  _line.type == IniLine::typeContinuation);
+	if (value)
+		_line.valueLength = _valueEnd - _line.valueStart;
+	_continues = (value && (_syntax & IniFile::syntaxContinuation) &&
+				  (_backslash || (_quoted && _escape)));
+	++_number;
+	_ready = true;
+}
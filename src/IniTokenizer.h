@@ -0,0 +1,145 @@
+#ifndef _INITOKENIZER_H
+#define _INITOKENIZER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Summary of one line of an ini file, as found by IniTokenizer. All
+// positions are byte offsets from the start of the file.
+struct IniLine {
+	enum type_t {
+		typeBlank = 0,
+		typeComment,
+		typeSection,
+		typeBadSection, // '[' without a closing ']'
+		typeKey,
+		typeOther,      // Not a comment or section, and no '='
+		typeContinuation, // More of the value of the key before
+	};
+
+	uint8_t type;
+	uint32_t number;      // Line number, the first line is 1
+	uint32_t position;    // Start of the line
+	uint32_t length;      // Excluding the newline
+	uint32_t nameHash;    // Hash of the section name or key
+	uint32_t nameStart;   // Start of the section name or key
+	uint32_t nameLength;  // Length of the section name or key
+	uint32_t valueStart;  // Start of the value, with whitespace removed
+	uint32_t valueLength; // Of this line only, before any decoding
+};
+
+// Split ini file data into lines and classify them, one byte at a
+// time, so that data can be processed in blocks of any size without
+// needing to hold a complete line. The rules are the same as used by
+// IniFile when looking up a key.
+class IniTokenizer {
+public:
+	IniTokenizer(uint32_t position = 0, uint32_t number = 1);
+
+	// Start again, with the next byte at position being the start of
+	// line number
+	void reset(uint32_t position = 0, uint32_t number = 1);
+
+	// Follow IniFile::setSyntax(), which only changes which lines are
+	// typeContinuation. Call before scanning.
+	void setSyntax(uint8_t syntax);
+
+	// Process data until the end of a line is found or the data runs
+	// out. Returns the number of bytes used, call lineReady() to find
+	// out if a line was completed.
+	size_t scan(const char* data, size_t len);
+
+	// Complete any final line which does not end with a newline
+	void finish(void);
+
+	inline bool lineReady(void) const;
+	// The last completed line. Only valid when lineReady() is true.
+	inline const IniLine& getLine(void) const;
+
+	// Position of the next byte expected
+	inline uint32_t getPosition(void) const;
+	// Number of the next line
+	inline uint32_t getLineNumber(void) const;
+
+	// Hash used for section names and keys. Case is ignored so that
+	// the same hash serves for case-sensitive and insensitive lookups.
+	static uint32_t hash(const char* str);
+	static constexpr uint32_t hashUpdate(uint32_t h, char c);
+	// As hashUpdate() without folding case, for hashes which must tell
+	// names apart by case
+	static constexpr uint32_t hashUpdateExact(uint32_t h, char c);
+	static const uint32_t hashInit = 2166136261UL;
+	// Lower-case version of an ASCII character, without a branch
+	static constexpr char foldCase(char c);
+
+private:
+	enum {
+		stateStart = 0,  // Skipping leading whitespace
+		stateIgnore,     // Nothing more of interest on this line
+		stateSectionLead,
+		stateSectionName,
+		stateKey,
+		stateValueLead,
+		stateValue,
+	};
+
+	void endLine(void);
+	void startLine(void);
+	void scanValue(char c);
+
+	IniLine _line;
+	bool _ready;
+	uint8_t _state;
+	char _skipNewline; // Second character of a two character newline
+	uint32_t _position;
+	uint32_t _number;  // Number of the next line
+	uint32_t _hash;    // Includes any trailing whitespace
+	uint32_t _nameStart;
+	uint32_t _nameEnd; // After the last non-whitespace character
+	uint32_t _valueEnd;
+	uint8_t _syntax;
+	// Where a value is up to, as IniFile::decodeValue()
+	bool _quoted;
+	bool _escape;    // Quoted, and the last character was a backslash
+	bool _backslash; // Not quoted, and the last non-whitespace was '\\'
+	bool _space;     // The last character was whitespace
+	bool _continues; // The next line continues the value
+};
+
+bool IniTokenizer::lineReady(void) const
+{
+	return _ready;
+}
+
+const IniLine& IniTokenizer::getLine(void) const
+{
+	return _line;
+}
+
+uint32_t IniTokenizer::getPosition(void) const
+{
+	return _position;
+}
+
+uint32_t IniTokenizer::getLineNumber(void) const
+{
+	return _number;
+}
+
+constexpr uint32_t IniTokenizer::hashUpdate(uint32_t h, char c)
+{
+	// FNV-1a of the lower-case character
+	return hashUpdateExact(h, foldCase(c));
+}
+
+constexpr uint32_t IniTokenizer::hashUpdateExact(uint32_t h, char c)
+{
+	return (h ^ uint8_t(c)) * 16777619UL;
+}
+
+constexpr char IniTokenizer::foldCase(char c)
+{
+	return c + (uint8_t(c - 'A') < 26 ? 'a' - 'A' : 0);
+}
+
+#endif
@@ -0,0 +1,181 @@
+#include "IniTrace.h"
+
+#include <string.h>
+
+#if defined(INIFILE_HOST)
+#include <chrono>
+#endif
+
+IniTrace::IniTrace()
+{
+	_ops = allOps;
+	_bytesRead = 0;
+}
+
+const char* IniTrace::getOpName(uint8_t op)
+{
+	switch (op) {
+	case opOpen:
+		return "open";
+	case opReadLine:
+		return "readLine";
+	case opFindSection:
+		return "findSection";
+	case opFindKey:
+		return "findKey";
+	case opBrowseSections:
+		return "browseSections";
+	case opValidate:
+		return "validate";
+	case opIndexLookup:
+		return "indexLookup";
+	case opSortedSearch:
+		return "sortedSearch";
+	default:
+		return "unknown";
+	}
+}
+
+uint32_t IniTrace::getMicros(void)
+{
+#if defined(INIFILE_HOST)
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+	return micros();
+#endif
+}
+
+IniTraceTotals::IniTraceTotals()
+{
+	clear();
+}
+
+void IniTraceTotals::clear(void)
+{
+	memset(_totals, 0, sizeof(_totals));
+	_depth = 0;
+}
+
+void IniTraceTotals::begin(const IniFile &, uint8_t, const char*)
+{
+	if (_depth < maxDepth) {
+		_open[_depth].start = IniTrace::getMicros();
+		_open[_depth].bytesRead = getBytesRead();
+	}
+	if (_depth < 0xFF)
+		++_depth;
+}
+
+void IniTraceTotals::end(const IniFile &, uint8_t op, IniFile::error_t err)
+{
+	if (_depth == 0 || op >= numOps)
+		return;
+	--_depth;
+	Total &t = _totals[op];
+	++t.count;
+	if (err != IniFile::errorNoError)
+		++t.errors;
+	// Operations nested too deeply are counted but not timed
+	if (_depth < maxDepth) {
+		t.micros += IniTrace::getMicros() - _open[_depth].start;
+		t.bytesRead += getBytesRead() - _open[_depth].bytesRead;
+	}
+}
+
+#if defined(INIFILE_HOST)
+IniChromeTrace::IniChromeTrace()
+{
+	_origin = 0;
+	_origin = now();
+}
+
+long long IniChromeTrace::now(void) const
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count() -
+		_origin;
+}
+
+void IniChromeTrace::clear(void)
+{
+	_events.clear();
+	_open.clear();
+}
+
+void IniChromeTrace::begin(const IniFile &ini, uint8_t op, const char* name)
+{
+	Event e;
+	e.op = op;
+	e.error = IniFile::errorNoError;
+	e.start = now();
+	e.duration = 0;
+	e.bytesRead = getBytesRead();
+	e.filename = ini.getFilename();
+	if (name)
+		e.name = name;
+	_open.push_back(e);
+}
+
+void IniChromeTrace::end(const IniFile &, uint8_t op, IniFile::error_t err)
+{
+	// Operations end in the reverse order to which they began, but
+	// look further in case an operation was abandoned
+	size_t n = _open.size();
+	while (n && _open[n - 1].op != op)
+		--n;
+	if (n == 0)
+		return;
+	Event e = _open[n - 1];
+	_open.resize(n - 1);
+	e.error = err;
+	e.duration = now() - e.start;
+	e.bytesRead = getBytesRead() - e.bytesRead;
+	_events.push_back(e);
+}
+
+void IniChromeTrace::writeString(FILE* f, const std::string &str)
+{
+	fputc('"', f);
+	for (size_t i = 0; i < str.size(); ++i) {
+		unsigned char c = str[i];
+		if (c == '"' || c == '\\')
+			fprintf(f, "\\%c", c);
+		else if (c < ' ')
+			fprintf(f, "\\u%04x", c);
+		else
+			fputc(c, f);
+	}
+	fputc('"', f);
+}
+
+bool IniChromeTrace::write(FILE* f) const
+{
+	fputs("{\"traceEvents\":[\n", f);
+	for (size_t i = 0; i < _events.size(); ++i) {
+		const Event &e = _events[i];
+		fprintf(f, "{\"name\":\"%s\",\"cat\":\"inifile\",\"ph\":\"X\","
+				"\"ts\":%lld,\"dur\":%lld,\"pid\":1,\"tid\":1,\"args\":{"
+				"\"file\":", getOpName(e.op), e.start, e.duration);
+		writeString(f, e.filename);
+		if (!e.name.empty()) {
+			fputs(",\"name\":", f);
+			writeString(f, e.name);
+		}
+		fprintf(f, ",\"bytes\":%lu,\"error\":%d}}%s\n",
+				(unsigned long)e.bytesRead, int(e.error),
+				(i + 1 < _events.size() ? "," : ""));
+	}
+	fputs("],\"displayTimeUnit\":\"ms\"}\n", f);
+	return !ferror(f);
+}
+
+bool IniChromeTrace::write(const char* filename) const
+{
+	FILE* f = fopen(filename, "w");
+	if (f == NULL)
+		return false;
+	bool ok = write(f);
+	return (fclose(f) == 0 && ok);
+}
+#endif
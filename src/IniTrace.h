@@ -0,0 +1,190 @@
+#ifndef _INITRACE_H
+#define _INITRACE_H
+
+#include "IniFile.h"
+
+#if defined(INIFILE_HOST)
+#include <stdio.h>
+#include <string>
+#include <vector>
+#endif
+
+// Told when the slower operations of an IniFile start and finish, to
+// find out where the time goes. Attach with IniFile::setTrace(). A
+// lookup which searches the file line by line is reported as a
+// findSection and then a findKey operation, each ending when the
+// search does, while a lookup answered by an index is indexLookup and
+// a binary search of sorted sections is sortedSearch, so lookups which
+// fall back to reading the whole file stand out. Operations nest, eg
+// the readLine operations of a findKey come between its begin() and
+// end(). Bytes read from the file are counted throughout.
+class IniTrace {
+public:
+	enum {
+		opOpen = 0,
+		opReadLine,
+		opFindSection,
+		opFindKey,
+		opBrowseSections,
+		opValidate,
+		opIndexLookup,
+		opSortedSearch,
+		numOps,
+	};
+	static const uint16_t allOps = (1 << numOps) - 1;
+
+	IniTrace();
+	virtual ~IniTrace() {}
+
+	// op has started on ini. name is the section or key sought by a
+	// lookup, otherwise NULL.
+	virtual void begin(const IniFile &ini, uint8_t op, const char* name) = 0;
+	// op has finished with err
+	virtual void end(const IniFile &ini, uint8_t op,
+					 IniFile::error_t err) = 0;
+
+	// Only report the operations whose bits (1 << op) are set, eg to
+	// leave out the many readLine operations. All are reported at first.
+	inline void setOps(uint16_t ops);
+	inline bool isTraced(uint8_t op) const;
+
+	// Bytes read from all files traced so far
+	inline uint32_t getBytesRead(void) const;
+	inline void addBytesRead(uint32_t bytes);
+
+	// A name for op, as used in traces
+	static const char* getOpName(uint8_t op);
+	// Microseconds from an arbitrary start, which wrap around
+	static uint32_t getMicros(void);
+
+private:
+	uint16_t _ops;
+	uint32_t _bytesRead;
+};
+
+// Totals for each operation, which take little memory and so can be
+// used on a board, eg to time start up
+class IniTraceTotals : public IniTrace {
+public:
+	// Deepest nesting of operations which is timed
+	static const uint8_t maxDepth = 8;
+
+	IniTraceTotals();
+
+	virtual void begin(const IniFile &ini, uint8_t op, const char* name);
+	virtual void end(const IniFile &ini, uint8_t op, IniFile::error_t err);
+
+	void clear(void);
+
+	// Number of times op finished, how many of those failed, and the
+	// microseconds taken and bytes read by them
+	inline uint32_t getCount(uint8_t op) const;
+	inline uint32_t getErrors(uint8_t op) const;
+	inline uint32_t getDuration(uint8_t op) const;
+	using IniTrace::getBytesRead;
+	inline uint32_t getBytesRead(uint8_t op) const;
+
+private:
+	struct Total {
+		uint32_t count;
+		uint32_t errors;
+		uint32_t micros;
+		uint32_t bytesRead;
+	};
+	struct Open {
+		uint32_t start;
+		uint32_t bytesRead;
+	};
+
+	Total _totals[numOps];
+	Open _open[maxDepth];
+	uint8_t _depth; // May be more than maxDepth
+};
+
+#if defined(INIFILE_HOST)
+// Records every operation, to be written out as a Chrome trace (the
+// JSON trace event format) which chrome://tracing or Perfetto can show
+// on a timeline. Each event has the file, the section or key sought,
+// the bytes read and any error. Use from one thread at a time.
+class IniChromeTrace : public IniTrace {
+public:
+	IniChromeTrace();
+
+	virtual void begin(const IniFile &ini, uint8_t op, const char* name);
+	virtual void end(const IniFile &ini, uint8_t op, IniFile::error_t err);
+
+	// Write the events finished so far. Returns false on error.
+	bool write(FILE* f) const;
+	bool write(const char* filename) const;
+
+	void clear(void);
+	inline size_t getNumEvents(void) const;
+
+private:
+	struct Event {
+		uint8_t op;
+		IniFile::error_t error;
+		long long start; // Microseconds since the trace was created
+		long long duration;
+		uint32_t bytesRead;
+		std::string filename;
+		std::string name;
+	};
+
+	long long now(void) const;
+	static void writeString(FILE* f, const std::string &str);
+
+	long long _origin;
+	std::vector<Event> _events;
+	std::vector<Event> _open;
+};
+#endif
+
+void IniTrace::setOps(uint16_t ops)
+{
+	_ops = ops;
+}
+
+bool IniTrace::isTraced(uint8_t op) const
+{
+	return _ops & (1 << op);
+}
+
+uint32_t IniTrace::getBytesRead(void) const
+{
+	return _bytesRead;
+}
+
+void IniTrace::addBytesRead(uint32_t bytes)
+{
+	_bytesRead += bytes;
+}
+
+uint32_t IniTraceTotals::getCount(uint8_t op) const
+{
+	return _totals[op].count;
+}
+
+uint32_t IniTraceTotals::getErrors(uint8_t op) const
+{
+	return _totals[op].errors;
+}
+
+uint32_t IniTraceTotals::getDuration(uint8_t op) const
+{
+	return _totals[op].micros;
+}
+
+uint32_t IniTraceTotals::getBytesRead(uint8_t op) const
+{
+	return _totals[op].bytesRead;
+}
+
+#if defined(INIFILE_HOST)
+size_t IniChromeTrace::getNumEvents(void) const
+{
+	return _events.size();
+}
+#endif
+
+#endif
@@ -0,0 +1,92 @@
+#include "IniValidation.h"
+
+IniValidation::IniValidation(IniFileProblem* problems, uint16_t maxProblems,
+							 uint32_t* keyHashes, uint16_t maxKeyHashes)
+{
+	_problems = problems;
+	_maxProblems = (problems == nullptr ? 0 : maxProblems);
+	_keyHashes = keyHashes;
+	_maxKeyHashes = (keyHashes == nullptr ? 0 : maxKeyHashes);
+	begin(0);
+}
+
+void IniValidation::begin(size_t bufferLen)
+{
+	_bufferLen = bufferLen;
+	_numProblems = 0;
+	_numKeyHashes = 0;
+	_sectionPosition = 0;
+	_numLines = 0;
+	_numSections = 0;
+	_numKeys = 0;
+	_sectionKeys = 0;
+	_maxKeysPerSection = 0;
+	_maxLineLength = 0;
+	_maxValueLength = 0;
+	_minBufferLen = 3; // Smallest length readLine() accepts
+	_numTooLong = 0;
+}
+
+// atEnd is true for a final line without a newline, which needs one
+// less byte of buffer
+bool IniValidation::addLine(const IniLine &line, bool atEnd)
+{
+	bool possibleDuplicate = false;
+	++_numLines;
+	if (line.length > _maxLineLength)
+		_maxLineLength = line.length;
+	uint32_t needed = line.length + (atEnd ? 1 : 2);
+	if (needed > _minBufferLen)
+		_minBufferLen = needed;
+	if (needed > _bufferLen) {
+		++_numTooLong;
+		addProblem(IniFileProblem::problemLineTooLong, line);
+	}
+
+	switch (line.type) {
+	case IniLine::typeBadSection:
+		addProblem(IniFileProblem::problemBadSection, line);
+		// fall through
+
+	case IniLine::typeSection:
+		++_numSections;
+		_sectionKeys = 0;
+		_numKeyHashes = 0;
+		_sectionPosition = line.position;
+		break;
+
+	case IniLine::typeKey:
+		++_numKeys;
+		if (++_sectionKeys > _maxKeysPerSection)
+			_maxKeysPerSection = _sectionKeys;
+		if (line.valueLength > _maxValueLength)
+			_maxValueLength = line.valueLength;
+		for (uint16_t i = 0; i < _numKeyHashes; ++i)
+			if (_keyHashes[i] == line.nameHash) {
+				possibleDuplicate = true;
+				break;
+			}
+		if (_numKeyHashes < _maxKeyHashes)
+			_keyHashes[_numKeyHashes++] = line.nameHash;
+		break;
+
+	case IniLine::typeOther:
+		addProblem(IniFileProblem::problemNoEquals, line);
+		break;
+
+	default:
+		break;
+	}
+	return possibleDuplicate;
+}
+
+void IniValidation::addProblem(uint8_t type, const IniLine &line)
+{
+	if (_numProblems < _maxProblems) {
+		IniFileProblem &p = _problems[_numProblems];
+		p.type = type;
+		p.lineNumber = line.number;
+		p.position = line.position;
+	}
+	++_numProblems;
+}
@@ -0,0 +1,126 @@
+#ifndef _INIVALIDATION_H
+#define _INIVALIDATION_H
+
+#include "IniFile.h"
+#include "IniTokenizer.h"
+
+// A problem found by IniFile::validate()
+struct IniFileProblem {
+	enum type_t {
+		problemLineTooLong = 0, // Will not fit in the buffer
+		problemBadSection,      // '[' without a closing ']'
+		problemNoEquals,        // Not a section or comment, and no '='
+		problemDuplicateKey,    // Key already used in the same section
+	};
+
+	uint8_t type;
+	uint32_t lineNumber; // The first line is 1
+	uint32_t position;   // Start of the line
+};
+
+// Results of IniFile::validate(): statistics which can be used to size
+// buffers and indexes, and a list of problems. Problems are stored in
+// an optional array supplied by the user; any beyond its length are
+// counted but not recorded. Duplicate keys are found by comparing
+// hashes, so are only checked if an array is supplied to hold the key
+// hashes of one section. When two hashes match the names are read
+// again and compared, following IniFile::setCaseSensitive().
+class IniValidation {
+public:
+	IniValidation(IniFileProblem* problems = nullptr, uint16_t maxProblems = 0,
+				  uint32_t* keyHashes = nullptr, uint16_t maxKeyHashes = 0);
+
+	// Total number of problems, which may exceed the number stored
+	inline uint32_t getNumProblems(void) const;
+	inline uint16_t getNumStoredProblems(void) const;
+	inline const IniFileProblem& getProblem(uint16_t n) const;
+
+	inline uint32_t getNumLines(void) const;
+	inline uint32_t getNumSections(void) const;
+	inline uint32_t getNumKeys(void) const;
+	inline uint32_t getMaxKeysPerSection(void) const;
+	inline uint32_t getMaxLineLength(void) const;
+	inline uint32_t getMaxValueLength(void) const;
+	// Smallest buffer which IniFile can use to read every line
+	inline uint32_t getMinBufferLen(void) const;
+
+private:
+	void begin(size_t bufferLen);
+	// Returns true if line is a key whose hash matches an earlier key
+	// of the section, for IniFile to compare the names
+	bool addLine(const IniLine &line, bool atEnd);
+	void addProblem(uint8_t type, const IniLine &line);
+
+	IniFileProblem* _problems;
+	uint16_t _maxProblems;
+	uint32_t _numProblems;
+	uint32_t* _keyHashes;
+	uint16_t _maxKeyHashes;
+	uint16_t _numKeyHashes;
+	uint32_t _sectionPosition; // Start of the current section line
+
+	size_t _bufferLen;
+	uint32_t _numLines;
+	uint32_t _numSections;
+	uint32_t _numKeys;
+	uint32_t _sectionKeys;
+	uint32_t _maxKeysPerSection;
+	uint32_t _maxLineLength;
+	uint32_t _maxValueLength;
+	uint32_t _minBufferLen;
+	uint32_t _numTooLong;
+
+	friend class IniFile;
+};
+
+uint32_t IniValidation::getNumProblems(void) const
+{
+	return _numProblems;
+}
+
+uint16_t IniValidation::getNumStoredProblems(void) const
+{
+	return (_numProblems < _maxProblems ? _numProblems : _maxProblems);
+}
+
+const IniFileProblem& IniValidation::getProblem(uint16_t n) const
+{
+	return _problems[n];
+}
+
+uint32_t IniValidation::getNumLines(void) const
+{
+	return _numLines;
+}
+
+uint32_t IniValidation::getNumSections(void) const
+{
+	return _numSections;
+}
+
+uint32_t IniValidation::getNumKeys(void) const
+{
+	return _numKeys;
+}
+
+uint32_t IniValidation::getMaxKeysPerSection(void) const
+{
+	return _maxKeysPerSection;
+}
+
+uint32_t IniValidation::getMaxLineLength(void) const
+{
+	return _maxLineLength;
+}
+
+uint32_t IniValidation::getMaxValueLength(void) const
+{
+	return _maxValueLength;
+}
+
+uint32_t IniValidation::getMinBufferLen(void) const
+{
+	return _minBufferLen;
+}
+
+#endif
@@ -0,0 +1,299 @@
+#include "IniValueCache.h"
+#include "IniInterpolation.h"
+#include "IniTokenizer.h"
+
+#include <string.h>
+
+IniValueCache::IniValueCache(const IniFile &ini, IniCachedValue* values,
+							 uint8_t maxValues)
+	: _ini(ini)
+{
+	_values = values;
+	_maxValues = maxValues;
+	_section = NULL;
+	_key = NULL;
+	_sectionHash = 0;
+	_keyHash = 0;
+	_type = typeUnused;
+	_error = IniFile::errorNoError;
+	clear();
+}
+
+void IniValueCache::clear(void)
+{
+	forget();
+	_hits = 0;
+	_misses = 0;
+}
+
+void IniValueCache::forget(void)
+{
+	for (uint8_t i = 0; i < _maxValues; ++i)
+		_values[i].type = typeUnused;
+	_next = 0;
+	_interpolation = _ini.getInterpolation();
+	if (_interpolation && !_interpolation->isValid(_ini))
+		_interpolation = nullptr;
+}
+
+bool IniValueCache::getValue(const char* section, const char* key,
+							 char* buffer, size_t len, bool& b)
+{
+	IniCachedValue* v = find(section, key, typeBool);
+	if (v) {
+		if (v->found)
+			b = v->value.b;
+		return v->found;
+	}
+	bool found = _ini.getValue(section, key, buffer, len, b);
+	v = store(found);
+	if (v && found)
+		v->value.b = b;
+	return found;
+}
+
+bool IniValueCache::getValue(const char* section, const char* key,
+							 char* buffer, size_t len, int& val)
+{
+	long longval;
+	bool r = getValue(section, key, buffer, len, longval);
+	if (r)
+		val = int(longval);
+	return r;
+}
+
+bool IniValueCache::getValue(const char* section, const char* key,
+							 char* buffer, size_t len, uint8_t& val)
+{
+	// Not from the long result, which is converted less strictly
+	IniCachedValue* v = find(section, key, typeUint8);
+	if (v) {
+		if (v->found)
+			val = uint8_t(v->value.ul);
+		return v->found;
+	}
+	bool found = _ini.getValue(section, key, buffer, len, val);
+	v = store(found);
+	if (v && found)
+		v->value.ul = val;
+	return found;
+}
+
+bool IniValueCache::getValue(const char* section, const char* key,
+							 char* buffer, size_t len, uint16_t& val)
+{
+	// Not from the long result, which is converted less strictly
+	IniCachedValue* v = find(section, key, typeUint16);
+	if (v) {
+		if (v->found)
+			val = uint16_t(v->value.ul);
+		return v->found;
+	}
+	bool found = _ini.getValue(section, key, buffer, len, val);
+	v = store(found);
+	if (v && found)
+		v->value.ul = val;
+	return found;
+}
+
+bool IniValueCache::getValue(const char* section, const char* key,
+							 char* buffer, size_t len, long& val)
+{
+	IniCachedValue* v = find(section, key, typeLong);
+	if (v) {
+		if (v->found)
+			val = v->value.l;
+		return v->found;
+	}
+	bool found = _ini.getValue(section, key, buffer, len, val);
+	v = store(found);
+	if (v && found)
+		v->value.l = val;
+	return found;
+}
+
+bool IniValueCache::getValue(const char* section, const char* key,
+							 char* buffer, size_t len, unsigned long& val)
+{
+	IniCachedValue* v = find(section, key, typeUnsignedLong);
+	if (v) {
+		if (v->found)
+			val = v->value.ul;
+		return v->found;
+	}
+	bool found = _ini.getValue(section, key, buffer, len, val);
+	v = store(found);
+	if (v && found)
+		v->value.ul = val;
+	return found;
+}
+
+bool IniValueCache::getValue(const char* section, const char* key,
+							 char* buffer, size_t len, float& val)
+{
+	IniCachedValue* v = find(section, key, typeFloat);
+	if (v) {
+		if (v->found)
+			val = v->value.f;
+		return v->found;
+	}
+	bool found = _ini.getValue(section, key, buffer, len, val);
+	v = store(found);
+	if (v && found)
+		v->value.f = val;
+	return found;
+}
+
+bool IniValueCache::getValue(const char* section, const char* key,
+							 char* buffer, size_t len, double& val)
+{
+	IniCachedValue* v = find(section, key, typeDouble);
+	if (v) {
+		if (v->found)
+			val = v->value.d;
+		return v->found;
+	}
+	bool found = _ini.getValue(section, key, buffer, len, val);
+	v = store(found);
+	if (v && found)
+		v->value.d = val;
+	return found;
+}
+
+bool IniValueCache::getIPAddress(const char* section, const char* key,
+								 char* buffer, size_t len, uint8_t* ip)
+{
+	IniCachedValue* v = find(section, key, typeIPAddress);
+	if (v) {
+		if (v->found)
+			memcpy(ip, v->value.bytes, 4);
+		return v->found;
+	}
+	bool found = _ini.getIPAddress(section, key, buffer, len, ip);
+	v = store(found);
+	if (v && found)
+		memcpy(v->value.bytes, ip, 4);
+	return found;
+}
+
+#if defined(ARDUINO) && ARDUINO >= 100
+bool IniValueCache::getIPAddress(const char* section, const char* key,
+								 char* buffer, size_t len, IPAddress& ip)
+{
+	uint8_t a[4];
+	bool r = getIPAddress(section, key, buffer, len, a);
+	if (r)
+		ip = a;
+	return r;
+}
+#endif
+
+bool IniValueCache::getMACAddress(const char* section, const char* key,
+								  char* buffer, size_t len, uint8_t mac[6])
+{
+	IniCachedValue* v = find(section, key, typeMACAddress);
+	if (v) {
+		if (v->found)
+			memcpy(mac, v->value.bytes, 6);
+		return v->found;
+	}
+	bool found = _ini.getMACAddress(section, key, buffer, len, mac);
+	v = store(found);
+	if (v && found)
+		memcpy(v->value.bytes, mac, 6);
+	return found;
+}
+
+// Returns the result if it is in the cache and still valid, otherwise
+// remembers what to store
+IniCachedValue* IniValueCache::find(const char* section, const char* key,
+									uint8_t type)
+{
+	_section = section;
+	_key = key;
+	_sectionHash = (section == NULL ? 0 : hash(section));
+	_keyHash = (key == NULL ? 0 : hash(key));
+	_type = type;
+	// The generation does not cover interpolation, which records the
+	// generation it was resolved for
+	const IniInterpolation* interpolation = _ini.getInterpolation();
+	if (interpolation && !interpolation->isValid(_ini))
+		interpolation = nullptr;
+	if (interpolation != _interpolation)
+		forget();
+	uint32_t generation = _ini.getGeneration();
+	for (uint8_t i = 0; i < _maxValues; ++i) {
+		IniCachedValue &v = _values[i];
+		if (v.generation == generation && matches(v)) {
+			++_hits;
+			_error = IniFile::error_t(v.error);
+			return &v;
+		}
+	}
+	++_misses;
+	return nullptr;
+}
+
+// Store the result of the IniFile function just called. Errors which
+// might not happen next time are not stored, nor are names too long to
+// copy.
+IniCachedValue* IniValueCache::store(bool found)
+{
+	_error = _ini.getError();
+	if (_maxValues == 0 ||
+		(_error != IniFile::errorNoError &&
+		 _error != IniFile::errorSectionNotFound &&
+		 _error != IniFile::errorKeyNotFound))
+		return nullptr;
+	const char* section = (_section == NULL ? "" : _section);
+	const char* key = (_key == NULL ? "" : _key);
+	size_t sectionLen = strlen(section) + 1;
+	size_t keyLen = strlen(key) + 1;
+	if (sectionLen + keyLen > INI_VALUE_CACHE_NAMES_LEN)
+		return nullptr;
+
+	// Reuse a result for the same name from an earlier generation
+	uint8_t n = _next;
+	for (uint8_t i = 0; i < _maxValues; ++i)
+		if (matches(_values[i])) {
+			n = i;
+			break;
+		}
+	if (n == _next)
+		_next = (_next + 1 == _maxValues ? 0 : _next + 1);
+
+	IniCachedValue &v = _values[n];
+	v.sectionHash = _sectionHash;
+	v.keyHash = _keyHash;
+	v.generation = _ini.getGeneration();
+	v.type = _type;
+	v.found = found;
+	v.error = _error;
+	memcpy(v.names, section, sectionLen);
+	memcpy(v.names + sectionLen, key, keyLen);
+	return &v;
+}
+
+// Whether a result is for the names and type of the last find(). A
+// NULL name is stored as an empty one and told apart by its zero hash.
+bool IniValueCache::matches(const IniCachedValue &v) const
+{
+	if (v.type != _type || v.keyHash != _keyHash ||
+		v.sectionHash != _sectionHash)
+		return false;
+	const char* key = v.names + strlen(v.names) + 1;
+	return _ini.matchName(v.names, _section == NULL ? "" : _section) &&
+		_ini.matchName(key, _key == NULL ? "" : _key);
+}
+
+// FNV-1a, case-folded unless the file is case sensitive. Never zero,
+// which is used for a NULL section.
+uint32_t IniValueCache::hash(const char* name) const
+{
+	if (!_ini.getCaseSensitive())
+		return IniTokenizer::hash(name) | 1;
+	uint32_t h = IniTokenizer::hashInit;
+	while (*name)
+		h = IniTokenizer::hashUpdateExact(h, *name++);
+	return h | 1;
+}
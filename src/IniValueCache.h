@@ -0,0 +1,136 @@
+#ifndef _INIVALUECACHE_H
+#define _INIVALUECACHE_H
+
+#include "IniFile.h"
+
+// Space in each IniCachedValue for the section and key names, each
+// with its terminating NUL. Results for longer names are not cached.
+#define INI_VALUE_CACHE_NAMES_LEN 24
+
+// One converted value held by an IniValueCache. Stored by
+// IniValueCache in a caller-supplied array.
+struct IniCachedValue {
+	uint32_t sectionHash;
+	uint32_t keyHash;
+	uint32_t generation; // IniFile::getGeneration() when stored
+	uint8_t type;        // 0 if unused
+	uint8_t found;       // Result of the IniFile function
+	uint8_t error;       // IniFile::getError() afterwards
+	union {
+		bool b;
+		long l;
+		unsigned long ul;
+		float f;
+		double d;
+		uint8_t bytes[6]; // IP or MAC address
+	} value;
+	char names[INI_VALUE_CACHE_NAMES_LEN]; // Section then key
+};
+
+// Remembers the results of the typed IniFile getters, so that values
+// read over and over (eg on every pass of a control loop) are looked
+// up and converted only once. Each result is kept for one section,
+// key and type, including a key or section which was not found. All
+// results are forgotten when the IniFile is opened again, and when an
+// IniInterpolation is attached, detached or becomes valid or invalid,
+// since the values then change. For memory data call clear() if it
+// changes, and likewise after resolving an attached IniInterpolation
+// again. When full, the least recently stored result is replaced.
+//
+// The buffer is only used when the value is not in the cache, and then
+// also holds the value as a string, as the IniFile getters leave it.
+// Results are found by the hashes of the section and key and confirmed
+// by comparing the names, which each result holds a copy of.
+class IniValueCache {
+public:
+	IniValueCache(const IniFile &ini, IniCachedValue* values,
+				  uint8_t maxValues);
+
+	void clear(void);
+
+	// As the IniFile functions of the same names
+	bool getValue(const char* section, const char* key,
+				  char* buffer, size_t len, bool& b);
+	bool getValue(const char* section, const char* key,
+				  char* buffer, size_t len, int& val);
+	bool getValue(const char* section, const char* key,
+				  char* buffer, size_t len, uint8_t& val);
+	bool getValue(const char* section, const char* key,
+				  char* buffer, size_t len, uint16_t& val);
+	bool getValue(const char* section, const char* key,
+				  char* buffer, size_t len, long& val);
+	bool getValue(const char* section, const char* key,
+				  char* buffer, size_t len, unsigned long& val);
+	bool getValue(const char* section, const char* key,
+				  char* buffer, size_t len, float& val);
+	bool getValue(const char* section, const char* key,
+				  char* buffer, size_t len, double& val);
+	bool getIPAddress(const char* section, const char* key,
+					  char* buffer, size_t len, uint8_t* ip);
+#if defined(ARDUINO) && ARDUINO >= 100
+	bool getIPAddress(const char* section, const char* key,
+					  char* buffer, size_t len, IPAddress& ip);
+#endif
+	bool getMACAddress(const char* section, const char* key,
+					   char* buffer, size_t len, uint8_t mac[6]);
+
+	// The error of the last lookup, as IniFile::getError()
+	inline IniFile::error_t getError(void) const;
+
+	// Number of lookups answered from the cache and from the IniFile
+	inline uint32_t getHits(void) const;
+	inline uint32_t getMisses(void) const;
+
+private:
+	enum {
+		typeUnused = 0,
+		typeBool,
+		typeLong,
+		typeUnsignedLong,
+		typeFloat,
+		typeDouble,
+		typeIPAddress,
+		typeMACAddress,
+		typeUint8,
+		typeUint16,
+	};
+
+	IniCachedValue* find(const char* section, const char* key, uint8_t type);
+	void forget(void);
+	IniCachedValue* store(bool found);
+	bool matches(const IniCachedValue &v) const;
+	uint32_t hash(const char* name) const;
+
+	const IniFile &_ini;
+	IniCachedValue* _values;
+	uint8_t _maxValues;
+	uint8_t _next; // Where the next result is stored
+	// The interpolation the results were read through, if it was valid
+	const IniInterpolation* _interpolation;
+	// Names, hashes and type of the last find(), for store()
+	const char* _section;
+	const char* _key;
+	uint32_t _sectionHash;
+	uint32_t _keyHash;
+	uint8_t _type;
+	IniFile::error_t _error;
+	uint32_t _hits;
+	uint32_t _misses;
+};
+
+IniFile::error_t IniValueCache::getError(void) const
+{
+	return _error;
+}
+
+uint32_t IniValueCache::getHits(void) const
+{
+	return _hits;
+}
+
+uint32_t IniValueCache::getMisses(void) const
+{
+	return _misses;
+}
+
+#endif
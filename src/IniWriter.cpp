@@ -0,0 +1,352 @@
+#include "IniWriter.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+IniWriter::IniWriter(File &file, char* buffer, size_t len) : _file(file)
+{
+	_buffer = buffer;
+	_len = (buffer == nullptr ? 0 : len);
+	_used = 0;
+	_position = 0;
+	_error = IniFile::errorNoError;
+}
+
+bool IniWriter::writeSection(const char* section)
+{
+	return write("[") && write(section) && write("]") && endLine();
+}
+
+bool IniWriter::writeComment(const char* comment, char commentChar)
+{
+	return write(&commentChar, 1) && write(" ") && write(comment) &&
+		endLine();
+}
+
+bool IniWriter::writeBlankLine(void)
+{
+	return endLine();
+}
+
+bool IniWriter::writeValue(const char* key, const char* value)
+{
+	return writeKey(key) && write(value) && endLine();
+}
+
+bool IniWriter::writeValue(const char* key, bool b)
+{
+	return writeValue(key, b ? "true" : "false");
+}
+
+bool IniWriter::writeValue(const char* key, int val)
+{
+	return writeValue(key, long(val));
+}
+
+bool IniWriter::writeValue(const char* key, uint8_t val)
+{
+	return writeValue(key, (unsigned long)val);
+}
+
+bool IniWriter::writeValue(const char* key, uint16_t val)
+{
+	return writeValue(key, (unsigned long)val);
+}
+
+bool IniWriter::writeValue(const char* key, long val)
+{
+	// Negate as unsigned so that LONG_MIN does not overflow
+	unsigned long u = (val < 0 ? 0UL - (unsigned long)val : val);
+	return writeKey(key) && writeNumber(u, val < 0) && endLine();
+}
+
+bool IniWriter::writeValue(const char* key, unsigned long val)
+{
+	return writeKey(key) && writeNumber(val) && endLine();
+}
+
+bool IniWriter::writeValue(const char* key, double val, uint8_t decimals)
+{
+	return writeFloat(key, val, decimals, false);
+}
+
+bool IniWriter::writeValue(const char* key, float val, uint8_t decimals)
+{
+	return writeFloat(key, val, decimals, true);
+}
+
+// Formatted by hand since printf() on AVR has no floating point
+// support. Values of a billion or more are written with an exponent,
+// which atof() and strtod() accept, so that the whole part fits in an
+// unsigned long.
+bool IniWriter::writeFloat(const char* key, double val, uint8_t decimals,
+						   bool isFloat)
+{
+	if (!writeKey(key))
+		return false;
+	if (isnan(val))
+		return write("nan") && endLine();
+	if (isinf(val))
+		return write(val < 0 ? "-inf" : "inf") && endLine();
+	if (decimals == roundTrip)
+		return writeSignificant(val, isFloat) && endLine();
+
+	bool negative = (val < 0);
+	if (negative)
+		val = -val;
+	int exponent = 0;
+	while (val >= 1e9) {
+		val /= 10;
+		++exponent;
+	}
+
+	double rounding = 0.5;
+	for (uint8_t i = 0; i < decimals; ++i)
+		rounding /= 10;
+	val += rounding;
+
+	unsigned long whole = (unsigned long)val;
+	double fraction = val - whole;
+	if (!writeNumber(whole, negative))
+		return false;
+	if (decimals && !write("."))
+		return false;
+	while (decimals--) {
+		fraction *= 10;
+		char digit = '0' + char(fraction);
+		fraction -= (digit - '0');
+		if (!write(&digit, 1))
+			return false;
+	}
+	if (exponent && !(write("e") && writeNumber(exponent)))
+		return false;
+	return endLine();
+}
+
+bool IniWriter::writeIPAddress(const char* key, const uint8_t* ip)
+{
+	if (!writeKey(key))
+		return false;
+	for (uint8_t i = 0; i < 4; ++i)
+		if ((i && !write(".")) || !writeNumber(ip[i]))
+			return false;
+	return endLine();
+}
+
+#if defined(ARDUINO) && ARDUINO >= 100
+bool IniWriter::writeIPAddress(const char* key, const IPAddress& ip)
+{
+	uint8_t a[4] = {ip[0], ip[1], ip[2], ip[3]};
+	return writeIPAddress(key, a);
+}
+#endif
+
+bool IniWriter::writeMACAddress(const char* key, const uint8_t mac[6])
+{
+	static const char hex[] = "0123456789ABCDEF";
+	char str[18];
+	char* cp = str;
+	for (uint8_t i = 0; i < 6; ++i) {
+		if (i)
+			*cp++ = ':';
+		*cp++ = hex[mac[i] >> 4];
+		*cp++ = hex[mac[i] & 0x0F];
+	}
+	*cp = '\0';
+	return writeValue(key, str);
+}
+
+bool IniWriter::copy(const IniFile &ini)
+{
+	return copy(ini, 0, 0xFFFFFFFF);
+}
+
+bool IniWriter::copy(const IniFile &ini, uint32_t start, uint32_t end)
+{
+	if (_error != IniFile::errorNoError)
+		return false;
+	if (_len == 0) {
+		_error = IniFile::errorBufferTooSmall;
+		return false;
+	}
+	// Read straight into the free part of the buffer
+	uint32_t pos = start;
+	while (pos < end) {
+		if (_used == _len && !flush())
+			return false;
+		size_t n = _len - _used;
+		if (n > end - pos)
+			n = end - pos;
+		size_t bytesRead;
+		IniFile::error_t err = ini.read(pos, _buffer + _used, n, bytesRead);
+		if (err == IniFile::errorEndOfFile)
+			return true;
+		if (err != IniFile::errorNoError) {
+			_error = err;
+			return false;
+		}
+		pos += bytesRead;
+		_used += bytesRead;
+		_position += bytesRead;
+	}
+	return true;
+}
+
+bool IniWriter::write(const char* data, size_t len)
+{
+	if (_error != IniFile::errorNoError)
+		return false;
+	_position += len;
+	while (len) {
+		if (_used == 0 && len >= _len) {
+			// Whole buffers can go straight to the file
+			size_t n = (_len ? len - len % _len : len);
+			if (!writeFile(data, n))
+				return false;
+			data += n;
+			len -= n;
+			continue;
+		}
+		size_t n = _len - _used;
+		if (n > len)
+			n = len;
+		memcpy(_buffer + _used, data, n);
+		_used += n;
+		data += n;
+		len -= n;
+		if (_used == _len && !flush())
+			return false;
+	}
+	return true;
+}
+
+bool IniWriter::write(const char* str)
+{
+	return write(str, strlen(str));
+}
+
+bool IniWriter::flush(void)
+{
+	if (_error != IniFile::errorNoError)
+		return false;
+	size_t n = _used;
+	_used = 0;
+	return writeFile(_buffer, n);
+}
+
+bool IniWriter::writeKey(const char* key)
+{
+	return write(key) && write(" = ");
+}
+
+bool IniWriter::endLine(void)
+{
+	return write("\n", 1);
+}
+
+bool IniWriter::writeNumber(unsigned long val, bool negative)
+{
+	char str[22];
+	char* cp = str + sizeof(str);
+	do {
+		*--cp = '0' + char(val % 10);
+		val /= 10;
+	} while (val);
+	if (negative)
+		*--cp = '-';
+	return write(cp, str + sizeof(str) - cp);
+}
+
+#if defined(INIFILE_HOST)
+// The shortest form that strtod() reads back as the same value
+bool IniWriter::writeSignificant(double val, bool isFloat)
+{
+	char str[32];
+	for (int digits = 1; digits <= 17; ++digits) {
+		snprintf(str, sizeof(str), "%.*g", digits, val);
+		double back = strtod(str, nullptr);
+		if (isFloat ? float(back) == float(val) : back == val)
+			break;
+	}
+	return write(str);
+}
+#else
+// Nine significant figures, so that the digits fit in an unsigned
+// long, without trailing zeros. Written as %g would.
+bool IniWriter::writeSignificant(double val, bool)
+{
+	const uint8_t maxDigits = 9;
+	if (val == 0)
+		return write("0");
+	if (val < 0) {
+		if (!write("-"))
+			return false;
+		val = -val;
+	}
+
+	// Scale into [1e8, 1e9) and round, counting the powers of ten
+	int scale = 0;
+	while (val >= 1e9) {
+		val /= 10;
+		++scale;
+	}
+	while (val < 1e8) {
+		val *= 10;
+		--scale;
+	}
+	unsigned long digits = (unsigned long)(val + 0.5);
+	if (digits >= 1000000000UL) {
+		digits /= 10;
+		++scale;
+	}
+	uint8_t n = maxDigits;
+	while (n > 1 && digits % 10 == 0) {
+		digits /= 10;
+		--n;
+		++scale;
+	}
+	char str[maxDigits];
+	for (uint8_t i = n; i--; ) {
+		str[i] = '0' + char(digits % 10);
+		digits /= 10;
+	}
+
+	// Exponent of the leading digit
+	int exponent = scale + n - 1;
+	if (exponent < -4 || exponent >= maxDigits)
+		return write(str, 1) && (n == 1 || (write(".") &&
+											write(str + 1, n - 1))) &&
+			write("e") && writeNumber(abs(exponent), exponent < 0);
+	if (exponent < 0) {
+		if (!write("0."))
+			return false;
+		for (int i = -1; i > exponent; --i)
+			if (!write("0"))
+				return false;
+		return write(str, n);
+	}
+	uint8_t whole = exponent + 1;
+	if (whole >= n) {
+		if (!write(str, n))
+			return false;
+		for (uint8_t i = n; i < whole; ++i)
+			if (!write("0"))
+				return false;
+		return true;
+	}
+	return write(str, whole) && write(".") && write(str + whole, n - whole);
+}
+#endif
+
+bool IniWriter::writeFile(const char* data, size_t len)
+{
+	if (len == 0)
+		return true;
+	if (_file.write((const uint8_t*)data, len) != len) {
+		_error = IniFile::errorWriteError;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,96 @@
+#ifndef _INIWRITER_H
+#define _INIWRITER_H
+
+#include "IniFile.h"
+
+// Write an ini file a line at a time. Output is collected in a buffer
+// supplied by the user and written to the file only when the buffer
+// is full, so that an SD card sees a few large writes rather than
+// many small ones; a multiple of 512 bytes is best. Call flush() when
+// finished. Values are written in the forms that IniFile::getValue()
+// reads back. Names and values must not contain newlines.
+class IniWriter {
+public:
+	IniWriter(File &file, char* buffer, size_t len);
+
+	bool writeSection(const char* section);
+	// Write a comment line, starting with commentChar
+	bool writeComment(const char* comment, char commentChar = ';');
+	bool writeBlankLine(void);
+
+	bool writeValue(const char* key, const char* value);
+	bool writeValue(const char* key, bool b);
+	bool writeValue(const char* key, int val);
+	bool writeValue(const char* key, uint8_t val);
+	bool writeValue(const char* key, uint16_t val);
+	bool writeValue(const char* key, long val);
+	bool writeValue(const char* key, unsigned long val);
+	// Write a floating point value with a fixed number of decimal
+	// places, or by default with as few significant figures as read
+	// back the same value. On boards at most 9 figures are written,
+	// which is enough for a float.
+	static const uint8_t roundTrip = 0xFF;
+	bool writeValue(const char* key, double val, uint8_t decimals = roundTrip);
+	bool writeValue(const char* key, float val, uint8_t decimals = roundTrip);
+
+	bool writeIPAddress(const char* key, const uint8_t* ip);
+#if defined(ARDUINO) && ARDUINO >= 100
+	bool writeIPAddress(const char* key, const IPAddress& ip);
+#endif
+	bool writeMACAddress(const char* key, const uint8_t mac[6]);
+
+	// Copy the whole of another ini file (or one held in memory)
+	// exactly as it is, including comments and blank lines
+	bool copy(const IniFile &ini);
+	// Copy the bytes of another file from start up to end, or its end
+	bool copy(const IniFile &ini, uint32_t start, uint32_t end);
+
+	// Write raw data
+	bool write(const char* data, size_t len);
+	bool write(const char* str);
+
+	// Write out anything held in the buffer
+	bool flush(void);
+
+	// errorWriteError if the file did not accept all the data, or the
+	// error from IniFile if copy() failed. Once set nothing more is
+	// written.
+	inline IniFile::error_t getError(void) const;
+	inline void clearError(void);
+
+	// Number of bytes written, including those still in the buffer
+	inline uint32_t getPosition(void) const;
+
+private:
+	bool writeKey(const char* key);
+	bool endLine(void);
+	bool writeNumber(unsigned long val, bool negative = false);
+	bool writeFloat(const char* key, double val, uint8_t decimals,
+					bool isFloat);
+	bool writeSignificant(double val, bool isFloat);
+	bool writeFile(const char* data, size_t len);
+
+	File &_file;
+	char* _buffer;
+	size_t _len;
+	size_t _used;
+	uint32_t _position;
+	IniFile::error_t _error;
+};
+
+IniFile::error_t IniWriter::getError(void) const
+{
+	return _error;
+}
+
+void IniWriter::clearError(void)
+{
+	_error = IniFile::errorNoError;
+}
+
+uint32_t IniWriter::getPosition(void) const
+{
+	return _position;
+}
+
+#endif